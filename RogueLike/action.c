@@ -8,43 +8,54 @@
 #include "game.h"
 #include "actor.h"
 #include "astar.h"
+#include "flow_field.h"
 
 #include "mathlib.h"
 
 #include <limits.h>
 
 #if 1
+/// Whether there's a collidable actor at `coord`, other than one on `target`.
+static bool BlockedByActor(Map * map, TileCoord coord, TileCoord target)
+{
+    if ( TileCoordsEqual(coord, target) ) {
+        return false;
+    }
+
+    FOR_EACH_ACTOR_AT_TILE(actor, map->actor_list, coord) {
+        if ( ActorBlocksAll(actor) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /// From tile `start`, find the adjacent tile with the smallest distance
 /// to target tile `end`.
-static Direction PathFindToTile(Map * map, TileCoord start, TileCoord end, bool player, bool diagonals)
+/// - parameter distances: Distances to `end`, e.g. from `GetFlowField`.
+static Direction PathFindToTile(Map * map,
+                                TileCoord start,
+                                TileCoord end,
+                                const DistancePlane * distances,
+                                bool diagonals)
 {
-//    float start_time = ProgramTime();
-//    CalculateDistances(&world->map, end, 0, false);
-//    printf("CalcDist: %.2f ms\n", (ProgramTime() - start_time) * 1000.0f);
-
     Direction best_direction = NO_DIRECTION;
     int min_distance = INT_MAX;
 
     int num_directions = diagonals ? NUM_DIRECTIONS : NUM_CARDINAL_DIRECTIONS;
     for ( Direction d = 0; d < num_directions; d++ ) {
-        Tile * adj = GetAdjacentTile(map, start, d);
+        TileCoord tc = AdjacentTileCoord(start, d);
+        const TileFlags * adj = GetTileFlags((const Map *)map, tc);
         if ( adj == NULL ) {
             continue;
         }
 
-        TileCoord tc = AdjacentTileCoord(start, d);
-        s16 distance = player ? adj->player_distance : adj->distance;
-        Actor * a = GetActorAtTile(&map->actor_list, tc);
-
-        // Don't move there if:
-        bool blocked =
-        a // there's an actor there...
-        && ActorBlocksAll(a) // ... that is collidable ...
-        && !TileCoordsEqual(a->tile, end); //...and it is not the target
+        s16 distance = GetDistance(distances, tc);
 
-        if ( !adj->flags.blocks_movement
+        if ( !adj->blocks_movement
             && distance < min_distance
-            && !blocked )
+            && !BlockedByActor(map, tc, end) )
         {
             min_distance = distance;
             best_direction = d;
@@ -56,33 +67,30 @@ static Direction PathFindToTile(Map * map, TileCoord start, TileCoord end, bool
 
 // TODO: combine with PathFindTo
 static Direction
-PathFindAwayFromTile(Map * map, TileCoord subject, TileCoord away_from, bool player)
+PathFindAwayFromTile(Map * map,
+                     TileCoord subject,
+                     TileCoord away_from,
+                     const DistancePlane * distances)
 {
-//    CalculateDistances(&world->map, away_from, 0, false);
-
     Direction best_direction = NO_DIRECTION;
 
-    Tile * self_tile = GetTile(map, subject);
-    int max_distance = self_tile->player_distance;
+    int max_distance = GetDistance(distances, subject);
 
     for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
-        Tile * adj = GetAdjacentTile(map, subject, d);
         TileCoord tc = AdjacentTileCoord(subject, d);
-        s16 distance = player ? adj->player_distance : adj->distance;
-        Actor * a = GetActorAtTile(&map->actor_list, tc);
+        const TileFlags * adj = GetTileFlags((const Map *)map, tc);
+        if ( adj == NULL ) {
+            continue;
+        }
 
-        // TODO: JT
-        // Don't move there if:
-        bool blocked =
-        a // there's an actor there...
-        && ActorBlocksAll(a) // ... that is collidable ...
-        && !TileCoordsEqual(a->tile, away_from); //...and it not the target
+        s16 distance = GetDistance(distances, tc);
 
-        if ( !adj->flags.blocks_movement
+        // TODO: JT
+        if ( !adj->blocks_movement
             && distance > max_distance
-            && !blocked )
+            && !BlockedByActor(map, tc, away_from) )
         {
-            max_distance = adj->distance;
+            max_distance = distance;
             best_direction = d;
         }
     }
@@ -104,8 +112,8 @@ void A_TargetAndChasePlayerIfVisible(Actor * actor)
     }
 
     if ( actor->flags.has_target ) {
-        CalculateDistances(map, actor->target_tile, 0, false);
-        Direction d = PathFindToTile(map, actor->tile, actor->target_tile, false, actor->info->flags.moves_diagonally);
+        const DistancePlane * distances = GetFlowField(map, actor->target_tile, 0);
+        Direction d = PathFindToTile(map, actor->tile, actor->target_tile, distances, actor->info->flags.moves_diagonally);
         TileCoord coord = AdjacentTileCoord(actor->tile, d);
         TryMoveActor(actor, coord);
 
@@ -124,7 +132,8 @@ void A_ChasePlayerIfVisible(Actor * actor)
 
     if ( LineOfSight(world->map, actor->tile, player->tile) ) {
 //        Path path = FindPath(world, actor->tile, player->tile, true);
-        Direction d = PathFindToTile(world->map, actor->tile, player->tile, true, actor->info->flags.moves_diagonally);
+        const DistancePlane * distances = GetFlowField(world->map, player->tile, 0);
+        Direction d = PathFindToTile(world->map, actor->tile, player->tile, distances, actor->info->flags.moves_diagonally);
         TileCoord coord = AdjacentTileCoord(actor->tile, d);
         TryMoveActor(actor, coord);
 //        if ( path.size > 0 ) {
@@ -160,16 +169,14 @@ void A_SpiderChase(Actor * spider)
         int dx = SIGN(player->tile.x - spider->tile.x);
         int dy = SIGN(player->tile.y - spider->tile.y);
         Direction d = GetDirection(dx, dy);
-        Tile * tile = GetAdjacentTile(world->map, spider->tile, d);
-
-        TileCoord coord;
+        TileCoord coord = AdjacentTileCoord(spider->tile, d);
 
-        if ( tile->light <= world->info->revealed_light ) {
-            coord = AdjacentTileCoord(spider->tile, d);
+        if ( GetTileLight(world->map, coord) <= world->info->revealed_light ) {
             TryMoveActor(spider, coord);
         } else {
             // Regular light
-            Direction d2 = PathFindAwayFromTile(world->map, spider->tile, player->tile, true);
+            const DistancePlane * distances = GetFlowField(world->map, player->tile, 0);
+            Direction d2 = PathFindAwayFromTile(world->map, spider->tile, player->tile, distances);
             coord = AdjacentTileCoord(spider->tile, d2);
             TryMoveActor(spider, coord);
         }
@@ -219,11 +226,12 @@ void A_GhostChase(Actor * ghost)
             }
 
             // Select one and try to move there.
-            int index = Random(0, num_coords - 1);
+            int index = RngInt(&ghost->game->rng[RNG_AI], 0, num_coords - 1);
             TryMoveActor(ghost, coords[index]);
 
         } else {
-            Direction d = PathFindToTile(world->map, ghost->tile, player->tile, true, ghost->info->flags.moves_diagonally);
+            const DistancePlane * distances = GetFlowField(world->map, player->tile, 0);
+            Direction d = PathFindToTile(world->map, ghost->tile, player->tile, distances, ghost->info->flags.moves_diagonally);
             TileCoord coord = AdjacentTileCoord(ghost->tile, d);
             TryMoveActor(ghost, coord);
 //            Path path = FindPath(world, ghost->tile, player->tile, false);
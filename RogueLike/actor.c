@@ -15,9 +15,11 @@
 #include "mathlib.h"
 #include "texture.h"
 #include "video.h"
+#include "sprite_batch.h"
 #include "sound.h"
 
 #include <limits.h>
+#include <math.h>
 
 enum {
     DRAW_PRIORITY_NONE,
@@ -321,9 +323,20 @@ const ActorInfo actor_info_list[NUM_ACTOR_TYPES] = {
 
 void SetActorType(Actor * actor, ActorType type)
 {
+    // Once spawned, it's in the current map's list of actors of its type.
+    ActorList * list = NULL;
+    if ( actor->flags.in_use ) {
+        list = &actor->game->world.map->actor_list;
+        UnlinkActorFromType(list, actor);
+    }
+
     actor->info = &actor_info_list[type];
     actor->type = type;
 
+    if ( list ) {
+        LinkActorToType(list, actor);
+    }
+
     // Reset stats on change.
     actor->stats.health = actor->info->max_health;
     actor->stats.damage = actor->info->damage;
@@ -332,44 +345,18 @@ void SetActorType(Actor * actor, ActorType type)
 
 Actor * SpawnActor(Game * game, ActorType type, TileCoord coord)
 {
-    Actor * actor;
-    ActorList * list = &game->world.map->actor_list;
-
-    // If there are actors available in the unused list, grab one from there.
-    // Otherwise, allocate a new one.
-    if ( list->free_list ) {
-        actor = list->free_list;
-        list->free_list = actor->prev;
-    } else {
-        actor = calloc(1, sizeof(*actor));
-
-        if ( actor == NULL ) {
-            Error("Could not allocate Actor");
-        }
-    }
-
-    memset(actor, 0, sizeof(*actor));
-
-    // Append to active list.
-    if ( list->tail ) {
-        list->tail->next = actor;
-    }
-    actor->prev = list->tail; // ->next is already NULL.
-    list->tail = actor;
-
-    if ( list->head == NULL ) {
-        list->head = actor;
-    }
-
-    list->count++;
+    return SpawnActorInList(game, &game->world.map->actor_list, type, coord);
+}
 
-    // Init.
 
-    actor->game = game;
-    actor->tile = coord;
-    SetActorType(actor, type);
+/// A velocity in a random direction, with a random speed from `min_speed` to
+/// `max_speed`.
+static vec2_t RngVelocity(Rng * rng, float min_speed, float max_speed)
+{
+    float angle = RngFloat(rng, 0.0f, 2.0f * (float)M_PI);
+    float speed = RngFloat(rng, min_speed, max_speed);
 
-    return actor;
+    return (vec2_t){ cosf(angle) * speed, sinf(angle) * speed };
 }
 
 
@@ -380,13 +367,15 @@ void SpawnParticlesAtActor(const Actor * actor)
         .y = actor->tile.y * TILE_SIZE,
     };
 
+    Rng * rng = &actor->game->rng[RNG_PARTICLES];
+
     for ( int i = 0; i < 30; i++ ) {
         Particle p;
-        p.position.x = Random(position.x, position.x + TILE_SIZE);
-        p.position.y = Random(position.y, position.y + TILE_SIZE);
-        p.velocity = RandomVelocity(10.0f, 20.0f);
+        p.position.x = RngInt(rng, position.x, position.x + TILE_SIZE);
+        p.position.y = RngInt(rng, position.y, position.y + TILE_SIZE);
+        p.velocity = RngVelocity(rng, 10.0f, 20.0f);
         p.color = palette[actor->info->particle_color_palette_index];
-        p.lifespan = Random(MS2TICKS(200, FPS), MS2TICKS(400, FPS));
+        p.lifespan = RngInt(rng, MS2TICKS(200, FPS), MS2TICKS(400, FPS));
         InsertParticle(&actor->game->world.particles, p);
     }
 }
@@ -394,7 +383,7 @@ void SpawnParticlesAtActor(const Actor * actor)
 
 void KillActor(Actor * actor, Actor * killer)
 {
-    ActorType loot = SelectLoot(actor->type);
+    ActorType loot = SelectLoot(actor->type, &actor->game->rng[RNG_LOOT]);
 
     if ( loot != ACTOR_NONE ) {
         SpawnActor(actor->game, loot, actor->tile);
@@ -426,6 +415,8 @@ void KillActor(Actor * actor, Actor * killer)
 
 int DamageActor(Actor * actor, Actor * inflictor, int damage)
 {
+    CHECK_ACTOR(actor);
+
     actor->hit_timer = 1.0f;
     actor->flags.was_attacked = true;
 
@@ -443,12 +434,8 @@ void RenderActor(const Actor * actor, int x, int y, int size, bool debug, int ga
     SDL_Texture * actor_sheet = actor->game->render_info.actor_texture;
     const ActorSprite * sprite = &actor->info->sprite;
 
-    Tile * tile = GetTile(actor->game->world.map, actor->tile);
-    if ( !debug ) {
-        SDL_SetTextureColorMod(actor_sheet, tile->light, tile->light, tile->light);
-    } else {
-        SDL_SetTextureColorMod(actor_sheet, 255, 255, 255);
-    }
+    u8 light = debug ? 255 : GetTileLight(actor->game->world.map, actor->tile);
+    SDL_Color color = { light, light, light, 255 };
 
     SDL_Rect src;
     src.x = (sprite->cell.x + actor->frame) * TILE_SIZE;
@@ -483,7 +470,11 @@ void RenderActor(const Actor * actor, int x, int y, int size, bool debug, int ga
             .w = TILE_SIZE,
             .h = TILE_SIZE
         };
-        V_DrawTexture(actor_sheet, &shadow_sprite_location, &dst);
+        BatchSprite(actor_sheet,
+                    &shadow_sprite_location,
+                    &dst,
+                    color,
+                    SDL_FLIP_NONE);
     }
 
     // y position tweaks
@@ -496,57 +487,25 @@ void RenderActor(const Actor * actor, int x, int y, int size, bool debug, int ga
         }
     }
 
+    SDL_RendererFlip flip = SDL_FLIP_NONE;
     if ( actor->info->flags.directional && actor->flags.facing_left ) {
-        V_DrawTextureFlip(actor_sheet, &src, &dst, SDL_FLIP_HORIZONTAL);
-    } else {
-        V_DrawTexture(actor_sheet, &src, &dst);
-    }
-}
-
-
-void CastLight(World * world, const Actor * actor)
-{
-    int r = actor->info->light_radius;
-
-    if ( r == 0 ) {
-        return;
+        flip = SDL_FLIP_HORIZONTAL;
     }
 
-    TileCoord coord;
-    for ( coord.y = actor->tile.y - r; coord.y <= actor->tile.y + r; coord.y++ ) {
-        for ( coord.x = actor->tile.x - r; coord.x <= actor->tile.x + r; coord.x++ ) {
-            Tile * t = GetTile(world->map, coord);
-
-//            if ( t && LineOfSight(&game->map, actor->tile, coord, false))
-
-            if ( !t || !t->flags.visible ) {
-                continue;
-            }
-
-            if ( t && ManhattenPathsAreClear(world->map,
-                                             actor->tile.x,
-                                             actor->tile.y,
-                                             coord.x,
-                                             coord.y) )
-            {
-                if ( TileDistance(actor->tile, coord) <= r ) {
-                    if ( t->flags.revealed && actor->info->light > t->light ) {
-                        t->light = actor->info->light;
-                    }
-                }
-            }
-        }
-    }
+    BatchSprite(actor_sheet, &src, &dst, color, flip);
 }
 
+
 // TODO: This needs to be Move to tile with a helper function move direction!
 void MoveActor(Actor * actor, TileCoord coord)
 {
+    CHECK_ACTOR(actor);
+
     if ( !TileCoordsEqual(actor->tile, coord) ) {
         Direction direction = GetHorizontalDirection(coord.x - actor->tile.x);
 
         SetUpMoveAnimation(actor, coord);
-        actor->tile = coord;
+        SetActorTile(actor, coord);
         UpdateActorFacing(actor, XDelta(direction));
     }
 
@@ -568,14 +527,17 @@ bool ActorBlocksAll(const Actor * actor)
 
 bool TryMoveActor(Actor * actor, TileCoord coord)
 {
-    Tile * tile = GetTile(actor->game->world.map, coord);
+    CHECK_ACTOR(actor);
+
+    const Map * map = actor->game->world.map;
+    const TileFlags * flags = GetTileFlags(map, coord);
 
-    if ( tile->flags.blocks_movement ) {
+    if ( flags->blocks_movement ) {
         return false;
     }
 
     // Tile is player-only.
-    if ( actor->type != ACTOR_PLAYER && tile->flags.player_only ) {
+    if ( actor->type != ACTOR_PLAYER && flags->player_only ) {
         return false;
     }
 
@@ -585,37 +547,72 @@ bool TryMoveActor(Actor * actor, TileCoord coord)
 
     UpdateActorFacing(actor, dx);
 
-    // Check if there's an actor at try_x, try_y
-    FOR_EACH_ACTOR(hit, actor->game->world.map->actor_list) {
+    // Check if there's an actor at try_x, try_y. Contacts can spawn, remove,
+    // or move actors, so work from handles to the tile's actors.
+    ActorList * list = &actor->game->world.map->actor_list;
 
-        if ( hit != actor && TileCoordsEqual(hit->tile, coord) ) {
+    int num_hits = 0;
+    FOR_EACH_ACTOR_AT_TILE(hit, *list, coord) {
+        num_hits++;
+    }
 
-            // There's an actor on this spot:
+    ActorHandle tile_hits[MAX_ACTORS_PER_TILE];
+    ActorHandle * hits = tile_hits;
 
-            if ( actor->info->contact ) {
-                actor->info->contact(actor, hit);
-            }
+    // A pile bigger than usual. (Contacts can call back into here, so this
+    // can't be a shared buffer.)
+    if ( num_hits > MAX_ACTORS_PER_TILE ) {
+        hits = malloc(num_hits * sizeof(*hits));
+        if ( hits == NULL ) {
+            Error("could not allocate actor hits");
+        }
+    }
 
-            if ( hit->info->contacted ) {
-                hit->info->contacted(hit, actor);
-            }
+    int i = 0;
+    FOR_EACH_ACTOR_AT_TILE(hit, *list, coord) {
+        hits[i++] = GetActorHandle(hit);
+    }
 
-            // Bump into it?
-            bool blocks_monsters = hit->info->flags.blocks_monsters;
-            bool blocks_player = hit->info->flags.blocks_player;
-            bool is_player = actor->type == ACTOR_PLAYER;
+    bool block = false;
 
-            bool block =
-                (blocks_monsters && !is_player) ||
-                (blocks_player && is_player);
+    for ( i = 0; i < num_hits && !block; i++ ) {
+        Actor * hit = GetActor(list, hits[i]);
 
-            if ( block ) {
-                SetUpBumpAnimation(actor, direction);
-                return false;
-            }
+        // Removed or moved by an earlier contact.
+        if ( hit == NULL || hit == actor || !TileCoordsEqual(hit->tile, coord) ) {
+            continue;
+        }
+
+        // There's an actor on this spot:
+
+        // Bump into it? (Even if the contact kills it.)
+        bool blocks_monsters = hit->info->flags.blocks_monsters;
+        bool blocks_player = hit->info->flags.blocks_player;
+        bool is_player = actor->type == ACTOR_PLAYER;
+
+        block =
+            (blocks_monsters && !is_player) ||
+            (blocks_player && is_player);
+
+        if ( actor->info->contact ) {
+            actor->info->contact(actor, hit);
+        }
+
+        hit = GetActor(list, hits[i]); // The contact may have removed it.
+        if ( hit && hit->info->contacted ) {
+            hit->info->contacted(hit, actor);
         }
     }
 
+    if ( hits != tile_hits ) {
+        free(hits);
+    }
+
+    if ( block ) {
+        SetUpBumpAnimation(actor, direction);
+        return false;
+    }
+
     MoveActor(actor, coord);
     return true;
 }
@@ -631,22 +628,24 @@ void UpdateActorFacing(Actor * actor, int dx)
 // TODO: telefrag?
 void Teleport(Actor * actor)
 {
-    Map * map = actor->game->world.map;
+    const Map * map = actor->game->world.map;
 
-    Tile * entry_tile = GetTile(map, actor->tile);
-    int tag = entry_tile->tag;
+    int tag = GetTile(map, actor->tile)->tag;
 
     // Find the nearest teleport.
-    for ( int i = 0; i < map->width * map->height; i++ ) {
-        if (   map->tiles[i].type == TILE_TELEPORTER
-            && map->tiles[i].tag == tag
-            && &map->tiles[i] != entry_tile )
-        {
-            TileCoord exit_coord = GetCoordinate(map, i);
-
-            actor->tile = exit_coord;
-            MoveActor(actor, actor->tile); // TODO: hack, update sight etc.
-            return;
+    TileCoord coord;
+    for ( coord.y = 0; coord.y < map->height; coord.y++ ) {
+        for ( coord.x = 0; coord.x < map->width; coord.x++ ) {
+            const Tile * tile = GetTile(map, coord);
+
+            if (   tile->type == TILE_TELEPORTER
+                && tile->tag == tag
+                && !TileCoordsEqual(coord, actor->tile) )
+            {
+                SetActorTile(actor, coord);
+                MoveActor(actor, actor->tile); // TODO: hack, update sight etc.
+                return;
+            }
         }
     }
 
@@ -655,37 +654,32 @@ void Teleport(Actor * actor)
 }
 
 
-void RemoveActor(Actor * actor)
+void SetActorTile(Actor * actor, TileCoord coord)
 {
+    CHECK_ACTOR(actor);
+
     ActorList * list = &actor->game->world.map->actor_list;
 
-    // Remove from actor list.
-    if ( actor == list->tail ) {
-        list->tail = actor->prev;
-    } else {
-        actor->next->prev = actor->prev;
-    }
+    UnlinkActorFromTile(list, actor);
+    actor->tile = coord;
+    LinkActorToTile(list, actor);
+}
 
-    if ( actor == list->head ) {
-        list->head = list->head->next;
-    } else {
-        actor->prev->next = actor->next;
-    }
 
-    // Add to unused list.
-    actor->prev = list->free_list;
-    list->free_list = actor;
+void RemoveActor(Actor * actor)
+{
+    RemoveActorFromList(&actor->game->world.map->actor_list, actor);
 }
 
 
 // Include a padding since the camera may be mid-tile. For the y,
 // include extra padding in case there are tall actors visible
-static Actor ** visible_actors = NULL;
+static ActorRef * visible_actors = NULL;
 static int capacity = 0;
 
-Actor ** GetVisibleActors(const World * world,
-                          const RenderInfo * render_info,
-                          int * count)
+ActorRef * GetVisibleActors(const World * world,
+                            const RenderInfo * render_info,
+                            int * count)
 {
     Box vis_rect = GetCameraVisibleRegion(world->map, render_info);
     int w = (vis_rect.right - vis_rect.left) + 1;
@@ -695,7 +689,7 @@ Actor ** GetVisibleActors(const World * world,
     // Resize array if needed;
     if ( area > capacity ) {
         printf("area %d is greater than capacity %d, resizing\n", area, capacity);
-        size_t new_size = area * sizeof(Actor *);
+        size_t new_size = area * sizeof(*visible_actors);
         if ( capacity == 0 ) {
             visible_actors = malloc(new_size);
         } else {
@@ -712,10 +706,10 @@ Actor ** GetVisibleActors(const World * world,
     *count = 0;
 
     FOR_EACH_ACTOR_CONST(actor, world->map->actor_list) {
-        const Tile * tile = GetTile(world->map, actor->tile);
+        const TileFlags * flags = GetTileFlags((const Map *)world->map, actor->tile);
 
-        if ( tile->flags.visible && TileInBox(actor->tile, vis_rect) ) {
-            visible_actors[(*count)++] = (Actor *)actor; // fuck it
+        if ( flags->visible && TileInBox(actor->tile, vis_rect) ) {
+            visible_actors[(*count)++] = RefActor((Actor *)actor); // fuck it
         }
     }
 
@@ -18,12 +18,30 @@
 #include <stdbool.h>
 
 #define MAX_ACTORS (128 * 128)
+#define MAX_ACTORS_PER_TILE 16
 
+/// Removing `it` during the loop is fine. Actors spawned during the loop are
+/// not visited, even if they reuse a slot the loop hasn't reached yet.
 #define FOR_EACH_ACTOR(it, list) \
-    for (  Actor * it = list.head; it != NULL; it = it->next )
+    for ( u32 it##_spawned = (list).num_spawned, it##_once = 1; \
+          it##_once; \
+          it##_once = 0 ) \
+    for ( Actor * it = NextActor(&(list), NULL, it##_spawned); \
+          it != NULL; \
+          it = NextActor(&(list), it, it##_spawned) )
 
 #define FOR_EACH_ACTOR_CONST(it, list) \
-    for ( const Actor * it = list.head; it != NULL; it = it->next )
+    for ( u32 it##_spawned = (list).num_spawned, it##_once = 1; \
+          it##_once; \
+          it##_once = 0 ) \
+    for ( const Actor * it = NextActor(&(list), NULL, it##_spawned); \
+          it != NULL; \
+          it = NextActor(&(list), it, it##_spawned) )
+
+/// Don't remove or move `it` during the loop. To do that, copy the tile's
+/// actors first (see TryMoveActor).
+#define FOR_EACH_ACTOR_AT_TILE(it, list, coord) \
+    for ( Actor * it = GetActorAtTile(&list, coord); it != NULL; it = it->tile_next )
 
 
 typedef enum {
@@ -77,6 +95,7 @@ typedef struct {
 typedef struct game Game;
 typedef struct world World;
 typedef struct actor Actor;
+typedef struct actor_ref ActorRef;
 
 typedef struct {
     const char * name;
@@ -120,8 +139,16 @@ struct actor {
         bool was_attacked       : 1;
         bool has_target         : 1;
         bool on_teleporter      : 1; // TODO: move to PlayerInfo
+        bool in_use             : 1; // Its slot in the actor pool is.
     } flags;
 
+    // Slot in the actor list's pool. These outlive the actor: see ActorHandle.
+    int index;
+    u32 generation;
+    int next_free;
+
+    u32 spawn_number; // How many actors the list had spawned before this one.
+
     TileCoord tile;
 
     vec2_t offset_start;
@@ -135,18 +162,21 @@ struct actor {
 
     void (* animation)(Actor *, float move_timer);
 
-    Actor * prev;
-    Actor * next;
+    // Other actors on the same tile, in the actor list's tile grid.
+    Actor * tile_prev;
+    Actor * tile_next;
+
+    // Other actors of the same type, in the actor list's per-type lists.
+    Actor * type_prev;
+    Actor * type_next;
 };
 
 extern const ActorInfo actor_info_list[NUM_ACTOR_TYPES];
 
 bool ActorBlocksAll(const Actor * actor);
-/// Propogate actor's light to surrounding tiles by setting their `light_target`
-/// value.
-void CastLight(World * world, const Actor * actor);
 void SetActorType(Actor * actor, ActorType type);
 Actor * SpawnActor(Game * game, ActorType type, TileCoord coord);
+/// Batched: call FlushSprites() when done drawing actors.
 void RenderActor(const Actor * actor, int x, int y, int size, bool debug, int game_ticks);
 void MoveActor(Actor * actor, TileCoord coord);
 bool TryMoveActor(Actor * actor, TileCoord coord);
@@ -155,16 +185,18 @@ void KillActor(Actor * actor, Actor * killer);
 void UpdateActorFacing(Actor * actor, int dx);
 void Teleport(Actor * actor);
 
-/// Remove actor from linked list and return it to the free list.
-///
-/// When in a loop, if removing then immediately adding an actor, make sure
-/// to add the new actor first, then remove the old one. That way, the current
-/// pointer will remain pointing to the same actor (now in the free list).
+/// Put actor at `coord` without any animation or side effects.
+void SetActorTile(Actor * actor, TileCoord coord);
+
+/// Remove actor from the current map's actor list and return its slot to the
+/// free list. Any pointers to it are then stale, see ActorHandle.
 void RemoveActor(Actor * actor);
 
-Actor ** GetVisibleActors(const World * world,
-                          const RenderInfo * render_info,
-                          int * count);
+/// The array is reused by the next call, and its actors go stale once they're
+/// removed, so use it right away. See ActorRef.
+ActorRef * GetVisibleActors(const World * world,
+                            const RenderInfo * render_info,
+                            int * count);
 void FreeVisibleActorsArray(void);
 
 #endif /* actor_h */
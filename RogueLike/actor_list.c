@@ -6,110 +6,377 @@
 //
 
 #include "actor_list.h"
+#include "genlib.h"
 
-Actor * GetActorAtTile(const ActorList * actor_list, TileCoord coord)
+#include <string.h>
+
+/// - parameter allocate: Whether to allocate the tile's chunk if it doesn't
+///   exist yet. If not, returns NULL for tiles in unallocated chunks.
+static Actor ** TileHead(ActorList * list, TileCoord coord, bool allocate)
 {
-    for ( Actor * actor = actor_list->head; actor; actor = actor->next ) {
-        if (   actor->tile.x == coord.x
-            && actor->tile.y == coord.y ) {
-            return actor;
+    if (   list->chunks == NULL
+        || coord.x < 0 || coord.x >= list->width
+        || coord.y < 0 || coord.y >= list->height )
+    {
+        return NULL;
+    }
+
+    int chunk_x = coord.x / ACTOR_CHUNK_SIZE;
+    int chunk_y = coord.y / ACTOR_CHUNK_SIZE;
+    ActorChunk ** chunk = &list->chunks[chunk_y * list->chunks_wide + chunk_x];
+
+    if ( *chunk == NULL ) {
+        if ( !allocate ) {
+            return NULL;
         }
+
+        *chunk = calloc(1, sizeof(**chunk));
+        if ( *chunk == NULL ) {
+            Error("Could not allocate actor grid chunk");
+        }
+
+        list->num_chunks_allocated++;
     }
 
-    return NULL;
+    int x = coord.x % ACTOR_CHUNK_SIZE;
+    int y = coord.y % ACTOR_CHUNK_SIZE;
+
+    return &(*chunk)->tile_heads[y * ACTOR_CHUNK_SIZE + x];
 }
 
 
-Actor * FindActor(const ActorList * actor_list, ActorType type)
+Actor * GetActorAtTile(const ActorList * actor_list, TileCoord coord)
 {
-    for ( Actor * actor = actor_list->head; actor; actor = actor->next ) {
-        if ( actor->type == type ) {
-            return actor;
-        }
+    Actor ** head = TileHead((ActorList *)actor_list, coord, false);
+    return head ? *head : NULL;
+}
+
+
+/// Add actor to the end of the chain of actors on its tile.
+void LinkActorToTile(ActorList * list, Actor * actor)
+{
+    actor->tile_prev = NULL;
+    actor->tile_next = NULL;
+
+    Actor ** head = TileHead(list, actor->tile, true);
+    if ( head == NULL ) {
+        return; // Off the map or no grid yet.
     }
 
-    return NULL;
+    if ( *head == NULL ) {
+        *head = actor;
+        return;
+    }
+
+    Actor * last = *head;
+    while ( last->tile_next ) {
+        last = last->tile_next;
+    }
+
+    last->tile_next = actor;
+    actor->tile_prev = last;
 }
 
 
-const Actor * FindActorConst(const ActorList * actor_list, ActorType type)
+/// Remove actor from the chain of actors on its tile, if it's in one.
+void UnlinkActorFromTile(ActorList * list, Actor * actor)
+{
+    Actor ** head = TileHead(list, actor->tile, false);
+    if ( head == NULL ) {
+        return;
+    }
+
+    if ( actor->tile_prev ) {
+        actor->tile_prev->tile_next = actor->tile_next;
+    } else if ( *head == actor ) {
+        *head = actor->tile_next;
+    } else {
+        return; // Not linked.
+    }
+
+    if ( actor->tile_next ) {
+        actor->tile_next->tile_prev = actor->tile_prev;
+    }
+
+    actor->tile_prev = NULL;
+    actor->tile_next = NULL;
+}
+
+
+static void FreeActorChunks(ActorList * list)
 {
-    for ( const Actor * actor = actor_list->head; actor; actor = actor->next ) {
-        if ( actor->type == type ) {
-            return actor;
+    if ( list->chunks ) {
+        for ( int i = 0; i < list->chunks_wide * list->chunks_high; i++ ) {
+            free(list->chunks[i]);
         }
+
+        free(list->chunks);
+        list->chunks = NULL;
     }
 
-    return NULL;
+    list->num_chunks_allocated = 0;
+}
+
+
+/// Set the grid size to match the map, and re-add any active actors.
+void ResizeActorGrid(ActorList * list, int width, int height)
+{
+    FreeActorChunks(list);
+
+    list->chunks_wide = (width + ACTOR_CHUNK_SIZE - 1) / ACTOR_CHUNK_SIZE;
+    list->chunks_high = (height + ACTOR_CHUNK_SIZE - 1) / ACTOR_CHUNK_SIZE;
+    list->chunks = calloc(list->chunks_wide * list->chunks_high,
+                          sizeof(*list->chunks));
+    if ( list->chunks == NULL ) {
+        Error("Could not allocate actor grid");
+    }
+
+    list->width = width;
+    list->height = height;
+
+    FOR_EACH_ACTOR(actor, *list) {
+        LinkActorToTile(list, actor);
+    }
+}
+
+
+Actor * FindActor(const ActorList * actor_list, ActorType type)
+{
+    return actor_list->type_heads[type];
+}
+
+
+const Actor * FindActorConst(const ActorList * actor_list, ActorType type)
+{
+    return actor_list->type_heads[type];
 }
 
 
 int FindActors(const ActorList * actor_list, ActorType type, Actor * out[])
 {
     int count = 0;
-    for ( Actor * actor = actor_list->head; actor; actor = actor->next ) {
-        if ( actor->type == type ) {
-            out[count++] = actor;
-        }
+    for ( Actor * a = actor_list->type_heads[type]; a; a = a->type_next ) {
+        out[count++] = a;
     }
 
     return count;
 }
 
 
-void DestroyActorList(ActorList * list)
+/// Add actor to the front of the list of actors of its type.
+void LinkActorToType(ActorList * list, Actor * actor)
 {
-    Actor * actor;
-    Actor * temp;
+    Actor ** head = &list->type_heads[actor->type];
 
-    actor = list->head;
-    while ( actor ) {
-        temp = actor;
-        actor = actor->next;
-        free(temp);
+    actor->type_prev = NULL;
+    actor->type_next = *head;
+
+    if ( *head ) {
+        (*head)->type_prev = actor;
     }
 
-    list->head = NULL;
-    list->tail = NULL;
-    list->count = 0;
+    *head = actor;
+}
+
 
-    actor = list->free_list;
-    while ( actor ) {
-        temp = actor;
-        actor = actor->prev;
-        free(temp);
+void UnlinkActorFromType(ActorList * list, Actor * actor)
+{
+    if ( actor->type_prev ) {
+        actor->type_prev->type_next = actor->type_next;
+    } else if ( list->type_heads[actor->type] == actor ) {
+        list->type_heads[actor->type] = actor->type_next;
+    }
+
+    if ( actor->type_next ) {
+        actor->type_next->type_prev = actor->type_prev;
     }
+
+    actor->type_prev = NULL;
+    actor->type_next = NULL;
+}
+
+
+#pragma mark - Pool
+
+/// Get an unused slot, reusing a removed actor's if there is one.
+static Actor * AllocateSlot(ActorList * list)
+{
+    // With no slots used there are no free ones, though a zeroed list has
+    // `free_list` at 0.
+    if ( list->num_slots == 0 ) {
+        list->free_list = -1;
+        list->free_tail = -1;
+    }
+
+    if ( list->free_list != -1 ) {
+        Actor * actor = ActorInSlot(list, list->free_list);
+        list->free_list = actor->next_free;
+        if ( list->free_list == -1 ) {
+            list->free_tail = -1;
+        }
+        return actor;
+    }
+
+    if ( list->num_slots == MAX_ACTORS ) {
+        Error("Too many actors (max %d)", MAX_ACTORS);
+    }
+
+    int index = list->num_slots++;
+
+    if ( index / ACTOR_BLOCK_SIZE == list->num_blocks ) {
+        // Zeroed, so every slot starts at generation 0.
+        Actor * block = calloc(ACTOR_BLOCK_SIZE, sizeof(*block));
+        if ( block == NULL ) {
+            Error("Could not allocate actor block");
+        }
+
+        list->blocks[list->num_blocks++] = block;
+    }
+
+    Actor * actor = ActorInSlot(list, index);
+    actor->index = index;
+
+    return actor;
+}
+
+
+Actor * SpawnActorInList(Game * game, ActorList * list, ActorType type, TileCoord coord)
+{
+    Actor * actor = AllocateSlot(list);
+
+    // Clear all but the slot info.
+    *actor = (Actor){
+        .index = actor->index,
+        .generation = actor->generation,
+    };
+
+    list->count++;
+    actor->spawn_number = list->num_spawned++;
+
+    // Init.
+
+    actor->game = game;
+    actor->tile = coord;
+    SetActorType(actor, type); // Before it's in use, so it's not linked yet.
+    LinkActorToTile(list, actor);
+    LinkActorToType(list, actor);
+    actor->flags.in_use = true;
+
+    return actor;
+}
+
+
+/// The rest of the actor is left as is, so a loop can carry on from it.
+void RemoveActorFromList(ActorList * list, Actor * actor)
+{
+    CHECK_ACTOR(actor);
+
+    UnlinkActorFromTile(list, actor);
+    UnlinkActorFromType(list, actor);
+    list->count--;
+
+    actor->flags.in_use = false;
+    actor->generation++; // Handles to it are now stale.
+
+    // Reuse it last, so a stale pointer to it is as unlikely as can be to
+    // alias a new actor.
+    actor->next_free = -1;
+    if ( list->free_tail != -1 ) {
+        ActorInSlot(list, list->free_tail)->next_free = actor->index;
+    } else {
+        list->free_list = actor->index;
+    }
+    list->free_tail = actor->index;
+}
+
+
+ActorHandle GetActorHandle(const Actor * actor)
+{
+    CHECK_ACTOR(actor);
+    return (ActorHandle){ actor->index, actor->generation };
+}
+
+
+Actor * GetActor(const ActorList * list, ActorHandle handle)
+{
+    if ( handle.index < 0 || handle.index >= list->num_slots ) {
+        return NULL;
+    }
+
+    Actor * actor = ActorInSlot(list, handle.index);
+
+    if ( !actor->flags.in_use || actor->generation != handle.generation ) {
+        return NULL;
+    }
+
+    return actor;
+}
+
+
+void DestroyActorList(ActorList * list)
+{
+    for ( int i = 0; i < list->num_blocks; i++ ) {
+        free(list->blocks[i]);
+        list->blocks[i] = NULL;
+    }
+
+    list->num_blocks = 0;
+    list->num_slots = 0;
+    list->count = 0;
+    list->free_list = -1;
+    list->free_tail = -1;
+    memset(list->type_heads, 0, sizeof(list->type_heads));
+
+    FreeActorChunks(list);
 }
 
 
 void DebugPrintActorList(const ActorList * list)
 {
     printf("ACTOR LIST\n");
-    printf("count: %d\n", list->count);
+    printf("count: %d (%d slots)\n", list->count, list->num_slots);
 
-    Actor * actor = list->head;
-    int i = 0;
-    while ( actor ) {
+    FOR_EACH_ACTOR_CONST(actor, *list) {
         printf("%d: actor %2d (%3d, %3d)\n",
-               i, actor->type, actor->tile.x, actor->tile.y);
-        i++;
-        actor = actor->next;
+               actor->index, actor->type, actor->tile.x, actor->tile.y);
     }
 }
 
 
-/// Move all active actors to the unused list.
+/// Remove all active actors. Their blocks stay allocated for the next ones.
 void RemoveAllActors(ActorList * list)
 {
-    Actor * actor = list->head;
-
-    while ( actor ) {
-        actor->prev = list->free_list;
-        list->free_list = actor;
-        actor = actor->next;
+    FOR_EACH_ACTOR(actor, *list) {
+        actor->flags.in_use = false;
+        actor->generation++;
     }
 
-    list->head = NULL;
-    list->tail = NULL;
+    // Start again from the first slot, so the next level's actors are packed.
+    memset(list->type_heads, 0, sizeof(list->type_heads));
+    list->num_slots = 0;
     list->count = 0;
+    list->free_list = -1;
+    list->free_tail = -1;
+
+    // Chunks stay allocated for the next actors.
+    if ( list->chunks ) {
+        for ( int i = 0; i < list->chunks_wide * list->chunks_high; i++ ) {
+            if ( list->chunks[i] ) {
+                memset(list->chunks[i], 0, sizeof(*list->chunks[i]));
+            }
+        }
+    }
+}
+
+
+size_t ActorPoolMemoryUsage(const ActorList * list)
+{
+    return list->num_blocks * ACTOR_BLOCK_SIZE * sizeof(Actor);
+}
+
+
+size_t ActorGridMemoryUsage(const ActorList * list)
+{
+    size_t table = list->chunks_wide * list->chunks_high * sizeof(*list->chunks);
+    return table + list->num_chunks_allocated * sizeof(ActorChunk);
 }
@@ -10,31 +10,176 @@
 
 #include "actor.h"
 #include "tile.h"
+#include "genlib.h"
 
 typedef struct actor Actor;
 
+#define ACTOR_CHUNK_SIZE 16 // Occupancy grid chunk width and height, in tiles.
+#define ACTOR_BLOCK_SIZE 256 // Actors per pool block. Must be a power of two.
+#define MAX_ACTOR_BLOCKS (MAX_ACTORS / ACTOR_BLOCK_SIZE)
+
+typedef struct {
+    Actor * tile_heads[ACTOR_CHUNK_SIZE * ACTOR_CHUNK_SIZE];
+} ActorChunk;
+
+/// Refers to an actor without keeping a pointer to it, which would go on
+/// pointing at the actor's slot after it's removed and the slot is reused.
+/// An actor's slot index and the slot's generation at the time the handle
+/// was made; the generation changes whenever the actor in the slot is
+/// removed, which makes the handle stale.
+typedef struct {
+    int index;
+    u32 generation;
+} ActorHandle;
+
 typedef struct {
-    // Active actor list.
-    Actor * head;
-    Actor * tail;
-    int count;
-
-    // Unused actor list. Where actors go when they're removed.
-    // Actors and are added back from here when spawning new ones.
-    Actor * free_list;
+    // Actor pool: slots are allocated in blocks, which are only allocated once
+    // needed and stay put, so actor pointers remain valid until the actor is
+    // removed. Slot `i` is blocks[i / ACTOR_BLOCK_SIZE][i % ACTOR_BLOCK_SIZE].
+    // Actors are iterated in slot order, skipping unused slots.
+    Actor * blocks[MAX_ACTOR_BLOCKS];
+    int num_blocks;
+    int num_slots; // Slots used so far. Iteration stops here.
+    int count; // Active actors.
+    u32 num_spawned; // Ever, numbering each actor's `spawn_number`.
+
+    // Unused slots below `num_slots`, chained via `next_free`, oldest first.
+    // Removed actors go on the end, and spawning reuses the slot that's been
+    // free the longest.
+    int free_list; // -1 if none.
+    int free_tail;
+
+    // The most recently spawned actor of each type, chained to the others of
+    // that type via `type_next`. The player is `type_heads[ACTOR_PLAYER]`.
+    Actor * type_heads[NUM_ACTOR_TYPES];
+
+    // Occupancy grid: the first actor on each map tile, chained to the others
+    // via `tile_next`. Stored in chunks, which are only allocated once an
+    // actor is placed in them.
+    ActorChunk ** chunks;
+    int chunks_wide;
+    int chunks_high;
+    int num_chunks_allocated;
+    int width;
+    int height;
 } ActorList;
 
 // List operations.
 
+/// Add a new actor to `list`, which needn't be the current map's.
+Actor * SpawnActorInList(Game * game, ActorList * list, ActorType type, TileCoord coord);
+void RemoveActorFromList(ActorList * list, Actor * actor);
 void DestroyActorList(ActorList * list);
 void RemoveAllActors(ActorList * list);
 void DebugPrintActorList(const ActorList * list);
+size_t ActorPoolMemoryUsage(const ActorList * list);
+
+// Iteration. See FOR_EACH_ACTOR.
+
+static inline Actor * ActorInSlot(const ActorList * list, int index)
+{
+    return &list->blocks[index / ACTOR_BLOCK_SIZE][index % ACTOR_BLOCK_SIZE];
+}
+
+/// The next active actor after `actor`, in slot order, or the first if
+/// `actor` is NULL. Only actors numbered below `spawned` are included, so a
+/// loop can leave out any spawned since it began. Returns NULL if there are no
+/// more.
+static inline Actor * NextActor(const ActorList * list,
+                                const Actor * actor,
+                                u32 spawned)
+{
+    int i = actor ? actor->index + 1 : 0;
+
+    // Step through the block rather than look up each slot, so the next
+    // slot's address doesn't wait on reading this one's index.
+    Actor * slot = actor ? (Actor *)actor + 1 : NULL;
+
+    for ( ; i < list->num_slots; i++, slot++ ) {
+        if ( i % ACTOR_BLOCK_SIZE == 0 ) {
+            slot = list->blocks[i / ACTOR_BLOCK_SIZE];
+        }
+
+        if ( slot->flags.in_use && slot->spawn_number < spawned ) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+// Handles.
+
+ActorHandle GetActorHandle(const Actor * actor);
+
+/// Get the actor `handle` refers to, or NULL if it's been removed.
+Actor * GetActor(const ActorList * list, ActorHandle handle);
+
+#if DEBUG
+/// Catch an actor pointer being used after its actor was removed. Only while
+/// the slot is unused: see ActorRef to catch it being reused.
+#define CHECK_ACTOR(actor) ASSERT((actor)->flags.in_use)
+#else
+#define CHECK_ACTOR(actor)
+#endif
+
+/// An actor pointer that's held onto for a while, such as a list of the
+/// visible actors. Debug builds also keep the actor's handle, so that using
+/// it after the actor is removed is caught even once another actor is in the
+/// slot.
+struct actor_ref {
+    Actor * actor;
+#if DEBUG
+    ActorHandle handle;
+#endif
+};
+
+static inline ActorRef RefActor(Actor * actor)
+{
+    CHECK_ACTOR(actor);
+
+    ActorRef ref = { .actor = actor };
+#if DEBUG
+    ref.handle = (ActorHandle){ actor->index, actor->generation };
+#endif
+
+    return ref;
+}
+
+/// The actor `ref` refers to, which must not have been removed.
+static inline Actor * DerefActor(ActorRef ref)
+{
+#if DEBUG
+    CHECK_ACTOR(ref.actor);
+    ASSERT(ref.actor->index == ref.handle.index);
+    ASSERT(ref.actor->generation == ref.handle.generation);
+#endif
+
+    return ref.actor;
+}
+
+// Occupancy grid ops.
+
+void ResizeActorGrid(ActorList * list, int width, int height);
+size_t ActorGridMemoryUsage(const ActorList * list);
+void LinkActorToTile(ActorList * list, Actor * actor);
+void UnlinkActorFromTile(ActorList * list, Actor * actor);
 
 // Search ops.
 
+/// Get the first actor at `coord`, or NULL if none. Any other actors on the
+/// same tile follow via `tile_next`.
 Actor * GetActorAtTile(const ActorList * actor_list, TileCoord coord);
+
+/// Get the most recently spawned actor of `type`, or NULL if none. Any others
+/// of the same type follow via `type_next`.
 Actor * FindActor(const ActorList * actor_list, ActorType type);
 const Actor * FindActorConst(const ActorList * actor_list, ActorType type);
 int FindActors(const ActorList * actor_list, ActorType type, Actor * out[]);
 
+// Type list ops.
+
+void LinkActorToType(ActorList * list, Actor * actor);
+void UnlinkActorFromType(ActorList * list, Actor * actor);
+
 #endif /* actors_h */
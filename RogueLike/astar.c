@@ -7,143 +7,359 @@
 
 #include "astar.h"
 
+#include <string.h>
+
+#define NOT_IN_HEAP (-1)
+#define NODE_CHUNK_SHIFT (MAP_CHUNK_SHIFT * 2)
+
 typedef struct {
-    TileCoord parent;
-    float cost;
-    float heuristic;
-    bool visited;
-    bool blocked;
+    u32 generation; // The search that last touched this node.
+    int parent; // Node index, or -1 for the start node.
+    int cost; // Steps from start.
+    int estimate; // cost + heuristic
+    int heap_index; // Position in the open heap, or NOT_IN_HEAP if closed.
 } Node;
 
-Node * grid;
-int grid_size;
-int grid_width;
-TileCoord * open_list;
+typedef struct {
+    Node nodes[MAP_CHUNK_AREA];
+} NodeChunk;
+
+// A node per map tile, in chunks that are allocated (zeroed) when a search
+// first reaches a tile in them. A node's index is its chunk's index and its
+// index in the chunk, see NodeIndex().
+static NodeChunk ** node_chunks;
+static int node_chunks_wide;
+static int node_chunks_high;
+static int num_node_chunks;
+static u32 generation;
 
-static float Heuristic(TileCoord start, TileCoord end)
+/// The open list: a binary min-heap of node indices keyed on estimate. It
+/// grows to the most nodes a search has had open.
+static int * heap;
+static int heap_count;
+static int heap_capacity;
+
+// Search statistics, mostly for benchmarking.
+static int nodes_expanded;
+
+static int Heuristic(TileCoord start, TileCoord end, bool diagonal)
 {
-    // Calculate the Manhattan distance between two points
-    return abs(end.x - start.x) + abs(end.y - start.y);
+    int dx = abs(end.x - start.x);
+    int dy = abs(end.y - start.y);
+
+    // With unit-cost diagonal moves, Chebyshev distance is the tight bound;
+    // otherwise Manhattan.
+    return diagonal ? MAX(dx, dy) : dx + dy;
 }
 
-#define NODE(coord) grid[coord.y * grid_width + coord.x]
+static bool TileHasBlockingActor(const Map * map, TileCoord coord)
+{
+    FOR_EACH_ACTOR_AT_TILE(actor, map->actor_list, coord) {
+        if ( ActorBlocksAll(actor) ) {
+            return true;
+        }
+    }
 
-Path FindPath(World * world, TileCoord start, TileCoord end, bool diagonal)
+    return false;
+}
+
+static int NodeIndex(TileCoord coord)
 {
-    Map * map = world->map;
-    Path path;
-    path.size = 0;
+    int chunk = (coord.y >> MAP_CHUNK_SHIFT) * node_chunks_wide + (coord.x >> MAP_CHUNK_SHIFT);
+    return chunk << NODE_CHUNK_SHIFT | TileChunkIndex(coord.x, coord.y);
+}
+
+static TileCoord NodeCoord(int node_index)
+{
+    int chunk = node_index >> NODE_CHUNK_SHIFT;
+    int i = node_index & (MAP_CHUNK_AREA - 1);
+
+    return (TileCoord){
+        (chunk % node_chunks_wide) << MAP_CHUNK_SHIFT | (i & (MAP_CHUNK_SIZE - 1)),
+        (chunk / node_chunks_wide) << MAP_CHUNK_SHIFT | i >> MAP_CHUNK_SHIFT
+    };
+}
+
+/// A node already reached in this search.
+static Node * GetNode(int node_index)
+{
+    return &node_chunks[node_index >> NODE_CHUNK_SHIFT]->nodes[node_index & (MAP_CHUNK_AREA - 1)];
+}
+
+/// A node that might not have been reached yet, allocating its chunk if needed.
+static Node * ReachNode(int node_index)
+{
+    NodeChunk ** chunk = &node_chunks[node_index >> NODE_CHUNK_SHIFT];
 
-    grid_width = map->width;
+    if ( *chunk == NULL ) {
+        *chunk = calloc(1, sizeof(**chunk));
+        if ( *chunk == NULL ) {
+            Error("could not allocate path finding nodes");
+        }
+        num_node_chunks++;
+    }
+
+    return &(*chunk)->nodes[node_index & (MAP_CHUNK_AREA - 1)];
+}
+
+#pragma mark - Heap
+
+/// Whether node `a` should be popped before node `b`. Ties are broken in favor
+/// of the node with greater cost (i.e., closer to the goal), which keeps the
+/// search from fanning out across plateaus of equal estimate.
+static bool HeapLess(int a, int b)
+{
+    const Node * node_a = GetNode(a);
+    const Node * node_b = GetNode(b);
+
+    if ( node_a->estimate != node_b->estimate ) {
+        return node_a->estimate < node_b->estimate;
+    }
+
+    return node_a->cost > node_b->cost;
+}
+
+static void HeapSet(int heap_index, int node_index)
+{
+    heap[heap_index] = node_index;
+    GetNode(node_index)->heap_index = heap_index;
+}
+
+static void SiftUp(int i)
+{
+    int node_index = heap[i];
+
+    while ( i > 0 ) {
+        int parent = (i - 1) / 2;
+        if ( !HeapLess(node_index, heap[parent]) ) {
+            break;
+        }
+        HeapSet(i, heap[parent]);
+        i = parent;
+    }
+
+    HeapSet(i, node_index);
+}
+
+static void SiftDown(int i)
+{
+    int node_index = heap[i];
+
+    while ( true ) {
+        int child = i * 2 + 1;
+        if ( child >= heap_count ) {
+            break;
+        }
 
-    int size_needed = map->width * map->height;
-    if ( size_needed > grid_size ) {
-        size_t new_size = size_needed * sizeof(*grid);
-        if ( grid == NULL ) {
-            grid = malloc(new_size);
-        } else {
-            grid = realloc(grid, new_size);
+        if ( child + 1 < heap_count && HeapLess(heap[child + 1], heap[child]) ) {
+            child++;
         }
 
-        if ( open_list == NULL ) {
-            open_list = malloc(size_needed * sizeof(*open_list));
-        } else {
-            open_list = realloc(open_list, sizeof(*open_list));
+        if ( !HeapLess(heap[child], node_index) ) {
+            break;
         }
 
-        ASSERT(grid != NULL);
-        ASSERT(open_list != NULL);
-        grid_size = size_needed;
+        HeapSet(i, heap[child]);
+        i = child;
     }
 
-    for ( int i = 0; i < grid_size; i++ ) {
-        grid[i].parent.x = -1;
-        grid[i].parent.y = -1;
-        grid[i].cost = 0.0f;
-        grid[i].heuristic = 0.0f;
-        grid[i].visited = false;
-        grid[i].blocked = false;
+    HeapSet(i, node_index);
+}
+
+static void HeapPush(int node_index)
+{
+    if ( heap_count == heap_capacity ) {
+        heap_capacity = heap_capacity ? heap_capacity * 2 : 1024;
+        heap = realloc(heap, heap_capacity * sizeof(*heap));
+        if ( heap == NULL ) {
+            Error("could not allocate path finding nodes");
+        }
     }
 
-    FOR_EACH_ACTOR(actor, world->map->actor_list) {
-        if ( ActorBlocksAll(actor) ) {
-            grid[actor->tile.y * map->width + actor->tile.x].blocked = true;
+    heap[heap_count] = node_index;
+    SiftUp(heap_count++);
+}
+
+static int HeapPop(void)
+{
+    int top = heap[0];
+    GetNode(top)->heap_index = NOT_IN_HEAP;
+
+    if ( --heap_count > 0 ) {
+        heap[0] = heap[heap_count];
+        SiftDown(0);
+    }
+
+    return top;
+}
+
+#pragma mark -
+
+/// Make sure there's a node chunk table for `map` and start a new search
+/// generation. Nodes from previous searches are simply ignored, so there's no
+/// per-call reset of the nodes.
+static void BeginSearch(const Map * map)
+{
+    int chunks_wide = ChunksToCover(map->width);
+    int chunks_high = ChunksToCover(map->height);
+
+    if (   node_chunks == NULL
+        || node_chunks_wide != chunks_wide
+        || node_chunks_high != chunks_high )
+    {
+        FreePathNodes();
+
+        node_chunks = calloc(chunks_wide * chunks_high, sizeof(*node_chunks));
+        if ( node_chunks == NULL ) {
+            Error("could not allocate path finding nodes");
         }
+
+        node_chunks_wide = chunks_wide;
+        node_chunks_high = chunks_high;
+        generation = 0;
     }
 
-    NODE(start).cost = 0.0f;
-    NODE(start).heuristic = Heuristic(start, end);
-    NODE(start).visited = true;
-
-    int open_list_size = 1;
-    open_list[0] = start;
-
-    while ( open_list_size > 0 ) {
-        // Find the tile with the lowest cost in the open list
-        int index = 0;
-        float lowest_cost = NODE(open_list[0]).cost + NODE(open_list[0]).heuristic;
-        for ( int i = 1; i < open_list_size; i++ ) {
-            float cost = NODE(open_list[i]).cost + NODE(open_list[i]).heuristic;
-            if ( cost < lowest_cost ) {
-                lowest_cost = cost;
-                index = i;
+    if ( ++generation == 0 ) {
+        // Wrapped around: stale nodes could now look current.
+        for ( int i = 0; i < node_chunks_wide * node_chunks_high; i++ ) {
+            if ( node_chunks[i] ) {
+                memset(node_chunks[i], 0, sizeof(*node_chunks[i]));
             }
         }
+        generation = 1;
+    }
+
+    heap_count = 0;
+    nodes_expanded = 0;
+}
+
+Path FindPath(World * world, TileCoord start, TileCoord end, bool diagonal)
+{
+    const Map * map = world->map;
+    Path path;
+    path.size = 0;
+
+    if (   !IsInBounds(map, start.x, start.y)
+        || !IsInBounds(map, end.x, end.y) )
+    {
+        return path;
+    }
+
+    BeginSearch(map);
 
-        TileCoord current = open_list[index];
+    int start_index = NodeIndex(start);
+    int end_index = NodeIndex(end);
 
-        // Remove the current tile from the open list
-        open_list[index] = open_list[--open_list_size];
+    Node * start_node = ReachNode(start_index);
+    start_node->generation = generation;
+    start_node->parent = -1;
+    start_node->cost = 0;
+    start_node->estimate = Heuristic(start, end, diagonal);
+    HeapPush(start_index);
 
-        if ( current.x == end.x && current.y == end.y ) {
+    static const TileCoord offsets[8] = {
+        { -1,  0 }, {  1,  0 }, {  0, -1 }, {  0,  1 },
+        { -1, -1 }, {  1, -1 }, { -1,  1 }, {  1,  1 }
+    };
+    int num_directions = diagonal ? 8 : 4;
+
+    while ( heap_count > 0 ) {
+        int current_index = HeapPop();
+        nodes_expanded++;
+
+        if ( current_index == end_index ) {
             // Goal reached, construct path
-            TileCoord current_coord = current;
+            int index = current_index;
 
-            while ( current_coord.x != -1 && current_coord.y != -1 ) {
-                path.coords[path.size++] = current_coord;
+            while ( index != -1 ) {
+                path.coords[path.size++] = NodeCoord(index);
                 if ( path.size == PATH_MAX_COORDS) {
                     break;
                 }
-                current_coord = NODE(current_coord).parent;
+                index = GetNode(index)->parent;
             }
 
             return path;
         }
 
-        TileCoord neighbors[8] = {
-            { current.x - 1, current.y },
-            { current.x + 1, current.y },
-            { current.x, current.y - 1 },
-            { current.x, current.y + 1 },
-            { current.x - 1, current.y - 1 },
-            { current.x + 1, current.y - 1 },
-            { current.x - 1, current.y + 1 },
-            { current.x + 1, current.y + 1 }
-        };
-
-        int num_directions = diagonal ? 8 : 4;
+        TileCoord current_coord = NodeCoord(current_index);
+        int neighbor_cost = GetNode(current_index)->cost + 1;
+
         for ( int i = 0; i < num_directions; i++ ) {
-            TileCoord neighbor = neighbors[i];
-            Tile * tile = GetTile(map, neighbor);
+            TileCoord neighbor = {
+                current_coord.x + offsets[i].x,
+                current_coord.y + offsets[i].y
+            };
 
-            if ( tile->flags.blocks_movement ) continue;
             if ( !IsInBounds(map, neighbor.x, neighbor.y) ) continue;
-            if ( NODE(neighbor).visited ) continue;
-            if ( NODE(neighbor).blocked ) continue;
 
-            // Visit this tile:
+            if ( GetTileFlags(map, neighbor)->blocks_movement ) continue;
 
-            float neighbor_cost = NODE(current).cost + 1.0f;
+            int index = NodeIndex(neighbor);
+            Node * node = ReachNode(index);
 
-            NODE(neighbor).parent = current;
-            NODE(neighbor).cost = neighbor_cost;
-            NODE(neighbor).heuristic = Heuristic(neighbor, end);
-            NODE(neighbor).visited = true;
+            if ( node->generation != generation ) {
+                // Tiles occupied by blocking actors are impassable, except for
+                // the end tile (e.g., the searcher's target).
+                if ( index != end_index && TileHasBlockingActor(map, neighbor) ) {
+                    continue;
+                }
+
+                // First time seeing this node in this search.
+                node->generation = generation;
+                node->parent = current_index;
+                node->cost = neighbor_cost;
+                node->estimate = neighbor_cost + Heuristic(neighbor, end, diagonal);
+                HeapPush(index);
+            } else if ( node->heap_index != NOT_IN_HEAP
+                       && neighbor_cost < node->cost ) {
+                // Found a cheaper way to an open node.
+                node->parent = current_index;
+                node->estimate -= node->cost - neighbor_cost;
+                node->cost = neighbor_cost;
+                SiftUp(node->heap_index);
+            }
 
-            open_list[open_list_size++] = neighbor;
+            // Otherwise, the node is closed. With a consistent heuristic, a
+            // closed node's cost is already optimal.
         }
     }
 
     // No path found.
     return path;
 }
+
+int PathNodesExpanded(void)
+{
+    return nodes_expanded;
+}
+
+size_t PathNodesMemoryUsage(void)
+{
+    size_t usage = heap_capacity * sizeof(*heap);
+
+    if ( node_chunks ) {
+        usage += node_chunks_wide * node_chunks_high * sizeof(*node_chunks)
+            + num_node_chunks * sizeof(NodeChunk);
+    }
+
+    return usage;
+}
+
+void FreePathNodes(void)
+{
+    if ( node_chunks ) {
+        for ( int i = 0; i < node_chunks_wide * node_chunks_high; i++ ) {
+            free(node_chunks[i]);
+        }
+        free(node_chunks);
+    }
+
+    free(heap);
+    node_chunks = NULL;
+    node_chunks_wide = 0;
+    node_chunks_high = 0;
+    num_node_chunks = 0;
+    heap = NULL;
+    heap_capacity = 0;
+}
@@ -17,6 +17,18 @@ typedef struct {
     int size;
 } Path;
 
+/// Find a shortest path from `start` to `end` with A*.
+/// - parameter diagonal: Allow diagonal moves, which cost the same as
+///   orthogonal moves.
+/// - returns: The path from `end` back to `start` (inclusive), or an empty path
+///   if `end` can't be reached. Long paths are truncated at `PATH_MAX_COORDS`.
 Path FindPath(World * world, TileCoord start, TileCoord end, bool diagonal);
 
+/// The number of nodes expanded by the last call to `FindPath`.
+int PathNodesExpanded(void);
+
+/// Bytes allocated for the search nodes, which are shared by all maps.
+size_t PathNodesMemoryUsage(void);
+void FreePathNodes(void);
+
 #endif /* astar_h */
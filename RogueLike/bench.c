@@ -0,0 +1,834 @@
+//
+//  bench.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/2/23.
+//
+
+#include "bench.h"
+#include "astar.h"
+#include "fov.h"
+#include "mathlib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_PATH_PAIRS 2000
+#define STRESS_ROUNDS 20
+#define FOV_ORIGINS 2000
+#define TILE_PASS_SEEDS 3
+#define TILE_PASS_REPEATS 50
+#define BENCH_SEED 1
+
+/// Each benchmark draws from its own stream of BENCH_SEED, so its results
+/// don't depend on the game or on which benchmarks ran before it.
+typedef enum {
+    BENCH_RNG_PATHS,
+    BENCH_RNG_ACTORS,
+    BENCH_RNG_FOV,
+    BENCH_RNG_TILE_PASSES,
+} BenchRngStream;
+
+#pragma mark - Reference A*
+
+// FindPath as of the baseline commit, copied verbatim so the heap version is
+// measured against what actually shipped, bugs and all. Only the names are
+// prefixed, the globals made static, and the tile flag lookup follows the
+// tile_flags plane split.
+
+typedef struct {
+    TileCoord parent;
+    float cost;
+    float heuristic;
+    bool visited;
+    bool blocked;
+} RefNode;
+
+static RefNode * ref_grid;
+static int ref_grid_size;
+static int ref_grid_width;
+static TileCoord * ref_open_list;
+
+static float RefHeuristic(TileCoord start, TileCoord end)
+{
+    // Calculate the Manhattan distance between two points
+    return abs(end.x - start.x) + abs(end.y - start.y);
+}
+
+#define REF_NODE(coord) ref_grid[coord.y * ref_grid_width + coord.x]
+
+static Path RefFindPath(World * world, TileCoord start, TileCoord end, bool diagonal)
+{
+    const Map * map = world->map;
+    Path path;
+    path.size = 0;
+
+    ref_grid_width = map->width;
+
+    int size_needed = map->width * map->height;
+    if ( size_needed > ref_grid_size ) {
+        size_t new_size = size_needed * sizeof(*ref_grid);
+        if ( ref_grid == NULL ) {
+            ref_grid = malloc(new_size);
+        } else {
+            ref_grid = realloc(ref_grid, new_size);
+        }
+
+        if ( ref_open_list == NULL ) {
+            ref_open_list = malloc(size_needed * sizeof(*ref_open_list));
+        } else {
+            ref_open_list = realloc(ref_open_list, sizeof(*ref_open_list));
+        }
+
+        ASSERT(ref_grid != NULL);
+        ASSERT(ref_open_list != NULL);
+        ref_grid_size = size_needed;
+    }
+
+    for ( int i = 0; i < ref_grid_size; i++ ) {
+        ref_grid[i].parent.x = -1;
+        ref_grid[i].parent.y = -1;
+        ref_grid[i].cost = 0.0f;
+        ref_grid[i].heuristic = 0.0f;
+        ref_grid[i].visited = false;
+        ref_grid[i].blocked = false;
+    }
+
+    FOR_EACH_ACTOR(actor, world->map->actor_list) {
+        if ( ActorBlocksAll(actor) ) {
+            ref_grid[actor->tile.y * map->width + actor->tile.x].blocked = true;
+        }
+    }
+
+    REF_NODE(start).cost = 0.0f;
+    REF_NODE(start).heuristic = RefHeuristic(start, end);
+    REF_NODE(start).visited = true;
+
+    int open_list_size = 1;
+    ref_open_list[0] = start;
+
+    while ( open_list_size > 0 ) {
+        // Find the tile with the lowest cost in the open list
+        int index = 0;
+        float lowest_cost = REF_NODE(ref_open_list[0]).cost + REF_NODE(ref_open_list[0]).heuristic;
+        for ( int i = 1; i < open_list_size; i++ ) {
+            float cost = REF_NODE(ref_open_list[i]).cost + REF_NODE(ref_open_list[i]).heuristic;
+            if ( cost < lowest_cost ) {
+                lowest_cost = cost;
+                index = i;
+            }
+        }
+
+        TileCoord current = ref_open_list[index];
+
+        // Remove the current tile from the open list
+        ref_open_list[index] = ref_open_list[--open_list_size];
+
+        if ( current.x == end.x && current.y == end.y ) {
+            // Goal reached, construct path
+            TileCoord current_coord = current;
+
+            while ( current_coord.x != -1 && current_coord.y != -1 ) {
+                path.coords[path.size++] = current_coord;
+                if ( path.size == PATH_MAX_COORDS) {
+                    break;
+                }
+                current_coord = REF_NODE(current_coord).parent;
+            }
+
+            return path;
+        }
+
+        TileCoord neighbors[8] = {
+            { current.x - 1, current.y },
+            { current.x + 1, current.y },
+            { current.x, current.y - 1 },
+            { current.x, current.y + 1 },
+            { current.x - 1, current.y - 1 },
+            { current.x + 1, current.y - 1 },
+            { current.x - 1, current.y + 1 },
+            { current.x + 1, current.y + 1 }
+        };
+
+        int num_directions = diagonal ? 8 : 4;
+        for ( int i = 0; i < num_directions; i++ ) {
+            TileCoord neighbor = neighbors[i];
+            const TileFlags * flags = GetTileFlags(map, neighbor);
+
+            if ( flags->blocks_movement ) continue;
+            if ( !IsInBounds(map, neighbor.x, neighbor.y) ) continue;
+            if ( REF_NODE(neighbor).visited ) continue;
+            if ( REF_NODE(neighbor).blocked ) continue;
+
+            // Visit this tile:
+
+            float neighbor_cost = REF_NODE(current).cost + 1.0f;
+
+            REF_NODE(neighbor).parent = current;
+            REF_NODE(neighbor).cost = neighbor_cost;
+            REF_NODE(neighbor).heuristic = RefHeuristic(neighbor, end);
+            REF_NODE(neighbor).visited = true;
+
+            ref_open_list[open_list_size++] = neighbor;
+        }
+    }
+
+    // No path found.
+    return path;
+}
+
+#pragma mark - Path Finding
+
+typedef struct {
+    float msec;
+    int found;
+    int total_length;
+} PathResults;
+
+/// Pick `count` random walkable start/end pairs on the current map.
+static int GetRandomPairs(const Map * map, TileCoord * pairs, int count, Rng * rng)
+{
+    int num_tiles = map->width * map->height;
+    int num_open = 0;
+
+    for ( int i = 0; i < num_tiles; i++ ) {
+        if ( !GetTileFlags(map, GetCoordinate(map, i))->blocks_movement ) {
+            num_open++;
+        }
+    }
+
+    if ( num_open < 2 ) {
+        return 0;
+    }
+
+    for ( int i = 0; i < count * 2; i++ ) {
+        TileCoord coord;
+        do {
+            coord = GetCoordinate(map, RngInt(rng, 0, num_tiles - 1));
+        } while ( GetTileFlags(map, coord)->blocks_movement );
+        pairs[i] = coord;
+    }
+
+    return count;
+}
+
+static PathResults RunPaths(World * world,
+                            const TileCoord * pairs,
+                            int count,
+                            bool diagonal,
+                            Path (* find)(World *, TileCoord, TileCoord, bool))
+{
+    PathResults results = { 0 };
+
+    float start = ProgramTime();
+    for ( int i = 0; i < count; i++ ) {
+        Path path = find(world, pairs[i * 2], pairs[i * 2 + 1], diagonal);
+        if ( path.size > 0 ) {
+            results.found++;
+            results.total_length += path.size;
+        }
+    }
+    results.msec = (ProgramTime() - start) * 1000.0f;
+
+    return results;
+}
+
+static void PrintPathResults(const char * name, PathResults results, int count)
+{
+    printf("  %-8s %9.2f ms (%7.4f ms/path) found %d/%d, avg length %.1f\n",
+           name,
+           results.msec,
+           results.msec / count,
+           results.found,
+           count,
+           results.found ? (float)results.total_length / results.found : 0.0f);
+}
+
+static void BenchmarkCurrentMap(World * world, const char * name, Rng * rng)
+{
+    static TileCoord pairs[BENCH_PATH_PAIRS * 2];
+    int count = GetRandomPairs(world->map, pairs, BENCH_PATH_PAIRS, rng);
+
+    if ( count == 0 ) {
+        printf("%s: no open tiles!\n", name);
+        return;
+    }
+
+    for ( int diagonal = 0; diagonal <= 1; diagonal++ ) {
+        printf("%s %dx%d, %d pairs, %s:\n",
+               name,
+               world->map->width,
+               world->map->height,
+               count,
+               diagonal ? "8-way" : "4-way");
+
+        PathResults heap = RunPaths(world, pairs, count, diagonal, FindPath);
+        PathResults ref = RunPaths(world, pairs, count, diagonal, RefFindPath);
+
+        PrintPathResults("heap", heap, count);
+        PrintPathResults("linear", ref, count);
+        printf("  speedup: %.1fx\n", ref.msec / heap.msec);
+    }
+}
+
+void BenchmarkFindPath(Game * game)
+{
+    printf("\n- Benchmark FindPath -\n");
+
+    Rng rng = SeedRng(BENCH_SEED, BENCH_RNG_PATHS);
+
+    GenerateWorld(game, AREA_FOREST, BENCH_SEED, FOREST_SIZE, FOREST_SIZE);
+    BenchmarkCurrentMap(&game->world, "forest", &rng);
+
+    GenerateWorld(game, AREA_DUNGEON, BENCH_SEED, 31, 31);
+    BenchmarkCurrentMap(&game->world, "dungeon", &rng);
+
+    free(ref_grid);
+    free(ref_open_list);
+    ref_grid = NULL;
+    ref_open_list = NULL;
+    ref_grid_size = 0;
+}
+
+#pragma mark - Actor Grid
+
+/// Check that every active actor is in its tile's chain exactly once and that
+/// the grid holds no other actors.
+static bool ActorGridIsConsistent(const ActorList * list)
+{
+    int num_linked = 0;
+
+    for ( int i = 0; i < list->width * list->height; i++ ) {
+        const Actor * prev = NULL;
+        TileCoord coord = { i % list->width, i / list->width };
+        for ( const Actor * a = GetActorAtTile(list, coord); a; a = a->tile_next ) {
+            if ( !TileCoordsEqual(a->tile, coord) || a->tile_prev != prev ) {
+                return false;
+            }
+            prev = a;
+            num_linked++;
+        }
+    }
+
+    int num_active = 0;
+    FOR_EACH_ACTOR_CONST(actor, (*list)) {
+        num_active++;
+    }
+
+    return num_linked == num_active && num_active == list->count;
+}
+
+/// Check that every active actor is in its type's list exactly once and that
+/// the lists hold no other actors.
+static bool TypeListsAreConsistent(const ActorList * list)
+{
+    int num_linked = 0;
+
+    for ( ActorType type = 0; type < NUM_ACTOR_TYPES; type++ ) {
+        const Actor * prev = NULL;
+        for ( const Actor * a = FindActorConst(list, type); a; a = a->type_next ) {
+            if ( a->type != type || a->type_prev != prev || !a->flags.in_use ) {
+                return false;
+            }
+            prev = a;
+            num_linked++;
+        }
+    }
+
+    return num_linked == list->count;
+}
+
+static Actor * LinearGetActorAtTile(const ActorList * list, TileCoord coord)
+{
+    FOR_EACH_ACTOR(actor, *list) {
+        if ( TileCoordsEqual(actor->tile, coord) ) {
+            return actor;
+        }
+    }
+
+    return NULL;
+}
+
+void StressTestActors(Game * game)
+{
+    printf("\n- Actor Stress Test -\n");
+
+    Rng rng = SeedRng(BENCH_SEED, BENCH_RNG_ACTORS);
+
+    GenerateWorld(game, AREA_FOREST, BENCH_SEED, FOREST_SIZE, FOREST_SIZE);
+    Map * map = game->world.map;
+    ActorList * list = &map->actor_list;
+
+    // Fill the map up to MAX_ACTORS with a mix of monsters and items, which
+    // don't block and so end up stacked.
+    float start = ProgramTime();
+    while ( list->count < MAX_ACTORS ) {
+        TileCoord coord = {
+            RngInt(&rng, 1, map->width - 2),
+            RngInt(&rng, 1, map->height - 2)
+        };
+
+        if ( !GetTileFlags(map, coord)->blocks_movement ) {
+            ActorType type = list->count % 2 ? ACTOR_BLOB : ACTOR_ITEM_HEALTH;
+            SpawnActor(game, type, coord);
+        }
+    }
+    printf("spawned %d actors on %dx%d: %.2f ms\n",
+           list->count,
+           map->width,
+           map->height,
+           (ProgramTime() - start) * 1000.0f);
+
+    // Move everything around. (Blobs don't hurt each other.)
+    int num_moves = 0;
+    start = ProgramTime();
+    for ( int round = 0; round < STRESS_ROUNDS; round++ ) {
+        FOR_EACH_ACTOR(actor, (*list)) {
+            if ( actor->type == ACTOR_PLAYER ) {
+                continue;
+            }
+
+            Direction d = RngInt(&rng, 0, NUM_DIRECTIONS - 1);
+            if ( TryMoveActor(actor, AdjacentTileCoord(actor->tile, d)) ) {
+                num_moves++;
+            }
+        }
+    }
+    printf("%d rounds, %d successful moves: %.2f ms\n",
+           STRESS_ROUNDS,
+           num_moves,
+           (ProgramTime() - start) * 1000.0f);
+
+    static ActorHandle handles[MAX_ACTORS];
+    int num_handles = 0;
+    FOR_EACH_ACTOR_CONST(actor, (*list)) {
+        handles[num_handles++] = GetActorHandle(actor);
+    }
+
+    // Remove every other actor.
+    bool remove = false;
+    FOR_EACH_ACTOR(actor, (*list)) {
+        if ( remove && actor->type != ACTOR_PLAYER ) {
+            RemoveActor(actor);
+        }
+        remove = !remove;
+    }
+    printf("removed down to %d actors\n", list->count);
+
+    // Iterate with every other slot now empty.
+    int num_visited = 0;
+    start = ProgramTime();
+    for ( int round = 0; round < STRESS_ROUNDS; round++ ) {
+        FOR_EACH_ACTOR_CONST(actor, (*list)) {
+            num_visited += actor->stats.health > 0;
+        }
+    }
+    printf("iteration: %.2f ns/actor\n",
+           (ProgramTime() - start) * 1e9f / (STRESS_ROUNDS * list->count));
+
+    // Lookups over every tile, grid vs. linear scan.
+    int grid_found = 0;
+    start = ProgramTime();
+    for ( int i = 0; i < map->width * map->height; i++ ) {
+        grid_found += GetActorAtTile(list, GetCoordinate(map, i)) != NULL;
+    }
+    float grid_msec = (ProgramTime() - start) * 1000.0f;
+
+    // The linear scan is far slower, so only do one row of tiles.
+    int linear_found = 0;
+    start = ProgramTime();
+    for ( int i = 0; i < map->width; i++ ) {
+        TileCoord coord = { i, map->height / 2 };
+        linear_found += LinearGetActorAtTile(list, coord) != NULL;
+
+        if ( (GetActorAtTile(list, coord) != NULL) != (LinearGetActorAtTile(list, coord) != NULL) ) {
+            printf("error: grid and linear lookup disagree at %d, %d!\n", coord.x, coord.y);
+        }
+    }
+    float linear_msec = (ProgramTime() - start) * 1000.0f / 2.0f;
+
+    printf("lookup: grid %.1f ns/tile (%d occupied), linear %.1f ns/tile\n",
+           grid_msec * 1e6f / (map->width * map->height),
+           grid_found,
+           linear_msec * 1e6f / map->width);
+
+    // Refill the removed actors' slots: their handles should stay stale.
+    int num_live = list->count;
+    while ( list->count < MAX_ACTORS ) {
+        TileCoord coord = {
+            RngInt(&rng, 1, map->width - 2),
+            RngInt(&rng, 1, map->height - 2)
+        };
+
+        if ( !GetTileFlags(map, coord)->blocks_movement ) {
+            SpawnActor(game, ACTOR_ITEM_HEALTH, coord);
+        }
+    }
+
+    int num_valid = 0;
+    for ( int i = 0; i < num_handles; i++ ) {
+        num_valid += GetActor(list, handles[i]) != NULL;
+    }
+
+    printf("handles consistent: %s\n", num_valid == num_live ? "yes" : "NO");
+    printf("grid consistent: %s\n", ActorGridIsConsistent(list) ? "yes" : "NO");
+    printf("type lists consistent: %s\n", TypeListsAreConsistent(list) ? "yes" : "NO");
+}
+
+#pragma mark - Field of View
+
+static u8 * fov_marks; // One per tile, set by MarkVisible().
+static int fov_marks_size;
+
+/// Same as RevealTile(), but marks `fov_marks` instead of the tile flags.
+static void MarkVisible(Map * map, TileCoord coord)
+{
+    fov_marks[coord.y * map->width + coord.x] = 1;
+
+    if ( !GetTileFlags(map, coord)->blocks_movement ) {
+        for ( Direction d = 0; d < NUM_DIRECTIONS; d++ ) {
+            TileCoord adj = AdjacentTileCoord(coord, d);
+            if ( IsInBounds(map, adj.x, adj.y) ) {
+                fov_marks[adj.y * map->width + adj.x] = 1;
+            }
+        }
+    }
+}
+
+/// The previous PlayerCastSight(): a line of sight check to every tile.
+static void LOSFieldOfView(Map * map, TileCoord origin, Box region, FOVCallback visit)
+{
+    TileCoord coord;
+    for ( coord.y = region.top; coord.y <= region.bottom; coord.y++ ) {
+        for ( coord.x = region.left; coord.x <= region.right; coord.x++ ) {
+            if ( LineOfSight(map, origin, coord) ) {
+                visit(map, coord);
+            }
+        }
+    }
+}
+
+static void ClearMarks(const Map * map, Box region)
+{
+    // Include the border, since floors on the edge reveal their neighbors.
+    for ( int y = region.top - 1; y <= region.bottom + 1; y++ ) {
+        for ( int x = region.left - 1; x <= region.right + 1; x++ ) {
+            if ( IsInBounds(map, x, y) ) {
+                fov_marks[y * map->width + x] = 0;
+            }
+        }
+    }
+}
+
+typedef struct {
+    int num_origins;
+    long both;
+    long los_only;
+    long fov_only;
+    float los_msec;
+    float fov_msec;
+} FOVResults;
+
+static void CompareFieldOfViewOnMap(Map * map, FOVResults * results, Rng * rng)
+{
+    int size = map->width * map->height;
+    if ( fov_marks_size < size ) {
+        fov_marks = realloc(fov_marks, size);
+        if ( fov_marks == NULL ) {
+            Error("could not allocate field of view marks");
+        }
+        fov_marks_size = size;
+    }
+
+    u8 * los = malloc(size);
+    TileCoord * origins = malloc(FOV_ORIGINS * sizeof(*origins));
+    int num_origins = 0;
+
+    // Use random walkable tiles as the viewer's position.
+    for ( int tries = 0; tries < FOV_ORIGINS * 10 && num_origins < FOV_ORIGINS; tries++ ) {
+        TileCoord coord = GetCoordinate(map, RngInt(rng, 0, size - 1));
+        if ( !GetTileFlags(map, coord)->blocks_movement ) {
+            origins[num_origins++] = coord;
+        }
+    }
+
+    // Diff.
+    for ( int i = 0; i < num_origins; i++ ) {
+        Box region = GetPlayerVisibleRegion(map, origins[i]);
+
+        ClearMarks(map, region);
+        LOSFieldOfView(map, origins[i], region, MarkVisible);
+        memcpy(los, fov_marks, size);
+
+        ClearMarks(map, region);
+        CastFieldOfView(map, origins[i], region, MarkVisible);
+
+        for ( int y = region.top - 1; y <= region.bottom + 1; y++ ) {
+            for ( int x = region.left - 1; x <= region.right + 1; x++ ) {
+                if ( !IsInBounds(map, x, y) ) {
+                    continue;
+                }
+
+                int index = y * map->width + x;
+                if ( los[index] && fov_marks[index] ) {
+                    results->both++;
+                } else if ( los[index] ) {
+                    results->los_only++;
+                } else if ( fov_marks[index] ) {
+                    results->fov_only++;
+                }
+            }
+        }
+    }
+
+    // Timing.
+    float start = ProgramTime();
+    for ( int i = 0; i < num_origins; i++ ) {
+        Box region = GetPlayerVisibleRegion(map, origins[i]);
+        LOSFieldOfView(map, origins[i], region, MarkVisible);
+    }
+    results->los_msec += (ProgramTime() - start) * 1000.0f;
+
+    start = ProgramTime();
+    for ( int i = 0; i < num_origins; i++ ) {
+        Box region = GetPlayerVisibleRegion(map, origins[i]);
+        CastFieldOfView(map, origins[i], region, MarkVisible);
+    }
+    results->fov_msec += (ProgramTime() - start) * 1000.0f;
+
+    results->num_origins += num_origins;
+
+    free(los);
+    free(origins);
+}
+
+static void PrintFOVResults(const char * name, const FOVResults * r)
+{
+    long total = r->both + r->los_only + r->fov_only;
+
+    printf("%s: %d viewpoints\n", name, r->num_origins);
+    printf("  visible to both: %ld\n", r->both);
+    printf("  LOS only: %ld (%.2f%%)\n", r->los_only, 100.0f * r->los_only / total);
+    printf("  shadowcast only: %ld (%.2f%%)\n", r->fov_only, 100.0f * r->fov_only / total);
+    printf("  LOS: %.4f ms/view, shadowcast: %.4f ms/view (%.1fx)\n",
+           r->los_msec / r->num_origins,
+           r->fov_msec / r->num_origins,
+           r->los_msec / r->fov_msec);
+}
+
+void CompareFieldOfView(Game * game)
+{
+    printf("\n- Compare Field of View -\n");
+
+    FOVResults forest = { 0 };
+    FOVResults dungeon = { 0 };
+    Rng rng = SeedRng(BENCH_SEED, BENCH_RNG_FOV);
+
+    for ( int seed = 0; seed < 3; seed++ ) {
+        GenerateWorld(game, AREA_FOREST, seed, FOREST_SIZE, FOREST_SIZE);
+        CompareFieldOfViewOnMap(game->world.map, &forest, &rng);
+
+        GenerateWorld(game, AREA_DUNGEON, seed, 31, 31);
+        CompareFieldOfViewOnMap(game->world.map, &dungeon, &rng);
+    }
+
+    PrintFOVResults("forest", &forest);
+    PrintFOVResults("dungeon", &dungeon);
+
+    free(fov_marks);
+    fov_marks = NULL;
+    fov_marks_size = 0;
+}
+
+#pragma mark - Tile Passes
+
+// The tile record and distances pass from before the map was split into
+// planes, to measure the planar pass against.
+
+typedef struct {
+    u8 type;
+    u8 variety;
+    s16 id;
+    TileFlags flags;
+    s16 distance;
+    u8 tag;
+} RefTile;
+
+static RefTile * ref_tiles;
+static int * ref_queue;
+
+/// Copy the map's tiles into the old array of tile records.
+static void MakeRefTiles(const Map * map)
+{
+    int size = map->width * map->height;
+    ref_tiles = realloc(ref_tiles, size * sizeof(*ref_tiles));
+    ref_queue = realloc(ref_queue, size * sizeof(*ref_queue));
+    ASSERT(ref_tiles != NULL);
+    ASSERT(ref_queue != NULL);
+
+    for ( int i = 0; i < size; i++ ) {
+        TileCoord coord = GetCoordinate(map, i);
+        const Tile * tile = GetTile(map, coord);
+
+        ref_tiles[i].type = tile->type;
+        ref_tiles[i].variety = TileVariety(map, coord);
+        ref_tiles[i].id = GetRegionID(map, coord);
+        ref_tiles[i].flags = *GetTileFlags(map, coord);
+        ref_tiles[i].distance = 0;
+        ref_tiles[i].tag = tile->tag;
+    }
+}
+
+static void RefCalculateDistances(const Map * map,
+                                  TileCoord coord,
+                                  int ignore_flags,
+                                  s16 * distances)
+{
+    int size_needed = map->width * map->height;
+
+    for ( int i = 0; i < size_needed; i++ ) {
+        distances[i] = -1;
+    }
+
+    // Each tile is queued at most once, so the queue never wraps.
+    int head = 0;
+    int tail = 0;
+
+    int start = coord.y * map->width + coord.x;
+    distances[start] = 0;
+    ref_queue[tail++] = start;
+
+    while ( head != tail ) {
+        int index = ref_queue[head++];
+        TileCoord current = GetCoordinate(map, index);
+        s16 distance = distances[index] + 1;
+
+        for ( int d = 0; d < NUM_DIRECTIONS; d++ ) {
+            TileCoord edge_coord = AdjacentTileCoord(current, d);
+            if ( !IsInBounds(map, edge_coord.x, edge_coord.y) ) continue;
+
+            int edge_index = edge_coord.y * map->width + edge_coord.x;
+            if ( distances[edge_index] != -1 ) continue; // already visited
+
+            // This tile blocks movement and is not of a type to be ignored.
+            const RefTile * edge = &ref_tiles[edge_index];
+            bool ignore = ignore_flags & FLAG(edge->type);
+            if ( edge->flags.blocks_movement && !ignore ) continue;
+
+            // Nothing blocking this tile and not yet visited:
+            distances[edge_index] = distance;
+            ref_queue[tail++] = edge_index;
+        }
+    }
+}
+
+typedef struct {
+    float ref_bfs_msec;
+    float bfs_msec;
+    float fov_msec;
+    float signature_msec;
+    float lighting_msec;
+    bool distances_differ;
+} TilePassResults;
+
+static void NoVisit(Map * map, TileCoord coord) { }
+
+static void BenchmarkTilePassesOnMap(Map * map, TilePassResults * results, Rng * rng)
+{
+    int size = map->width * map->height;
+    DistancePlane distances = { 0 };
+    s16 * ref_distances = malloc(size * sizeof(*ref_distances));
+
+    TileCoord origins[TILE_PASS_REPEATS];
+    for ( int i = 0; i < TILE_PASS_REPEATS; i++ ) {
+        do {
+            origins[i] = GetCoordinate(map, RngInt(rng, 0, size - 1));
+        } while ( GetTileFlags(map, origins[i])->blocks_movement );
+    }
+
+    // Full-map BFS over whole tile records, as before the split.
+    MakeRefTiles(map);
+    float start = ProgramTime();
+    for ( int i = 0; i < TILE_PASS_REPEATS; i++ ) {
+        RefCalculateDistances(map, origins[i], 0, ref_distances);
+    }
+    results->ref_bfs_msec += (ProgramTime() - start) * 1000.0f;
+
+    // Full-map BFS, which reads the movement flags only.
+    start = ProgramTime();
+    for ( int i = 0; i < TILE_PASS_REPEATS; i++ ) {
+        CalculateDistances(map, origins[i], 0, &distances);
+    }
+    results->bfs_msec += (ProgramTime() - start) * 1000.0f;
+
+    // Both passes end on the last origin.
+    for ( int i = 0; i < size; i++ ) {
+        if ( GetDistance(&distances, GetCoordinate(map, i)) != ref_distances[i] ) {
+            results->distances_differ = true;
+            break;
+        }
+    }
+
+    // Field of view, which reads the sight flags only.
+    start = ProgramTime();
+    for ( int i = 0; i < TILE_PASS_REPEATS; i++ ) {
+        Box region = GetPlayerVisibleRegion(map, origins[i]);
+        CastFieldOfView(map, origins[i], region, NoVisit);
+    }
+    results->fov_msec += (ProgramTime() - start) * 1000.0f;
+
+    // Wall signatures for the whole map.
+    start = ProgramTime();
+    for ( int i = 0; i < TILE_PASS_REPEATS; i++ ) {
+        for ( int j = 0; j < size; j++ ) {
+            CalculateWallSignature(map, GetCoordinate(map, j), true);
+        }
+    }
+    results->signature_msec += (ProgramTime() - start) * 1000.0f;
+
+    // Full-map light composites, with a light at each origin.
+    LightMap * light_map = &map->light_map;
+    Box whole_map = { 0, 0, map->width - 1, map->height - 1 };
+    start = ProgramTime();
+    for ( int i = 0; i < TILE_PASS_REPEATS; i++ ) {
+        BeginLights(light_map);
+        for ( int j = 0; j < TILE_PASS_REPEATS; j++ ) {
+            AddLight(light_map, origins[j], 3, 255);
+        }
+
+        InvalidateLightMap(light_map);
+        UpdateLightMap(light_map, map, &area_info[AREA_FOREST], whole_map);
+    }
+    results->lighting_msec += (ProgramTime() - start) * 1000.0f;
+
+    FreeDistancePlane(&distances);
+    free(ref_distances);
+}
+
+void BenchmarkTilePasses(Game * game)
+{
+    printf("\n- Benchmark Tile Passes -\n");
+
+    TilePassResults results = { 0 };
+    Rng rng = SeedRng(BENCH_SEED, BENCH_RNG_TILE_PASSES);
+
+    for ( int seed = 0; seed < TILE_PASS_SEEDS; seed++ ) {
+        GenerateWorld(game, AREA_FOREST, seed, FOREST_SIZE, FOREST_SIZE);
+        BenchmarkTilePassesOnMap(game->world.map, &results, &rng);
+    }
+
+    float count = TILE_PASS_SEEDS * TILE_PASS_REPEATS;
+    printf("%d x %d forests, per pass:\n", FOREST_SIZE, FOREST_SIZE);
+    printf("  distances: %.3f ms (tile records: %.3f ms)%s\n",
+           results.bfs_msec / count,
+           results.ref_bfs_msec / count,
+           results.distances_differ ? " - results differ!" : "");
+    printf("  field of view: %.4f ms\n", results.fov_msec / count);
+    printf("  wall signatures: %.3f ms\n", results.signature_msec / count);
+    printf("  lighting: %.3f ms\n", results.lighting_msec / count);
+
+    free(ref_tiles);
+    free(ref_queue);
+    ref_tiles = NULL;
+    ref_queue = NULL;
+}
@@ -0,0 +1,33 @@
+//
+//  bench.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/2/23.
+//
+//  Debug benchmarks. These generate their own levels and draw random numbers
+//  from fixed seeds, so runs can be compared. The current level should be
+//  reloaded afterwards.
+//
+
+#ifndef bench_h
+#define bench_h
+
+#include "game.h"
+
+/// Run random start/end pairs through `FindPath` and the previous linear-scan
+/// implementation on generated forest and dungeon maps and print the results.
+void BenchmarkFindPath(Game * game);
+
+/// Spawn `MAX_ACTORS` actors on the largest forest, move them all around, and
+/// check the actor occupancy grid along the way.
+void StressTestActors(Game * game);
+
+/// Compare the shadowcast field of view with line of sight checks from random
+/// viewpoints on generated maps: which tiles differ and how long each takes.
+void CompareFieldOfView(Game * game);
+
+/// Time the whole-map tile passes (distances, field of view, wall signatures,
+/// and lighting) on the largest forests.
+void BenchmarkTilePasses(Game * game);
+
+#endif /* bench_h */
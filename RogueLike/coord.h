@@ -18,6 +18,24 @@
 
 typedef struct { s16 x, y; } TileCoord;
 
+// Per-tile data for a map is stored in square chunks of tiles, which are only
+// allocated once needed. See Map and DistancePlane.
+#define MAP_CHUNK_SHIFT 4
+#define MAP_CHUNK_SIZE (1 << MAP_CHUNK_SHIFT) // Chunk width and height, in tiles.
+#define MAP_CHUNK_AREA (MAP_CHUNK_SIZE * MAP_CHUNK_SIZE)
+
+/// The index of tile (`x`, `y`) within its chunk.
+static inline int TileChunkIndex(int x, int y)
+{
+    return (y & (MAP_CHUNK_SIZE - 1)) << MAP_CHUNK_SHIFT | (x & (MAP_CHUNK_SIZE - 1));
+}
+
+/// The number of chunks needed to cover `tiles` tiles in a row or column.
+static inline int ChunksToCover(int tiles)
+{
+    return (tiles + MAP_CHUNK_SIZE - 1) >> MAP_CHUNK_SHIFT;
+}
+
 bool TileInBox(TileCoord coord, Box box);
 TileCoord AddTileCoords(TileCoord a, TileCoord b);
 bool TileCoordsEqual(TileCoord a, TileCoord b);
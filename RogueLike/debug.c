@@ -13,13 +13,16 @@ bool show_debug_info;
 bool show_map_gen = false;
 bool show_debug_map;
 bool show_distances;
+bool use_tile_cache = true;
+bool skip_render; // Run frames without drawing, for replays.
 
 float frame_msec;
 float update_msec;
 float render_msec;
 float tiles_msec;
 float actors_msec;
-float max_frame_msec;
+float lighting_msec;
+float particles_msec;
 
 
 void DebugWaitForKeyPress(void)
@@ -45,9 +48,8 @@ void CheckForShowMapGenCancel(void)
 bool TilesAreLitThatShouldntBe(Map * map)
 {
     for ( int i = 0; i < map->width * map->height; i++ ) {
-        Tile * tile = &map->tiles[i];
-
-        if ( !tile->flags.revealed && tile->light > 0 ) {
+        const TileFlags * flags = GetTileFlags((const Map *)map, GetCoordinate(map, i));
+        if ( !flags->revealed && GetTileLight(map, GetCoordinate(map, i)) > 0 ) {
             return true;
         }
     }
@@ -67,8 +69,8 @@ void PrintTilesAreDarkThatShouldntBe(Map * map, const char * string)
 {
     for ( int y = 0; y < map->height; y++ ) {
         for (int x = 0; x < map->width; x++ ) {
-            Tile * tile = GetTile(map, ((TileCoord){ x, y }));
-            if ( tile->flags.revealed && tile->light == 0 ) {
+            TileCoord coord = { x, y };
+            if ( GetTileFlags((const Map *)map, coord)->revealed && GetTileLight(map, coord) == 0 ) {
                 printf("%s: fucked\n", string);
                 return;
             }
@@ -25,9 +25,12 @@ extern float update_msec;
 extern float render_msec;
 extern float tiles_msec;
 extern float actors_msec;
-extern float max_frame_msec;
+extern float lighting_msec;
+extern float particles_msec;
 extern bool show_debug_map;
 extern bool show_distances;
+extern bool use_tile_cache;
+extern bool skip_render;
 
 bool TilesAreLitThatShouldntBe(Map * map);
 void PrintTilesAreFucked(Map * map, const char * string);
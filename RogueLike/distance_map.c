@@ -0,0 +1,575 @@
+//
+//  distance_map.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/4/23.
+//
+
+#include "distance_map.h"
+#include "map.h"
+#include "genlib.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// If a repair would invalidate more than 1/n of the map, just rebuild it.
+#define MAX_INVALID_FRACTION 4
+
+#define UNREACHABLE INT_MAX
+
+typedef struct {
+    TileCoord coord;
+    int distance;
+} Seed;
+
+typedef struct {
+    u32 marks[MAP_CHUNK_AREA];
+} MarkChunk;
+
+// Work buffers shared by all distance maps. The lists grow to hold the most
+// tiles an update has touched, rather than one entry per map tile.
+static TileCoord * queue;
+static int queue_capacity;
+static Seed * seeds;
+static int seeds_capacity;
+static TileCoord * invalid;
+static int invalid_capacity;
+
+// Marks, see NextMark(). Chunked like a DistancePlane, allocated zeroed when a
+// tile in them is first marked. Zero is never a current mark.
+static MarkChunk ** mark_chunks;
+static int mark_chunks_wide;
+static int mark_chunks_high;
+static int num_mark_chunks;
+static u32 mark;
+
+#pragma mark - PLANE
+
+DistanceChunk * GetWritableDistanceChunk(DistancePlane * plane, int x, int y)
+{
+    DistanceChunk ** chunk = &plane->chunks[(y >> MAP_CHUNK_SHIFT) * plane->chunks_wide
+                                            + (x >> MAP_CHUNK_SHIFT)];
+
+    if ( *chunk == NULL ) {
+        *chunk = malloc(sizeof(**chunk));
+        if ( *chunk == NULL ) {
+            Error("could not allocate distance chunk");
+        }
+
+        (*chunk)->stamp = plane->stamp - 1; // Cleared below.
+        plane->num_chunks_allocated++;
+    }
+
+    if ( (*chunk)->stamp != plane->stamp ) {
+        // -1 is all bits set.
+        memset((*chunk)->distances, 0xFF, sizeof((*chunk)->distances));
+        (*chunk)->stamp = plane->stamp;
+    }
+
+    return *chunk;
+}
+
+bool DistancePlaneFits(const DistancePlane * plane, int width, int height)
+{
+    return plane->chunks != NULL
+        && plane->chunks_wide == ChunksToCover(width)
+        && plane->chunks_high == ChunksToCover(height);
+}
+
+void ClearDistancePlane(DistancePlane * plane, int width, int height)
+{
+    if ( !DistancePlaneFits(plane, width, height) ) {
+        FreeDistancePlane(plane);
+
+        plane->chunks_wide = ChunksToCover(width);
+        plane->chunks_high = ChunksToCover(height);
+        plane->chunks = calloc(plane->chunks_wide * plane->chunks_high,
+                               sizeof(*plane->chunks));
+        if ( plane->chunks == NULL ) {
+            Error("could not allocate distance plane");
+        }
+    }
+
+    if ( ++plane->stamp == 0 ) {
+        // Wrapped: a chunk's old stamp could now look current.
+        for ( int i = 0; i < plane->chunks_wide * plane->chunks_high; i++ ) {
+            if ( plane->chunks[i] ) {
+                plane->chunks[i]->stamp = 0;
+            }
+        }
+        plane->stamp = 1;
+    }
+}
+
+size_t DistancePlaneMemoryUsage(const DistancePlane * plane)
+{
+    if ( plane->chunks == NULL ) {
+        return 0;
+    }
+
+    return plane->chunks_wide * plane->chunks_high * sizeof(*plane->chunks)
+        + plane->num_chunks_allocated * sizeof(DistanceChunk);
+}
+
+void FreeDistancePlane(DistancePlane * plane)
+{
+    if ( plane->chunks ) {
+        for ( int i = 0; i < plane->chunks_wide * plane->chunks_high; i++ ) {
+            free(plane->chunks[i]);
+        }
+        free(plane->chunks);
+    }
+
+    *plane = (DistancePlane){ 0 };
+}
+
+#pragma mark -
+
+/// Make sure `*buffer` can hold `count` elements of `size` bytes.
+static void * Reserve(void * buffer, int * capacity, int count, size_t size)
+{
+    if ( count <= *capacity ) {
+        return buffer;
+    }
+
+    int new_capacity = *capacity ? *capacity : 1024;
+    while ( new_capacity < count ) {
+        new_capacity *= 2;
+    }
+
+    buffer = realloc(buffer, new_capacity * size);
+    if ( buffer == NULL ) {
+        Error("could not allocate distance map buffers");
+    }
+
+    *capacity = new_capacity;
+    return buffer;
+}
+
+static void Enqueue(int * tail, TileCoord coord)
+{
+    queue = Reserve(queue, &queue_capacity, *tail + 1, sizeof(*queue));
+    queue[(*tail)++] = coord;
+}
+
+/// Make sure the marks cover a map the size of `map`.
+static void ReserveMarks(const Map * map)
+{
+    int chunks_wide = ChunksToCover(map->width);
+    int chunks_high = ChunksToCover(map->height);
+
+    if (   mark_chunks
+        && mark_chunks_wide == chunks_wide
+        && mark_chunks_high == chunks_high )
+    {
+        return;
+    }
+
+    FreeDistanceMapBuffers();
+
+    mark_chunks = calloc(chunks_wide * chunks_high, sizeof(*mark_chunks));
+    if ( mark_chunks == NULL ) {
+        Error("could not allocate distance map buffers");
+    }
+
+    mark_chunks_wide = chunks_wide;
+    mark_chunks_high = chunks_high;
+    mark = 0;
+}
+
+static u32 GetMark(TileCoord coord)
+{
+    const MarkChunk * chunk = mark_chunks[(coord.y >> MAP_CHUNK_SHIFT) * mark_chunks_wide
+                                          + (coord.x >> MAP_CHUNK_SHIFT)];
+    return chunk ? chunk->marks[TileChunkIndex(coord.x, coord.y)] : 0;
+}
+
+static void SetMark(TileCoord coord, u32 value)
+{
+    MarkChunk ** chunk = &mark_chunks[(coord.y >> MAP_CHUNK_SHIFT) * mark_chunks_wide
+                                      + (coord.x >> MAP_CHUNK_SHIFT)];
+
+    if ( *chunk == NULL ) {
+        *chunk = calloc(1, sizeof(**chunk));
+        if ( *chunk == NULL ) {
+            Error("could not allocate distance map buffers");
+        }
+        num_mark_chunks++;
+    }
+
+    (*chunk)->marks[TileChunkIndex(coord.x, coord.y)] = value;
+}
+
+/// Start a new raise pass. A tile is queued in the pass if its mark is `mark`,
+/// and invalid if its mark is `mark + 1`.
+static void NextMark(void)
+{
+    mark += 2;
+
+    if ( mark < 2 ) { // Wrapped.
+        for ( int i = 0; i < mark_chunks_wide * mark_chunks_high; i++ ) {
+            if ( mark_chunks[i] ) {
+                memset(mark_chunks[i], 0, sizeof(*mark_chunks[i]));
+            }
+        }
+        mark = 2;
+    }
+}
+
+static int Distance(const DistanceMap * dm, TileCoord coord)
+{
+    s16 distance = GetDistance(&dm->distances, coord);
+    return distance == -1 ? UNREACHABLE : distance;
+}
+
+static bool IsWalkable(const Map * map, TileCoord coord)
+{
+    const TileChunk * chunk = GetTileChunk(map, coord.x, coord.y);
+    return !chunk->flags[TileChunkIndex(coord.x, coord.y)].blocks_movement;
+}
+
+/// Get the (up to 8) in-bounds tiles adjacent to `coord`.
+static int GetNeighbors(const Map * map, TileCoord coord, TileCoord out[NUM_DIRECTIONS])
+{
+    int count = 0;
+
+    for ( int d = 0; d < NUM_DIRECTIONS; d++ ) {
+        TileCoord adjacent = AdjacentTileCoord(coord, d);
+        if ( IsInBounds(map, adjacent.x, adjacent.y) ) {
+            out[count++] = adjacent;
+        }
+    }
+
+    return count;
+}
+
+static void Rebuild(DistanceMap * dm, const Map * map, TileCoord source)
+{
+    dm->tiles_touched = CalculateDistances(map, source, 0, &dm->distances);
+    dm->source = source;
+    dm->generation = map->generation;
+    dm->num_rebuilds++;
+}
+
+/// Propagate decreased distances outward from the tiles in the queue. Every
+/// queued tile must have been given its new (lower) distance.
+static void Lower(DistanceMap * dm, const Map * map, int head, int tail)
+{
+    while ( head != tail ) {
+        TileCoord coord = queue[head++];
+        int distance = Distance(dm, coord) + 1;
+        dm->tiles_touched++;
+
+        TileCoord neighbors[NUM_DIRECTIONS];
+        int num_neighbors = GetNeighbors(map, coord, neighbors);
+
+        for ( int i = 0; i < num_neighbors; i++ ) {
+            TileCoord n = neighbors[i];
+            if ( IsWalkable(map, n) && Distance(dm, n) > distance ) {
+                SetDistance(&dm->distances, n, distance);
+                Enqueue(&tail, n);
+            }
+        }
+    }
+}
+
+/// Whether the tile at `coord` still has a neighbor one step closer to the
+/// source that hasn't been invalidated.
+static bool HasSupport(const DistanceMap * dm, const Map * map, TileCoord coord)
+{
+    int distance = Distance(dm, coord);
+
+    TileCoord neighbors[NUM_DIRECTIONS];
+    int num_neighbors = GetNeighbors(map, coord, neighbors);
+
+    for ( int i = 0; i < num_neighbors; i++ ) {
+        TileCoord n = neighbors[i];
+        if ( GetMark(n) != mark + 1 && Distance(dm, n) == distance - 1 ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Find the tiles whose distance was derived from tile `start` and can no
+/// longer be supported, starting with `start` itself.
+/// - returns: The number of tiles in `invalid`, or -1 if over `limit`.
+static int Raise(DistanceMap * dm, const Map * map, TileCoord start, int limit)
+{
+    NextMark();
+
+    int num_invalid = 0;
+    int head = 0;
+    int tail = 0;
+
+    Enqueue(&tail, start);
+    SetMark(start, mark);
+
+    // The queue is in order of increasing distance, so by the time a tile is
+    // checked, all tiles that could support it have already been checked.
+    while ( head != tail ) {
+        TileCoord coord = queue[head++];
+        dm->tiles_touched++;
+
+        if ( !TileCoordsEqual(coord, start) && HasSupport(dm, map, coord) ) {
+            continue;
+        }
+
+        if ( num_invalid == limit ) {
+            return -1;
+        }
+
+        SetMark(coord, mark + 1);
+        invalid = Reserve(invalid, &invalid_capacity, num_invalid + 1, sizeof(*invalid));
+        invalid[num_invalid++] = coord;
+
+        int distance = Distance(dm, coord) + 1;
+        TileCoord neighbors[NUM_DIRECTIONS];
+        int num_neighbors = GetNeighbors(map, coord, neighbors);
+
+        for ( int i = 0; i < num_neighbors; i++ ) {
+            TileCoord n = neighbors[i];
+            u32 n_mark = GetMark(n);
+            if ( n_mark != mark
+                && n_mark != mark + 1
+                && IsWalkable(map, n)
+                && Distance(dm, n) == distance )
+            {
+                SetMark(n, mark);
+                Enqueue(&tail, n);
+            }
+        }
+    }
+
+    return num_invalid;
+}
+
+static int CompareSeeds(const void * a, const void * b)
+{
+    return ((const Seed *)a)->distance - ((const Seed *)b)->distance;
+}
+
+/// Give the invalidated tiles new distances from their valid neighbors.
+static void Reseed(DistanceMap * dm, const Map * map, int num_invalid)
+{
+    for ( int i = 0; i < num_invalid; i++ ) {
+        SetDistance(&dm->distances, invalid[i], -1);
+    }
+
+    // For each invalid tile, the best distance via a valid neighbor.
+    seeds = Reserve(seeds, &seeds_capacity, num_invalid, sizeof(*seeds));
+    int num_seeds = 0;
+    for ( int i = 0; i < num_invalid; i++ ) {
+        TileCoord coord = invalid[i];
+        if ( !IsWalkable(map, coord) ) {
+            continue;
+        }
+
+        int best = UNREACHABLE;
+        TileCoord neighbors[NUM_DIRECTIONS];
+        int num_neighbors = GetNeighbors(map, coord, neighbors);
+
+        for ( int j = 0; j < num_neighbors; j++ ) {
+            int distance = Distance(dm, neighbors[j]);
+            if ( distance != UNREACHABLE && distance + 1 < best ) {
+                best = distance + 1;
+            }
+        }
+
+        if ( best != UNREACHABLE ) {
+            seeds[num_seeds++] = (Seed){ coord, best };
+        }
+    }
+
+    for ( int i = 0; i < num_seeds; i++ ) {
+        SetDistance(&dm->distances, seeds[i].coord, seeds[i].distance);
+    }
+
+    qsort(seeds, num_seeds, sizeof(*seeds), CompareSeeds);
+
+    // Dijkstra with unit weights: merge the sorted seeds with a FIFO of
+    // propagated tiles, always taking the closer of the two.
+    int seed = 0;
+    int head = 0;
+    int tail = 0;
+
+    while ( seed < num_seeds || head != tail ) {
+        TileCoord coord;
+
+        if ( head == tail
+            || (seed < num_seeds
+                && seeds[seed].distance <= Distance(dm, queue[head])) )
+        {
+            coord = seeds[seed].coord;
+            if ( Distance(dm, coord) != seeds[seed++].distance ) {
+                continue; // Already reached with a lower distance.
+            }
+        } else {
+            coord = queue[head++];
+        }
+
+        dm->tiles_touched++;
+
+        int distance = Distance(dm, coord) + 1;
+        TileCoord neighbors[NUM_DIRECTIONS];
+        int num_neighbors = GetNeighbors(map, coord, neighbors);
+
+        for ( int i = 0; i < num_neighbors; i++ ) {
+            TileCoord n = neighbors[i];
+            if ( IsWalkable(map, n) && Distance(dm, n) > distance ) {
+                SetDistance(&dm->distances, n, distance);
+                Enqueue(&tail, n);
+            }
+        }
+    }
+}
+
+/// Remove tile `start`'s contribution to distances and repair.
+/// - returns: false if the change was too large and the map was rebuilt.
+static bool RaiseAndRepair(DistanceMap * dm, const Map * map, TileCoord start)
+{
+    int limit = map->width * map->height / MAX_INVALID_FRACTION;
+    int num_invalid = Raise(dm, map, start, limit);
+
+    if ( num_invalid == -1 ) {
+        Rebuild(dm, map, dm->source);
+        return false;
+    }
+
+    Reseed(dm, map, num_invalid);
+    return true;
+}
+
+#pragma mark - PUBLIC
+
+bool DistanceMapIsCurrent(const DistanceMap * dm, const Map * map)
+{
+    return dm->generation == map->generation
+        && DistancePlaneFits(&dm->distances, map->width, map->height);
+}
+
+void UpdateDistanceMap(DistanceMap * dm, const Map * map, TileCoord source)
+{
+    if ( DistanceMapIsCurrent(dm, map) && TileCoordsEqual(dm->source, source) ) {
+        dm->tiles_touched = 0;
+        return;
+    }
+
+    if (   !DistanceMapIsCurrent(dm, map)
+        || TileDistance(dm->source, source) > 1 )
+    {
+        Rebuild(dm, map, source);
+        return;
+    }
+
+    ReserveMarks(map);
+    dm->tiles_touched = 0;
+
+    TileCoord old_source = dm->source;
+
+    // Add the new source, lowering everything closer to it...
+    dm->source = source;
+    SetDistance(&dm->distances, source, 0);
+    int tail = 0;
+    Enqueue(&tail, source);
+    Lower(dm, map, 0, tail);
+
+    // ...then remove the old one.
+    if ( RaiseAndRepair(dm, map, old_source) ) {
+        dm->num_incremental++;
+    }
+}
+
+void DistanceMapTileChanged(DistanceMap * dm,
+                            const Map * map,
+                            TileCoord coord,
+                            u32 old_generation)
+{
+    if ( dm->distances.chunks == NULL || dm->generation != old_generation ) {
+        return; // Already out of date, will be rebuilt on next update.
+    }
+
+    if ( TileCoordsEqual(coord, dm->source) ) {
+        return; // Leave it out of date.
+    }
+
+    ReserveMarks(map);
+    dm->generation = map->generation;
+    dm->tiles_touched = 0;
+
+    bool walkable = IsWalkable(map, coord);
+    bool reached = GetDistance(&dm->distances, coord) != -1;
+
+    if ( walkable && !reached ) {
+        // Opened: this tile may now be a shortcut.
+        int best = UNREACHABLE;
+        TileCoord neighbors[NUM_DIRECTIONS];
+        int num_neighbors = GetNeighbors(map, coord, neighbors);
+
+        for ( int i = 0; i < num_neighbors; i++ ) {
+            int distance = Distance(dm, neighbors[i]);
+            if ( distance != UNREACHABLE && distance + 1 < best ) {
+                best = distance + 1;
+            }
+        }
+
+        if ( best != UNREACHABLE ) {
+            SetDistance(&dm->distances, coord, best);
+            int tail = 0;
+            Enqueue(&tail, coord);
+            Lower(dm, map, 0, tail);
+        }
+        dm->num_incremental++;
+    } else if ( !walkable && reached ) {
+        // Closed: everything routed through this tile must go around.
+        if ( RaiseAndRepair(dm, map, coord) ) {
+            dm->num_incremental++;
+        }
+    }
+}
+
+void FreeDistanceMap(DistanceMap * dm)
+{
+    FreeDistancePlane(&dm->distances);
+}
+
+size_t DistanceMapBuffersMemoryUsage(void)
+{
+    size_t usage = queue_capacity * sizeof(*queue)
+        + seeds_capacity * sizeof(*seeds)
+        + invalid_capacity * sizeof(*invalid);
+
+    if ( mark_chunks ) {
+        usage += mark_chunks_wide * mark_chunks_high * sizeof(*mark_chunks)
+            + num_mark_chunks * sizeof(MarkChunk);
+    }
+
+    return usage;
+}
+
+void FreeDistanceMapBuffers(void)
+{
+    free(queue);
+    free(seeds);
+    free(invalid);
+    queue = NULL;
+    seeds = NULL;
+    invalid = NULL;
+    queue_capacity = 0;
+    seeds_capacity = 0;
+    invalid_capacity = 0;
+
+    if ( mark_chunks ) {
+        for ( int i = 0; i < mark_chunks_wide * mark_chunks_high; i++ ) {
+            free(mark_chunks[i]);
+        }
+        free(mark_chunks);
+    }
+
+    mark_chunks = NULL;
+    mark_chunks_wide = 0;
+    mark_chunks_high = 0;
+    num_mark_chunks = 0;
+}
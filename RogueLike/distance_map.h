@@ -0,0 +1,96 @@
+//
+//  distance_map.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/4/23.
+//
+//  A distance map (8-way BFS distances from a source tile) that can be
+//  repaired in place when the source steps to an adjacent tile or a single
+//  tile starts or stops blocking movement.
+//
+
+#ifndef distance_map_h
+#define distance_map_h
+
+#include "coord.h"
+#include "shorttypes.h"
+
+#include <stddef.h>
+
+typedef struct map Map;
+
+typedef struct {
+    u32 stamp; // The plane's stamp when this chunk was last cleared.
+    s16 distances[MAP_CHUNK_AREA];
+} DistanceChunk;
+
+/// A distance for each tile of a map, -1 if unreachable. Stored in chunks that
+/// are only allocated once a tile in them is reached, so it takes up memory
+/// for the reachable part of the map only. Clearing the plane changes its
+/// stamp rather than rewriting its chunks: a chunk with an old stamp is all
+/// -1 and is cleared for real the next time it's written to.
+typedef struct {
+    DistanceChunk ** chunks; // NULL until a tile in it is reached.
+    int chunks_wide;
+    int chunks_high;
+    int num_chunks_allocated;
+    u32 stamp;
+} DistancePlane;
+
+static inline s16 GetDistance(const DistancePlane * plane, TileCoord coord)
+{
+    const DistanceChunk * chunk = plane->chunks[(coord.y >> MAP_CHUNK_SHIFT) * plane->chunks_wide
+                                                + (coord.x >> MAP_CHUNK_SHIFT)];
+
+    if ( chunk == NULL || chunk->stamp != plane->stamp ) {
+        return -1;
+    }
+
+    return chunk->distances[TileChunkIndex(coord.x, coord.y)];
+}
+
+/// The chunk holding tile (`x`, `y`), allocated or cleared if needed.
+DistanceChunk * GetWritableDistanceChunk(DistancePlane * plane, int x, int y);
+
+static inline void SetDistance(DistancePlane * plane, TileCoord coord, s16 distance)
+{
+    DistanceChunk * chunk = GetWritableDistanceChunk(plane, coord.x, coord.y);
+    chunk->distances[TileChunkIndex(coord.x, coord.y)] = distance;
+}
+
+/// Set every distance to -1, for a map of `width` x `height` tiles.
+void ClearDistancePlane(DistancePlane * plane, int width, int height);
+bool DistancePlaneFits(const DistancePlane * plane, int width, int height);
+size_t DistancePlaneMemoryUsage(const DistancePlane * plane);
+void FreeDistancePlane(DistancePlane * plane);
+
+typedef struct {
+    TileCoord source;
+    u32 generation; // The map generation `distances` is valid for.
+    DistancePlane distances;
+
+    // Stats
+    int tiles_touched; // By the last update.
+    int num_incremental;
+    int num_rebuilds;
+} DistanceMap;
+
+/// Update `dm` to hold distances to `source`, repairing the current distances
+/// if `source` is adjacent to the current source, or otherwise rebuilding.
+void UpdateDistanceMap(DistanceMap * dm, const Map * map, TileCoord source);
+
+/// Repair `dm` after the tile at `coord` was changed via `ChangeTile`.
+/// - parameter old_generation: The map's generation before the change.
+void DistanceMapTileChanged(DistanceMap * dm,
+                            const Map * map,
+                            TileCoord coord,
+                            u32 old_generation);
+
+bool DistanceMapIsCurrent(const DistanceMap * dm, const Map * map);
+void FreeDistanceMap(DistanceMap * dm);
+
+/// Bytes allocated for the work buffers shared by all distance maps.
+size_t DistanceMapBuffersMemoryUsage(void);
+void FreeDistanceMapBuffers(void);
+
+#endif /* distance_map_h */
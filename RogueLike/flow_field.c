@@ -0,0 +1,105 @@
+//
+//  flow_field.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/3/23.
+//
+
+#include "flow_field.h"
+#include "genlib.h"
+
+#include <stdlib.h>
+
+#define FLOW_FIELD_CACHE_SIZE 8
+
+typedef struct {
+    const Map * map; // NULL if this entry is unused.
+    u32 generation;
+    TileCoord target;
+    int ignore_flags;
+
+    DistancePlane distances;
+    u32 last_used;
+} FlowField;
+
+static FlowField cache[FLOW_FIELD_CACHE_SIZE];
+static u32 use_count;
+static int num_calculated;
+
+static bool FieldMatches(const FlowField * field,
+                         const Map * map,
+                         TileCoord target,
+                         int ignore_flags)
+{
+    return field->map == map
+        && field->generation == map->generation
+        && field->ignore_flags == ignore_flags
+        && TileCoordsEqual(field->target, target);
+}
+
+const DistancePlane * GetFlowField(const Map * map, TileCoord target, int ignore_flags)
+{
+    // The player's distance map is kept up to date as they move.
+    const DistanceMap * player_distances = &map->player_distances;
+    if (   ignore_flags == 0
+        && DistanceMapIsCurrent(player_distances, map)
+        && TileCoordsEqual(player_distances->source, target) )
+    {
+        return &player_distances->distances;
+    }
+
+    FlowField * lru = &cache[0];
+
+    for ( int i = 0; i < FLOW_FIELD_CACHE_SIZE; i++ ) {
+        FlowField * field = &cache[i];
+
+        if ( FieldMatches(field, map, target, ignore_flags) ) {
+            field->last_used = ++use_count;
+            return &field->distances;
+        }
+
+        if ( field->last_used < lru->last_used ) {
+            lru = field;
+        }
+    }
+
+    // Not cached: recalculate the least recently used field.
+    CalculateDistances(map, target, ignore_flags, &lru->distances);
+    num_calculated++;
+
+    lru->map = map;
+    lru->generation = map->generation;
+    lru->target = target;
+    lru->ignore_flags = ignore_flags;
+    lru->last_used = ++use_count;
+
+    return &lru->distances;
+}
+
+int FlowFieldsCalculated(void)
+{
+    return num_calculated;
+}
+
+void ResetFlowFieldStats(void)
+{
+    num_calculated = 0;
+}
+
+size_t FlowFieldMemoryUsage(void)
+{
+    size_t usage = 0;
+    for ( int i = 0; i < FLOW_FIELD_CACHE_SIZE; i++ ) {
+        usage += DistancePlaneMemoryUsage(&cache[i].distances);
+    }
+
+    return usage;
+}
+
+void FreeFlowFields(void)
+{
+    for ( int i = 0; i < FLOW_FIELD_CACHE_SIZE; i++ ) {
+        FreeDistancePlane(&cache[i].distances);
+        cache[i] = (FlowField){ 0 };
+    }
+}
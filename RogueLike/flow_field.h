@@ -0,0 +1,28 @@
+//
+//  flow_field.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/3/23.
+//
+
+#ifndef flow_field_h
+#define flow_field_h
+
+#include "map.h"
+
+/// Get the distance from each tile in the map to `target` (see
+/// `CalculateDistances`). Fields are cached by target, ignore flags, and map
+/// generation, so any number of actors heading to the same tile in the same
+/// turn share a single calculation.
+/// - returns: The distances, valid until the next call.
+const DistancePlane * GetFlowField(const Map * map, TileCoord target, int ignore_flags);
+
+/// The number of fields calculated (cache misses) since the last reset.
+int FlowFieldsCalculated(void);
+void ResetFlowFieldStats(void);
+
+/// Bytes allocated for the cached fields, which are shared by all maps.
+size_t FlowFieldMemoryUsage(void);
+void FreeFlowFields(void);
+
+#endif /* flow_field_h */
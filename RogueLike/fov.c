@@ -0,0 +1,158 @@
+//
+//  fov.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/5/23.
+//
+//  Symmetric shadowcasting. See
+//  https://www.albertford.com/shadowcasting/
+//
+
+#include "fov.h"
+
+typedef struct {
+    int num;
+    int den; // Always positive.
+} Slope;
+
+typedef struct {
+    Map * map;
+    TileCoord origin;
+    Box region;
+    FOVCallback visit;
+
+    int quadrant;
+    int max_depth; // Distance from origin to the region edge in this quadrant.
+} Scan;
+
+typedef enum {
+    QUADRANT_NORTH,
+    QUADRANT_EAST,
+    QUADRANT_SOUTH,
+    QUADRANT_WEST,
+    NUM_QUADRANTS
+} Quadrant;
+
+static int FloorDiv(int a, int b)
+{
+    int q = a / b;
+    if ( (a % b != 0) && ((a < 0) != (b < 0)) ) {
+        q--;
+    }
+
+    return q;
+}
+
+/// Round depth * slope to the nearest column, rounding ties up.
+static int RoundTiesUp(int depth, Slope slope)
+{
+    return FloorDiv(2 * depth * slope.num + slope.den, 2 * slope.den);
+}
+
+/// Round depth * slope to the nearest column, rounding ties down.
+static int RoundTiesDown(int depth, Slope slope)
+{
+    return -FloorDiv(-2 * depth * slope.num + slope.den, 2 * slope.den);
+}
+
+/// Convert a (depth, column) position in the current quadrant to a map
+/// coordinate.
+static TileCoord Transform(const Scan * scan, int depth, int col)
+{
+    TileCoord o = scan->origin;
+
+    switch ( (Quadrant)scan->quadrant ) {
+        case QUADRANT_NORTH: return (TileCoord){ o.x + col, o.y - depth };
+        case QUADRANT_SOUTH: return (TileCoord){ o.x + col, o.y + depth };
+        case QUADRANT_EAST: return (TileCoord){ o.x + depth, o.y + col };
+        case QUADRANT_WEST: return (TileCoord){ o.x - depth, o.y + col };
+        default: return o;
+    }
+}
+
+static int QuadrantMaxDepth(const Scan * scan)
+{
+    switch ( (Quadrant)scan->quadrant ) {
+        case QUADRANT_NORTH: return scan->origin.y - scan->region.top;
+        case QUADRANT_SOUTH: return scan->region.bottom - scan->origin.y;
+        case QUADRANT_EAST: return scan->region.right - scan->origin.x;
+        case QUADRANT_WEST: return scan->origin.x - scan->region.left;
+        default: return 0;
+    }
+}
+
+/// The slope from the origin to the near edge of the tile at (depth, col).
+static Slope TileSlope(int depth, int col)
+{
+    return (Slope){ 2 * col - 1, 2 * depth };
+}
+
+/// Is the tile's center within the row's slopes? Needed for symmetry: a floor
+/// is only visible if the origin would also be visible from it.
+static bool IsSymmetric(int depth, int col, Slope start, Slope end)
+{
+    return col * start.den >= depth * start.num
+        && col * end.den <= depth * end.num;
+}
+
+static void ScanRow(const Scan * scan, int depth, Slope start, Slope end)
+{
+    if ( depth > scan->max_depth ) {
+        return;
+    }
+
+    int min_col = RoundTiesUp(depth, start);
+    int max_col = RoundTiesDown(depth, end);
+
+    // -1: no previous tile, 0: floor, 1: wall.
+    int prev = -1;
+
+    for ( int col = min_col; col <= max_col; col++ ) {
+        TileCoord coord = Transform(scan, depth, col);
+
+        if ( !TileInBox(coord, scan->region) ) {
+            continue;
+        }
+
+        int wall = GetTileFlags((const Map *)scan->map, coord)->blocks_sight;
+
+        if ( wall || IsSymmetric(depth, col, start, end) ) {
+            scan->visit(scan->map, coord);
+        }
+
+        if ( prev == 1 && !wall ) {
+            start = TileSlope(depth, col);
+        }
+
+        if ( prev == 0 && wall ) {
+            ScanRow(scan, depth + 1, start, TileSlope(depth, col));
+        }
+
+        prev = wall;
+    }
+
+    if ( prev == 0 ) {
+        ScanRow(scan, depth + 1, start, end);
+    }
+}
+
+void CastFieldOfView(Map * map, TileCoord origin, Box region, FOVCallback visit)
+{
+    if ( !TileInBox(origin, region) ) {
+        return;
+    }
+
+    visit(map, origin);
+
+    Scan scan = {
+        .map = map,
+        .origin = origin,
+        .region = region,
+        .visit = visit,
+    };
+
+    for ( scan.quadrant = 0; scan.quadrant < NUM_QUADRANTS; scan.quadrant++ ) {
+        scan.max_depth = QuadrantMaxDepth(&scan);
+        ScanRow(&scan, 1, (Slope){ -1, 1 }, (Slope){ 1, 1 });
+    }
+}
@@ -0,0 +1,22 @@
+//
+//  fov.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/5/23.
+//
+
+#ifndef fov_h
+#define fov_h
+
+#include "map.h"
+
+typedef void (* FOVCallback)(Map * map, TileCoord coord);
+
+/// Find all tiles visible from `origin` with symmetric shadowcasting. Tiles
+/// that block sight are visible themselves, but hide whatever is behind them.
+/// - parameter region: Only tiles within this box are considered.
+/// - parameter visit: Called for each visible tile. Tiles on the diagonals
+///   may be visited twice.
+void CastFieldOfView(Map * map, TileCoord origin, Box region, FOVCallback visit);
+
+#endif /* fov_h */
@@ -0,0 +1,195 @@
+//
+//  frame_stats.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/13/23.
+//
+
+#include "frame_stats.h"
+#include "game.h"
+#include "debug.h"
+#include "mathlib.h"
+#include "video.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GRAPH_BAR_WIDTH 2
+#define GRAPH_HEIGHT 128 // Two frames' worth of time at FPS.
+
+static const struct {
+    const char * name;
+    SDL_Color color;
+} parts[NUM_FRAME_PARTS] = {
+    [FRAME_UPDATE]      = { "update",       {  80, 120, 255, 255 } },
+    [FRAME_LIGHTING]    = { "lighting",     { 255, 220,  80, 255 } },
+    [FRAME_TILES]       = { "tiles",        {  80, 200,  80, 255 } },
+    [FRAME_ACTORS]      = { "actors",       { 255, 140,  40, 255 } },
+    [FRAME_PARTICLES]   = { "particles",    { 220,  80, 220, 255 } },
+    [FRAME_OTHER]       = { "other",        { 128, 128, 128, 255 } },
+};
+
+static float history[FRAME_HISTORY][NUM_FRAME_PARTS]; // In seconds.
+static float totals[FRAME_HISTORY];
+static int num_frames; // Since the last reset.
+
+void RecordFrameStats(void)
+{
+    float * frame = history[num_frames % FRAME_HISTORY];
+
+    // Lighting happens during the update, and the rest during rendering.
+    frame[FRAME_UPDATE] = MAX(update_msec - lighting_msec, 0.0f);
+    frame[FRAME_LIGHTING] = lighting_msec;
+    frame[FRAME_TILES] = tiles_msec;
+    frame[FRAME_ACTORS] = actors_msec;
+    frame[FRAME_PARTICLES] = particles_msec;
+
+    float named = frame[FRAME_UPDATE] + lighting_msec + tiles_msec
+        + actors_msec + particles_msec;
+    frame[FRAME_OTHER] = MAX(frame_msec - named, 0.0f);
+
+    totals[num_frames % FRAME_HISTORY] = frame_msec;
+    num_frames++;
+}
+
+
+void ResetFrameStats(void)
+{
+    num_frames = 0;
+}
+
+
+static int CompareFloats(const void * a, const void * b)
+{
+    float f1 = *(const float *)a;
+    float f2 = *(const float *)b;
+
+    return (f1 > f2) - (f1 < f2);
+}
+
+
+/// Nearest rank: the smallest time at least `percent` of frames are within.
+static float Percentile(const float * sorted, int count, int percent)
+{
+    int rank = (count * percent + 99) / 100; // ceil
+    return sorted[MAX(rank, 1) - 1];
+}
+
+
+FramePercentiles GetFramePercentiles(void)
+{
+    FramePercentiles result = { 0 };
+
+    int count = MIN(num_frames, FRAME_HISTORY);
+    if ( count == 0 ) {
+        return result;
+    }
+
+    float sorted[FRAME_HISTORY];
+    for ( int i = 0; i < count; i++ ) {
+        sorted[i] = totals[i];
+    }
+
+    qsort(sorted, count, sizeof(*sorted), CompareFloats);
+
+    result.p50 = Percentile(sorted, count, 50);
+    result.p95 = Percentile(sorted, count, 95);
+    result.p99 = Percentile(sorted, count, 99);
+    result.max = sorted[count - 1];
+
+    return result;
+}
+
+
+void RenderFrameGraph(const RenderInfo * info)
+{
+    int count = MIN(num_frames, FRAME_HISTORY);
+    int left = 0;
+    int bottom = info->height;
+    int top = bottom - GRAPH_HEIGHT;
+    float pixels_per_sec = GRAPH_HEIGHT * FPS / 2.0f;
+
+    SDL_Rect background = {
+        left,
+        top,
+        FRAME_HISTORY * GRAPH_BAR_WIDTH,
+        GRAPH_HEIGHT
+    };
+    V_SetRGBA(0, 0, 0, 160);
+    V_FillRect(&background);
+
+    // Oldest frame on the left.
+    for ( int i = 0; i < count; i++ ) {
+        int frame = num_frames - count + i;
+        const float * times = history[frame % FRAME_HISTORY];
+        int y = bottom;
+
+        for ( int part = 0; part < NUM_FRAME_PARTS && y > top; part++ ) {
+            int height = times[part] * pixels_per_sec + 0.5f;
+            height = MIN(height, y - top);
+
+            if ( height > 0 ) {
+                y -= height;
+                SDL_Rect bar = {
+                    left + i * GRAPH_BAR_WIDTH,
+                    y,
+                    GRAPH_BAR_WIDTH,
+                    height
+                };
+                V_SetColor(parts[part].color);
+                V_FillRect(&bar);
+            }
+        }
+    }
+
+    // The frame budget.
+    SDL_Rect budget = {
+        left,
+        bottom - GRAPH_HEIGHT / 2,
+        FRAME_HISTORY * GRAPH_BAR_WIDTH,
+        1
+    };
+    V_SetRGB(255, 80, 80);
+    V_FillRect(&budget);
+
+    int legend_x = left + FRAME_HISTORY * GRAPH_BAR_WIDTH + V_CharWidth();
+    int legend_y = bottom - NUM_FRAME_PARTS * V_CharHeight();
+
+    for ( int part = NUM_FRAME_PARTS - 1; part >= 0; part-- ) {
+        V_SetColor(parts[part].color);
+        V_PrintString(legend_x, legend_y, "%s", parts[part].name);
+        legend_y += V_CharHeight();
+    }
+}
+
+
+bool WriteFrameStatsCSV(const char * path)
+{
+    FILE * file = fopen(path, "w");
+    if ( file == NULL ) {
+        return false;
+    }
+
+    fprintf(file, "frame,total_ms");
+    for ( int part = 0; part < NUM_FRAME_PARTS; part++ ) {
+        fprintf(file, ",%s_ms", parts[part].name);
+    }
+    fprintf(file, "\n");
+
+    int count = MIN(num_frames, FRAME_HISTORY);
+
+    for ( int i = 0; i < count; i++ ) {
+        int frame = num_frames - count + i;
+
+        fprintf(file, "%d,%.3f", frame, totals[frame % FRAME_HISTORY] * 1000.0f);
+        for ( int part = 0; part < NUM_FRAME_PARTS; part++ ) {
+            fprintf(file, ",%.3f", history[frame % FRAME_HISTORY][part] * 1000.0f);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    printf("wrote %d frames to %s\n", count, path);
+
+    return true;
+}
@@ -0,0 +1,55 @@
+//
+//  frame_stats.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/13/23.
+//
+//  A rolling history of frame times, split by what the time went to, for
+//  spotting hitches in the F1 debug screen: percentiles, a stacked graph of
+//  recent frames, and a CSV dump (F10).
+//
+
+#ifndef frame_stats_h
+#define frame_stats_h
+
+#include "render.h"
+
+#include <stdbool.h>
+
+#define FRAME_HISTORY 256
+#define FRAME_CSV_FILE "frame_times.csv"
+
+/// The parts a frame's time is split into. They add up to the frame time.
+typedef enum {
+    FRAME_UPDATE, // Not counting lighting.
+    FRAME_LIGHTING,
+    FRAME_TILES,
+    FRAME_ACTORS,
+    FRAME_PARTICLES,
+    FRAME_OTHER, // The rest of rendering, events, etc.
+    NUM_FRAME_PARTS
+} FramePart;
+
+typedef struct {
+    float p50;
+    float p95;
+    float p99;
+    float max;
+} FramePercentiles;
+
+/// Add the frame just done, from the timings in debug.h.
+void RecordFrameStats(void);
+void ResetFrameStats(void);
+
+/// Percentiles of the frame times in the history, in seconds.
+FramePercentiles GetFramePercentiles(void);
+
+/// Draw the history as stacked bars along the bottom of the screen, with a
+/// legend.
+void RenderFrameGraph(const RenderInfo * info);
+
+/// Write the history, oldest frame first, times in milliseconds.
+/// - returns: False if the file couldn't be written.
+bool WriteFrameStatsCSV(const char * path);
+
+#endif /* frame_stats_h */
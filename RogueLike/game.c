@@ -15,6 +15,13 @@
 #include "menu.h"
 #include "config.h"
 #include "game_log.h"
+#include "bench.h"
+#include "flow_field.h"
+#include "tile_cache.h"
+#include "pregen.h"
+#include "sprite_batch.h"
+#include "replay.h"
+#include "frame_stats.h"
 
 #include "mathlib.h"
 #include "sound.h"
@@ -34,43 +41,69 @@ static vec2_t GetWindowScale(const RenderInfo * info)
 }
 
 
-/// In the visible rect, set each tile's light level according to its visibility
-/// flags.
-void SetTileLight(World * world, const RenderInfo * render_info)
+/// Update the light map for the camera region, lit by the visible actors.
+static void UpdateLighting(Game * game,
+                           const ActorRef * visible_actors,
+                           int num_visible_actors)
 {
-    const AreaInfo * info = world->info;
-    Box vis = GetCameraVisibleRegion(world->map, render_info);
+    ProfileScope scope = PROFILE_BEGIN("UpdateLighting");
+    float start = ProgramTime();
 
-    for ( int y = vis.top; y <= vis.bottom; y++ ) {
-        for ( int x = vis.left; x <= vis.right; x++ ) {
-            TileCoord coord = { x, y };
-            Tile * tile = GetTile(world->map, coord);
+    World * world = &game->world;
+    LightMap * light_map = &world->map->light_map;
 
-            if ( tile == NULL ) {
-                Error("error: somehow NULL tile in vis rect!");
-            }
+    BeginLights(light_map);
 
-            if ( tile->flags.bright ) {
-                tile->light = 255;
-            } else if ( info->reveal_all ) {
-                tile->light = info->visible_light;
-                tile->flags.visible = true;
-            } else {
-                if ( tile->flags.visible ) {
-                    tile->light = info->visible_light;
-                } else if ( tile->flags.revealed ) {
-                    tile->light = info->revealed_light;
-                } else {
-                    tile->light = info->unrevealed_light;
-                }
-            }
+    for ( int i = 0; i < num_visible_actors; i++ ) {
+        const Actor * actor = DerefActor(visible_actors[i]);
+
+        if ( actor->type != ACTOR_PLAYER || game->player_info.fuel ) {
+            AddLight(light_map,
+                     actor->tile,
+                     actor->info->light_radius,
+                     actor->info->light);
         }
     }
+
+    Box region = GetCameraVisibleRegion(world->map, &game->render_info);
+    UpdateLightMap(light_map, world->map, world->info, region);
+
+    lighting_msec = ProgramTime() - start;
+    PROFILE_END(scope);
+}
+
+
+void InitLevelGenForLevel(LevelGen * gen,
+                          Game * game,
+                          Map * maps,
+                          int level_num,
+                          int seed)
+{
+    if ( level_num == 1 ) {
+        InitLevelGen(gen,
+                     game,
+                     maps,
+                     AREA_FOREST,
+                     seed,
+                     game->forest_size,
+                     game->forest_size);
+    } else {
+        InitLevelGen(gen, game, maps, AREA_DUNGEON, seed, 31, 31);
+    }
+}
+
+
+int LevelSeed(const Game * game, int level_num)
+{
+    // The debug seed steps through levels for the same level number.
+    u32 seed = (u32)SplitSeed(game->master_seed, (u64)level_num);
+    return (int)(seed + (u32)game->forest_seed);
 }
 
 
 void LoadLevel(Game * game, int level_num, bool persist_player_stats)
 {
+    ProfileScope scope = PROFILE_BEGIN("LoadLevel");
     World * world = &game->world;
 
     ActorsStats saved_player_stats = { 0 };
@@ -81,8 +114,6 @@ void LoadLevel(Game * game, int level_num, bool persist_player_stats)
         }
     }
 
-    int seed = (int)time(NULL);
-
     if ( level_num == ENTER_SUBLEVEL ) {
         game->world.map++;
         if ( game->world.area == AREA_FOREST ) { // TODO: refactor
@@ -98,14 +129,22 @@ void LoadLevel(Game * game, int level_num, bool persist_player_stats)
     } else {
         game->level = level_num;
 
-        if ( level_num == 1 ) {
-            GenerateWorld(game,
-                          AREA_FOREST,
-                          (int)time(NULL),
-                          game->forest_size,
-                          game->forest_size);
-        } else {
-            GenerateWorld(game, AREA_DUNGEON, seed, 31, 31);
+        int seed = LevelSeed(game, level_num);
+        printf("level %d seed: %d\n", level_num, seed);
+
+        // Loot, particles and so on go the same way each time this level is
+        // played. Sublevels carry on with their level's streams.
+        for ( RngStream s = 0; s < NUM_RNG_STREAMS; s++ ) {
+            game->rng[s] = SeedRng((u32)seed, s);
+        }
+
+        LevelGen gen;
+        InitLevelGenForLevel(&gen, game, world->maps, level_num, seed);
+
+        // Usually the level was generated in the background while the player
+        // was on the previous one.
+        if ( !TakePregeneratedLevel(game, &gen) ) {
+            GenerateWorld(game, gen.area, gen.seed, gen.width, gen.height);
         }
 
         // Some things to reset when entering a new level:
@@ -124,13 +163,22 @@ void LoadLevel(Game * game, int level_num, bool persist_player_stats)
         player->stats = saved_player_stats;
     }
 
+    UpdateDistanceMap(&world->map->player_distances, world->map, player->tile);
+
     // Initial lighting.
     PlayerCastSight(world, &game->render_info);
-    SetTileLight(&game->world, &game->render_info);
 
-    FOR_EACH_ACTOR(actor, world->map->actor_list) {
-        CastLight(world, actor);
+    int num_visible_actors = 0;
+    ActorRef * visible_actors = GetVisibleActors(world,
+                                                 &game->render_info,
+                                                 &num_visible_actors);
+    UpdateLighting(game, visible_actors, num_visible_actors);
+
+    if ( level_num != ENTER_SUBLEVEL && level_num != EXIT_SUBLEVEL ) {
+        PregenerateLevel(game, level_num + 1);
     }
+
+    PROFILE_END(scope);
 }
 
 
@@ -144,6 +192,7 @@ void StartFadeIn(FadeState * fade_state, float seconds)
 
 void NewGame(Game * game)
 {
+    RecordNewGame(game);
     LoadLevel(game, 1, false);
     game->player_info.inventory.item_counts[0] = 3;
     game->player_info.inventory.item_counts[1] = 3;
@@ -176,30 +225,18 @@ void UpdateLevel(Game * game, float dt)
                                                1.0f);
 
     int num_visible_actors = 0;
-    Actor ** visible_actors = GetVisibleActors(&game->world, &game->render_info, &num_visible_actors);
+    ActorRef * visible_actors = GetVisibleActors(&game->world, &game->render_info, &num_visible_actors);
 
     // Update Actors: run timers.
     for ( int i = 0; i < num_visible_actors; i++ ) {
-        Actor * actor = visible_actors[i];
+        Actor * actor = DerefActor(visible_actors[i]);
         if ( actor->hit_timer > 0.0f ) {
             actor->hit_timer -= 5.0f * dt;
         }
     }
 
     // Update lighting based on new camera position.
-
-    SetTileLight(&game->world, &game->render_info);
-
-
-    for ( int i = 0; i < num_visible_actors; i++ ) {
-        Actor * actor = visible_actors[i];
-
-        if (    actor->type != ACTOR_PLAYER
-            || (actor->type == ACTOR_PLAYER && game->player_info.fuel) )
-        {
-            CastLight(&game->world, actor);
-        }
-    }
+    UpdateLighting(game, visible_actors, num_visible_actors);
 
     // Update inventory panel position
     {
@@ -215,8 +252,8 @@ void UpdateLevel(Game * game, float dt)
 
     UpdateParticles(&game->world.particles, dt);
 
-    // Update mouse tile
-    {
+    // Update mouse tile (if there's a window: not when running headless)
+    if ( window ) {
         vec2_t window_scale = GetWindowScale(&game->render_info);
         int mx, my;
         SDL_GetMouseState(&mx, &my);
@@ -259,7 +296,7 @@ void TryMovePlayer(Actor * player,
 //            player->flags.on_teleporter = false;
 //        }
 
-        CalculateDistances(map, player->tile, 0, true);
+        UpdateDistanceMap(&map->player_distances, map, player->tile);
     }
 
     --player_info->turns;
@@ -274,9 +311,8 @@ void TryMovePlayer(Actor * player,
 
 void StartTurn(Game * game, TileCoord destination, Direction direction)
 {
-    printf("--- START TURN ---\n");
-
-    float start_time = ProgramTime();
+    ProfileScope scope = PROFILE_BEGIN("StartTurn");
+    ResetFlowFieldStats();
 
     World * world = &game->world;
     Actor * player = FindActor(&world->map->actor_list, ACTOR_PLAYER);
@@ -287,12 +323,12 @@ void StartTurn(Game * game, TileCoord destination, Direction direction)
     // Do player-tile collisions:
 
     // The tile we are moving to.
-    Tile * tile;
+    const Tile * tile;
     if ( direction != NO_DIRECTION ) {
         tile = GetAdjacentTile(world->map, player->tile, direction);
         destination = AdjacentTileCoord(player->tile, direction);
     } else {
-        tile = GetTile(world->map, destination);
+        tile = GetTile((const Map *)world->map, destination);
     }
 
     switch ( (TileType)tile->type ) {
@@ -312,14 +348,13 @@ void StartTurn(Game * game, TileCoord destination, Direction direction)
 
             // Lower pillars.
             for ( int i = 0; i < 2; i++ ) {
-                Tile * pillar_tile = GetTile(world->map, pillars[i]->tile);
-                *pillar_tile = CreateTile(TILE_BUTTON_PRESSED);
+                ChangeTile(world->map, pillars[i]->tile, TILE_BUTTON_PRESSED);
                 RemoveActor(pillars[i]);
             }
 
             // Press the button.
             S_Play("l32 o1 b- c");
-            *tile = CreateTile(TILE_BUTTON_PRESSED);
+            ChangeTile(world->map, destination, TILE_BUTTON_PRESSED);
 
             TryMovePlayer(player, world->map, destination, player_info);
             break;
@@ -328,7 +363,8 @@ void StartTurn(Game * game, TileCoord destination, Direction direction)
         case TILE_DUNGEON_DOOR:
             SetUpBumpAnimation(player, direction);
             S_Play("l32o2c+f+b");
-            *tile = CreateTile(TILE_DUNGEON_FLOOR); // Open (remove) the door.
+            // Open (remove) the door.
+            ChangeTile(world->map, destination, TILE_DUNGEON_FLOOR);
 
             // Make sure to reveal what's behind the door.
             PlayerCastSight(world, &game->render_info);
@@ -338,7 +374,7 @@ void StartTurn(Game * game, TileCoord destination, Direction direction)
             SetUpBumpAnimation(player, direction);
             if ( player_info->has_gold_key ) {
                 S_Play("l32o2 c+g+dae-b-");
-                *tile = CreateTile(TILE_DUNGEON_FLOOR);
+                ChangeTile(world->map, destination, TILE_DUNGEON_FLOOR);
             } else {
                 S_Play("l32o2 gc+");
                 Log("You need the Gold Key!");
@@ -380,14 +416,16 @@ void StartTurn(Game * game, TileCoord destination, Direction direction)
         // Do all actor turns.
         FOR_EACH_ACTOR(actor, world->map->actor_list) {
             if ( !actor->flags.was_attacked && actor->info->action ) {
+                ProfileScope action_scope = PROFILE_BEGIN(actor->info->name);
                 actor->info->action(actor);
+                PROFILE_END(action_scope);
             }
 
             actor->flags.was_attacked = false; // reset
         }
     }
 
-    printf("%s: %.2f ms\n", __func__, (ProgramTime() - start_time) * 1000.0f);
+    PROFILE_END(scope);
 }
 
 
@@ -492,6 +530,8 @@ void RenderHUD(const Game * game, const Actor * player)
 
         RenderIcon(icon, fuel_x + i * SCALED(ICON_SIZE), hud_y, &game->render_info);
     }
+
+    FlushSprites();
 }
 
 
@@ -504,29 +544,87 @@ void RenderDebugInfo(const World * world,
 {
     const Map * map = world->map;
 
-    DEBUG_PRINT("Frame time: %.1f (max: %.1f)",
+    FramePercentiles frames = GetFramePercentiles();
+    DEBUG_PRINT("Frame time: %.1f (p50 %.1f, p95 %.1f, p99 %.1f, max %.1f)",
                 frame_msec * 1000.0f,
-                max_frame_msec * 1000.0f);
+                frames.p50 * 1000.0f,
+                frames.p95 * 1000.0f,
+                frames.p99 * 1000.0f,
+                frames.max * 1000.0f);
     DEBUG_PRINT("- Update time: %.1f", update_msec * 1000.0f);
     DEBUG_PRINT("- Render time: %.1f", render_msec * 1000.0f);
     DEBUG_PRINT("- - Tiles: %.1f", tiles_msec * 1000.0f);
     DEBUG_PRINT("- - Actors: %.1f", actors_msec * 1000.0f);
+    DEBUG_PRINT("- Lighting: %.3f", lighting_msec * 1000.0f);
+    DEBUG_PRINT("- Particles: %.3f", particles_msec * 1000.0f);
+    DEBUG_PRINT("F10: write last %d frames to "FRAME_CSV_FILE, FRAME_HISTORY);
+    if ( profiling ) {
+        DEBUG_PRINT("Profiling (F9 to stop and write "DEFAULT_TRACE_FILE")");
+    }
     DEBUG_PRINT(" ");
     DEBUG_PRINT("Player health: %d", player->stats.health);
+    DEBUG_PRINT("Flow fields last turn: %d", FlowFieldsCalculated());
+
+    const DistanceMap * distances = &map->player_distances;
+    DEBUG_PRINT("Player distances: %d tiles touched (of %d)",
+                distances->tiles_touched,
+                map->width * map->height);
+    DEBUG_PRINT("- %d incremental, %d rebuilds",
+                distances->num_incremental,
+                distances->num_rebuilds);
+
+    const LightMap * light_map = &map->light_map;
+    DEBUG_PRINT("Light map: %d composites, %d skipped",
+                light_map->num_composites,
+                light_map->num_skipped);
+    DEBUG_PRINT("- %d lights, %d contributions calculated",
+                light_map->num_lights,
+                LightContributionsCalculated());
+
+    if ( use_tile_cache ) {
+        TileCacheStats tile_cache = GetTileCacheStats();
+        DEBUG_PRINT("Tile chunks: %d drawn, %d rebuilt, %d uncached",
+                    tile_cache.chunks_drawn,
+                    tile_cache.chunks_rebuilt,
+                    tile_cache.chunks_uncached);
+    } else {
+        DEBUG_PRINT("Tile chunks: off (F4)");
+    }
+
+    for ( int i = 0; i < MAX_MAPS; i++ ) {
+        const Map * m = &world->maps[i];
+        DEBUG_PRINT("Map %d: %d x %d, %zu KB (%d of %d tile chunks, %d actor chunks)",
+                    i,
+                    m->width,
+                    m->height,
+                    MapMemoryUsage(m) / 1024,
+                    m->num_chunks_allocated,
+                    m->chunks_wide * m->chunks_high,
+                    m->actor_list.num_chunks_allocated);
+    }
+
+    DEBUG_PRINT("Shared by maps: %zu KB (flow fields, path and light buffers)",
+                SharedMapMemoryUsage() / 1024);
+
+    SpriteBatchStats sprite_batch = GetSpriteBatchStats();
+    DEBUG_PRINT("Sprites: %d in %d draw calls",
+                sprite_batch.sprites,
+                sprite_batch.draw_calls);
 //    DEBUG_PRINT("Actors %d", world->actors.count);
 
-    Tile * hover = GetTile((Map *)map, mouse_tile);
+    const Tile * hover = GetTile(map, mouse_tile);
     if ( hover ) {
         DEBUG_PRINT("Mouse tile: %d, %d (%s)",
                     mouse_tile.x,
                     mouse_tile.y,
                     TileName(hover->type));
-        DEBUG_PRINT(" light: %d", hover->light);
-        DEBUG_PRINT(" revealed: %s", BOOL_STR(hover->flags.revealed));
-        DEBUG_PRINT(" visible: %s", BOOL_STR(hover->flags.visible));
-        DEBUG_PRINT(" blocking: %s", BOOL_STR(hover->flags.blocks_movement));
+        DEBUG_PRINT(" light: %d", GetTileLight(map, mouse_tile));
+        const TileFlags * flags = GetTileFlags(map, mouse_tile);
+        DEBUG_PRINT(" revealed: %s", BOOL_STR(flags->revealed));
+        DEBUG_PRINT(" visible: %s", BOOL_STR(flags->visible));
+        DEBUG_PRINT(" blocking: %s", BOOL_STR(flags->blocks_movement));
 
-        bool los = LineOfSight((Map *)map, player->tile, mouse_tile);
+        bool los = LineOfSight(map, player->tile, mouse_tile);
         DEBUG_PRINT(" LOS: %s", los ? "yes" : "no");
     } else {
 
@@ -561,6 +659,8 @@ void GamePlayRender(const Game * game)
             int y = actor->tile.y * size;
             RenderActor(actor, x, y, size, true, game->ticks);
         }
+
+        FlushSprites();
     } else {
         RenderWorld(world, &game->render_info, game->ticks);
 
@@ -580,6 +680,7 @@ void GamePlayRender(const Game * game)
     if ( show_debug_info ) {
         const Actor * player = FindActorConst(&world->map->actor_list, ACTOR_PLAYER);
         RenderDebugInfo(&game->world, player, world->mouse_tile);
+        RenderFrameGraph(&game->render_info);
     }
 
     // Darken world a bit so the menu is clear.
@@ -627,12 +728,15 @@ Game * InitGame(int width, int height)
     game->render_info = InitRenderInfo(width, height);
 
     // TODO: move to debug.c
-    game->forest_size = 256;
+    game->forest_size = FOREST_SIZE;
     game->forest_seed = 0;
     game->forest_freq = 0.06f;
     game->forest_amp = 1.0f;
     game->forest_pers = 0.6f;
     game->forest_lec = 2.0f; // lac
+    // Checked against noise.c's FractalNoise: over 100 seeds they still give
+    // about 13.5% ground and 0.8% water inside the level radius, as with the
+    // old Noise2, and no other pair on a 0.01 grid comes closer.
     game->forest_low = -0.35f;
     game->forest_high = 0.05;
 
@@ -651,13 +755,23 @@ void DoFrame(Game * game, float dt)
 //    SDL_Keymod mods = SDL_GetModState();
 //    bool shift = mods & KMOD_SHIFT;
 
+    // A replay gives the commands instead of the player.
+    UpdateReplay(game);
+
+    // Timings for parts that might not happen this frame.
+    lighting_msec = 0.0f;
+    tiles_msec = 0.0f;
+    actors_msec = 0.0f;
+    particles_msec = 0.0f;
+
     SDL_Event event;
     while ( SDL_PollEvent(&event) ) {
 
         // Let the current game state process this event first, if not doing
         // a fade in/out transition.
-        if (   game->fade_state.type == FADE_NONE
-            || game->fade_state.type == FADE_IN )
+        if ( !IsReplaying()
+            && (game->fade_state.type == FADE_NONE
+                || game->fade_state.type == FADE_IN) )
         {
             const GameState * state = game->state_stack[game->state_stack_top];
 
@@ -682,7 +796,7 @@ void DoFrame(Game * game, float dt)
                         break;
                     case SDLK_F1:
                         show_debug_info = !show_debug_info;
-                        max_frame_msec = 0.0f;
+                        ResetFrameStats();
                         break;
                     case SDLK_F2:
                         show_debug_map = !show_debug_map;
@@ -690,6 +804,36 @@ void DoFrame(Game * game, float dt)
                     case SDLK_F3:
                         show_distances = !show_distances;
                         break;
+                    case SDLK_F4:
+                        use_tile_cache = !use_tile_cache;
+                        break;
+                    case SDLK_F5:
+                        BenchmarkFindPath(game);
+                        LoadLevel(game, game->level, false);
+                        break;
+                    case SDLK_F6:
+                        StressTestActors(game);
+                        LoadLevel(game, game->level, false);
+                        break;
+                    case SDLK_F7:
+                        CompareFieldOfView(game);
+                        LoadLevel(game, game->level, false);
+                        break;
+                    case SDLK_F8:
+                        BenchmarkTilePasses(game);
+                        LoadLevel(game, game->level, false);
+                        break;
+                    case SDLK_F9:
+                        if ( profiling ) {
+                            StopProfiling();
+                            WriteTrace(DEFAULT_TRACE_FILE);
+                        } else {
+                            StartProfiling();
+                        }
+                        break;
+                    case SDLK_F10:
+                        WriteFrameStatsCSV(FRAME_CSV_FILE);
+                        break;
                     case SDLK_LEFTBRACKET:
                         LoadLevel(game, game->level - 1, false);
                         break;
@@ -749,7 +893,7 @@ void DoFrame(Game * game, float dt)
                         if ( event.button.clicks == 2 && show_debug_info ) {
                             Actor * player = FindActor(&game->world.map->actor_list,
                                                        ACTOR_PLAYER);
-                            player->tile = game->world.mouse_tile;
+                            SetActorTile(player, game->world.mouse_tile);
                         }
                         break;
                     default:
@@ -761,8 +905,16 @@ void DoFrame(Game * game, float dt)
         }
     }
 
+    ProfileScope update_scope = PROFILE_BEGIN("UpdateState");
     PROFILE(UpdateState(game, dt), update_msec);
+    PROFILE_END(update_scope);
+
+    if ( skip_render ) {
+        game->ticks++;
+        return;
+    }
 
+    ProfileScope render_scope = PROFILE_BEGIN("Render");
     float render_start = ProgramTime();
 
     V_ClearRGB(0, 0, 0);
@@ -779,8 +931,10 @@ void DoFrame(Game * game, float dt)
     }
 
     V_Refresh();
+    EndSpriteBatchFrame();
 
     render_msec = ProgramTime() - render_start;
+    PROFILE_END(render_scope);
 
     game->ticks++;
 }
@@ -28,7 +28,6 @@
 #define GAME_NAME "Untitled Rogue-like"
 
 #define FPS 30.0f
-#define MAP_MAX 100
 #define INITIAL_TURNS 0
 
 #define FLAG(x) (1 << x)
@@ -78,6 +77,10 @@ struct game {
     PlayerInfo player_info;
     int level;
 
+    // Every level's seed is split off from this. See rng.h.
+    u64 master_seed;
+    Rng rng[NUM_RNG_STREAMS]; // Reseeded for each level.
+
 //    char log[100];
 
     int state_timer;
@@ -109,6 +112,17 @@ void DoFrame(Game * game, float dt);
 //vec2_t GetWindowScale(void);
 void NewGame(Game * game);
 void LoadLevel(Game * game, int level_num, bool persist_player_stats);
+
+/// The seed for level `level_num` in the current game.
+int LevelSeed(const Game * game, int level_num);
+
+/// Set up `gen` for level `level_num`: the forest on level one, a dungeon on
+/// every other.
+void InitLevelGenForLevel(LevelGen * gen,
+                          Game * game,
+                          Map * maps,
+                          int level_num,
+                          int seed);
 void StartFadeIn(FadeState * fade_state, float seconds);
 void StartTurn(Game * game, TileCoord destination, Direction direction);
 void UpdateLevel(Game * game, float dt);
@@ -131,6 +145,34 @@ void DebugWaitForKeyPress(void);
 void CheckForShowMapGenCancel(void);
 
 
+#pragma mark - gs_level_idle.c
+
+/// Something the player does on the level. Everything that changes the game
+/// is a command, so a game can be recorded and replayed. See replay.h.
+typedef enum {
+    COMMAND_MOVE,
+    COMMAND_TOGGLE_INVENTORY,
+    COMMAND_SELECT_ITEM,
+    COMMAND_USE_ITEM,
+
+    // Debug
+    COMMAND_ADD_FUEL,
+    COMMAND_ADD_HEALTH,
+    COMMAND_GIVE_SHACK_KEY,
+
+    NUM_COMMANDS
+} CommandType;
+
+typedef struct {
+    u8 type; // CommandType
+    u8 direction; // For moving and changing the inventory selection.
+    u16 wait_ticks; // Frames since the previous command, when replaying.
+} Command;
+
+/// Do and record `command`.
+void DoCommand(Game * game, Command command);
+
+
 #pragma mark - player.c
 
 void PlayerCastSight(World * world, const RenderInfo * render_info);
@@ -8,36 +8,77 @@
 #include "game.h"
 #include "sound.h"
 #include "game_log.h"
+#include "replay.h"
 
-static bool InventoryProcessEvent(Game * game, const SDL_Event * event)
+void DoCommand(Game * game, Command command)
+{
+    RecordCommand(game, command);
+
+    switch ( (CommandType)command.type ) {
+        case COMMAND_MOVE: {
+            TileCoord dummy_coord = { 0, 0 };
+            StartTurn(game, dummy_coord, command.direction);
+            break;
+        }
+        case COMMAND_TOGGLE_INVENTORY:
+            game->inventory_open = !game->inventory_open;
+            break;
+        case COMMAND_SELECT_ITEM:
+            ChangeInventorySelection(&game->player_info.inventory,
+                                     command.direction);
+            break;
+        case COMMAND_USE_ITEM: {
+            Actor * player = FindActor(&game->world.map->actor_list,
+                                       ACTOR_PLAYER);
+            UseItem(player);
+            break;
+        }
+        case COMMAND_ADD_FUEL:
+            game->player_info.fuel++;
+            break;
+        case COMMAND_ADD_HEALTH: {
+            Actor * player = FindActor(&game->world.map->actor_list,
+                                       ACTOR_PLAYER);
+            player->stats.health++;
+            break;
+        }
+        case COMMAND_GIVE_SHACK_KEY:
+            game->player_info.has_shack_key = true;
+            break;
+        default:
+            break;
+    }
+}
+
+
+static bool DoCommandType(Game * game, CommandType type, Direction direction)
 {
-    Inventory * inv = &game->player_info.inventory;
+    Command command = { .type = type, .direction = direction };
+    DoCommand(game, command);
+
+    return true;
+}
 
+
+static bool InventoryProcessEvent(Game * game, const SDL_Event * event)
+{
     switch ( event->type ) {
         case SDL_KEYDOWN:
             switch ( event->key.keysym.sym ) {
                 case SDLK_w:
                 case SDLK_UP:
-                    ChangeInventorySelection(inv, NORTH);
-                    return true;
+                    return DoCommandType(game, COMMAND_SELECT_ITEM, NORTH);
                 case SDLK_s:
                 case SDLK_DOWN:
-                    ChangeInventorySelection(inv, SOUTH);
-                    return true;
+                    return DoCommandType(game, COMMAND_SELECT_ITEM, SOUTH);
                 case SDLK_a:
                 case SDLK_LEFT:
-                    ChangeInventorySelection(inv, WEST);
-                    return true;
+                    return DoCommandType(game, COMMAND_SELECT_ITEM, WEST);
                 case SDLK_d:
                 case SDLK_RIGHT:
-                    ChangeInventorySelection(inv, EAST);
-                    return true;
-                case SDLK_RETURN: {
-                    Actor * player = FindActor(&game->world.map->actor_list,
-                                               ACTOR_PLAYER);
-                    UseItem(player);
-                    return true;
-                }
+                    return DoCommandType(game, COMMAND_SELECT_ITEM, EAST);
+                case SDLK_RETURN:
+                    return DoCommandType(game, COMMAND_USE_ITEM, NO_DIRECTION);
                 default:
                     return false;
             }
@@ -51,41 +92,31 @@ static bool InventoryProcessEvent(Game * game, const SDL_Event * event)
 static bool LevelProcessEvent(Game * game, const SDL_Event * event)
 {
 //    const float elevation_change = 0.05f;
-    TileCoord dummy_coord = { 0, 0 };
 
     switch ( event->type ) {
         case SDL_KEYDOWN:
             switch ( event->key.keysym.sym ) {
 
                 case SDLK_w:
-                    StartTurn(game, dummy_coord, NORTH);
-                    return true;
+                    return DoCommandType(game, COMMAND_MOVE, NORTH);
 
                 case SDLK_s:
-                    StartTurn(game, dummy_coord, SOUTH);
-                    return true;
+                    return DoCommandType(game, COMMAND_MOVE, SOUTH);
 
                 case SDLK_a:
-                    StartTurn(game, dummy_coord, WEST);
-                    return true;
+                    return DoCommandType(game, COMMAND_MOVE, WEST);
 
                 case SDLK_d:
-                    StartTurn(game, dummy_coord, EAST);
-                    return true;
+                    return DoCommandType(game, COMMAND_MOVE, EAST);
 
                 case SDLK_1:
-                    game->player_info.fuel++;
-                    return true;
+                    return DoCommandType(game, COMMAND_ADD_FUEL, NO_DIRECTION);
 
-                case SDLK_2: {
-                    Actor * player = FindActor(&game->world.map->actor_list, ACTOR_PLAYER);
-                    player->stats.health++;
-                    return true;
-                }
+                case SDLK_2:
+                    return DoCommandType(game, COMMAND_ADD_HEALTH, NO_DIRECTION);
 
                 case SDLK_3:
-                    game->player_info.has_shack_key = true;
-                    return true;
+                    return DoCommandType(game, COMMAND_GIVE_SHACK_KEY, NO_DIRECTION);
 
                 case SDLK_l:
                     Log("Test String!");
@@ -126,7 +157,7 @@ static bool LevelProcessEvent(Game * game, const SDL_Event * event)
 bool LevelIdle_ProcessEvent(Game * game, const SDL_Event * event)
 {
     if ( event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_TAB ) {
-        game->inventory_open = !game->inventory_open;
+        return DoCommandType(game, COMMAND_TOGGLE_INVENTORY, NO_DIRECTION);
     }
 
     if ( game->inventory_open ) {
@@ -157,7 +188,7 @@ void LevelIdle_Update(Game * game, float dt)
 void LevelIdle_OnEnter(Game * game)
 {
     Actor * player = FindActor(&game->world.map->actor_list, ACTOR_PLAYER);
-    Tile * player_tile = GetTile(game->world.map, player->tile);
+    const Tile * player_tile = GetTile((const Map *)game->world.map, player->tile);
 
     // Check if the player has moved onto a tile that requires action:
 
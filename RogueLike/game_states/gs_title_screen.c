@@ -8,6 +8,10 @@
 #include "game.h"
 #include "game_state.h"
 #include "menu.h"
+#include "pregen.h"
+
+#include <string.h>
+#include <time.h>
 
 void TitleScreen_Render(const Game * game)
 {
@@ -23,11 +27,15 @@ void TitleScreen_OnEnter(Game * game)
     printf("title screen seed: %d\n", seed);
     GenerateWorld(game, AREA_FOREST, seed, game->forest_size, game->forest_size);
 
+    // Each new game gets its own levels.
+    game->master_seed = (u64)time(NULL);
+    printf("master seed: %llu\n", (unsigned long long)game->master_seed);
+
+    // Start on the first level while the player's on the title screen.
+    PregenerateLevel(game, 1);
+
     // TODO: check if this is still needed.
-    for ( int i = 0; i < game->world.map->width * game->world.map->height; i++ ) {
-        Tile * tile = &game->world.map->tiles[i];
-        tile->light = game->world.info->revealed_light;
-    }
+    SetMapLight(game->world.map, game->world.info->revealed_light);
 
     // Remove all actors.
     RemoveAllActors(&game->world.map->actor_list);
@@ -9,40 +9,34 @@
 #include "mathlib.h"
 #include "texture.h"
 #include "video.h"
+#include "sprite_batch.h"
 
 const int debug_tile_size = 16;
 
-static TileCoord * _buffer;
-static int _count;
+// The level generator's list of coordinates is used as a buffer of candidate
+// tiles for whatever is being placed.
 
-
-static void BufferClear(void)
+static void BufferClear(LevelGen * gen)
 {
-    _count = 0;
+    gen->num_coords = 0;
 }
 
 
-static void BufferAppend(TileCoord coord)
+static void BufferAppend(LevelGen * gen, TileCoord coord)
 {
-    _buffer[_count++] = coord;
+    AddGenCoord(gen, coord);
 }
 
 
-static void BufferRemove(int index)
+static void BufferRemove(LevelGen * gen, int index)
 {
-    _buffer[index] = _buffer[--_count];
+    gen->coords[index] = gen->coords[--gen->num_coords];
 }
 
 
-//static TileCoord BufferRandom(void)
-//{
-//    return _buffer[Random(0, _count - 1)];
-//}
-
-
-static int RandomIndex(void)
+static int RandomIndex(LevelGen * gen)
 {
-    return Random(0, _count - 1);
+    return RngInt(&gen->rng, 0, gen->num_coords - 1);
 }
 
 
@@ -51,7 +45,8 @@ static int RandomIndex(void)
 
 TileID * GetTileID(Map * map, TileCoord coord)
 {
-    return &map->tile_ids[coord.y * map->width + coord.x];
+    TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+    return &chunk->tile_ids[TileChunkIndex(coord.x, coord.y)];
 }
 
 
@@ -59,8 +54,10 @@ void DebugRenderTiles(const Map * map, Area area, int tile_size, const RenderInf
 {
     for ( int y = 0; y < map->height; y++ ) {
         for ( int x = 0; x < map->width; x++ ) {
-            Tile * tile = GetTile((Map *)map, ((TileCoord){ x, y }));
-            RenderTile(tile,
+            TileCoord coord = { x, y };
+            RenderTile(GetTile(map, coord),
+                       TileVariety(map, coord),
+                       255,
                        area,
                        0,
                        x * tile_size,
@@ -70,6 +67,8 @@ void DebugRenderTiles(const Map * map, Area area, int tile_size, const RenderInf
                        info);
         }
     }
+
+    FlushSprites();
 }
 
 
@@ -89,100 +88,82 @@ void RenderTilesWithDelay(Game * game)
 
 
 ///
-/// Carve out a hallway recursively, setting each new floor tile with the
-/// current region ID.
+/// Carve out a hallway, setting each new floor tile with the current region
+/// ID. The hallway winds randomly from `coord` until it runs out of walls to
+/// carve into.
 ///
-static void GenerateHallway_r(Map * map, int current_id, TileCoord coord)
+static void GenerateHallway(Map * map, Rng * rng, int current_id, TileCoord coord)
 {
-    Tile * here = GetTile(map, coord);
-    TileID * id = GetTileID(map, coord);
-    *here = CreateTile(TILE_DUNGEON_FLOOR);
-    here->id = -1;
-    *id = current_id;
-
-//    RenderTilesWithDelay(map);
-
-    struct {
-        TileCoord coord;
-        Direction direction;
-    } directions[NUM_CARDINAL_DIRECTIONS];
+    while ( true ) {
+        TileID * id = GetTileID(map, coord);
+        SetTile(map, coord, TILE_DUNGEON_FLOOR);
+        SetRegionID(map, coord, -1);
+        *id = current_id;
 
-    int num_open_directions = 0;
-
-    // Make a list of the coordinates of possible directions.
-    for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
-//        int next_x = x + x_deltas[i] * 2;
-//        int next_y = y + y_deltas[i] * 2;
-//        tile_t * next = GetTile(map, next_x, next_y);
-        TileCoord next_coord = {
-            coord.x + XDelta(d) * 2,
-            coord.y + YDelta(d) * 2
-        };
-        Tile * next = GetTile(map, next_coord);
+//        RenderTilesWithDelay(map);
 
-        if ( next && next->type == TILE_DUNGEON_WALL ) {
-//        if ( IsInBounds(map, next_x, next_y) && next->type == TILE_WALL ) {
-            directions[num_open_directions].coord = next_coord;
-            directions[num_open_directions].direction = d;
-            num_open_directions++;
+        struct {
+            TileCoord coord;
+            Direction direction;
+        } directions[NUM_CARDINAL_DIRECTIONS];
+
+        int num_open_directions = 0;
+
+        // Make a list of the coordinates of possible directions.
+        for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
+            TileCoord next_coord = {
+                coord.x + XDelta(d) * 2,
+                coord.y + YDelta(d) * 2
+            };
+            Tile * next = GetTile(map, next_coord);
+
+            if ( next && next->type == TILE_DUNGEON_WALL ) {
+                directions[num_open_directions].coord = next_coord;
+                directions[num_open_directions].direction = d;
+                num_open_directions++;
+            }
         }
-    }
-
-    if ( num_open_directions == 0 ) {
-        return;
-    }
 
-    // Pick a random direction and open it up.
-    int i = Random(0, num_open_directions - 1);
-    Direction dir = directions[i].direction;
-    TileCoord next_coord = directions[i].coord;
-
-    // Clear the spot in between this and the next.
-    TileCoord inbetween_coord = {
-        next_coord.x - XDelta(dir),
-        next_coord.y - YDelta(dir)
-    };
-//    int inbetween_x = next.x - x_deltas[dir];
-//    int inbetween_y = next.y - y_deltas[dir];
-//    map[inbetween_y][inbetween_x] = CreateTile(TILE_FLOOR);
-//    ids[inbetween_y][inbetween_x] = current_id;
-    Tile * inbetween = GetTile(map, inbetween_coord);
-    *inbetween = CreateTile(TILE_DUNGEON_FLOOR);
-    TileID * inbetween_id = GetTileID(map, inbetween_coord);
-    *inbetween_id = current_id;
-
-//    RenderTilesWithDelay(map);
-
-    GenerateHallway_r(map, current_id, next_coord);
-}
+        if ( num_open_directions == 0 ) {
+            return;
+        }
 
+        // Pick a random direction and open it up.
+        int i = RngInt(rng, 0, num_open_directions - 1);
+        Direction dir = directions[i].direction;
+        TileCoord next_coord = directions[i].coord;
 
+        // Clear the spot in between this and the next.
+        TileCoord inbetween_coord = {
+            next_coord.x - XDelta(dir),
+            next_coord.y - YDelta(dir)
+        };
+        SetTile(map, inbetween_coord, TILE_DUNGEON_FLOOR);
+        TileID * inbetween_id = GetTileID(map, inbetween_coord);
+        *inbetween_id = current_id;
 
+//        RenderTilesWithDelay(map);
 
-/// Change all `from` IDs to `to`.
-void ChangeAllIDs(Map * map, TileID from, TileID to)
-{
-    for ( int i = 0; i < map->width * map->height; i++ ) {
-        if ( map->tile_ids[i] == from ) {
-            map->tile_ids[i] = to;
-        }
+        coord = next_coord;
     }
 }
 
 
 
 
-// A map tile that is adjacent to the main region and another different region.
+// A wall tile between two or more different regions.
 typedef struct {
     TileCoord coord;
-    int region; // the other region
-    bool valid;
+    TileID regions[NUM_CARDINAL_DIRECTIONS]; // The different adjacent regions.
+    int num_regions;
+    bool queued; // Has been added to the list of connectors to pick from.
 } connector_t;
 
 #define MAP_EDGE_ID (-2)
 #define MAP_WALL_ID (-1)
 
-int GetConnectors(Map * map, int main_region, connector_t * out)
+/// Get a list of all wall tiles that touch more than one region.
+int GetConnectors(Map * map, connector_t * out)
 {
     int num_connectors = 0;
 
@@ -195,28 +176,33 @@ int GetConnectors(Map * map, int main_region, connector_t * out)
                 continue;
             }
 
-            // Check all four adjacent tiles to see if (x, y) touches the main
-            // region and another region.
-            bool touches_main = false;
-            int other_region = -1;
+            connector_t * connector = &out[num_connectors];
+            connector->num_regions = 0;
 
             for ( int d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
                 TileCoord adjacent = AdjacentTileCoord(coord, d);
-
                 TileID id = *GetTileID(map, adjacent);
-                if ( id == main_region ) {
-                    touches_main = true;
+
+                if ( id < 0 ) {
+                    continue;
                 }
 
-                if ( id >= 0 && id != main_region ) {
-                    other_region = id;
+                bool is_new = true;
+                for ( int i = 0; i < connector->num_regions; i++ ) {
+                    if ( connector->regions[i] == id ) {
+                        is_new = false;
+                    }
+                }
+
+                if ( is_new ) {
+                    connector->regions[connector->num_regions++] = id;
                 }
             }
 
-            if ( touches_main && other_region != -1 ) {
+            if ( connector->num_regions > 1 ) {
                 // It's valid, add to list.
-                out[num_connectors].coord = coord;
-                out[num_connectors].region = other_region;
+                connector->coord = coord;
+                connector->queued = false;
                 num_connectors++;
             }
         }
@@ -226,6 +212,54 @@ int GetConnectors(Map * map, int main_region, connector_t * out)
 }
 
 
+/// Find the region `region` has been merged into. Regions form a disjoint-set
+/// forest: `parents` holds each region's parent, and roots are their own.
+static int FindRegion(int * parents, int region)
+{
+    while ( parents[region] != region ) {
+        parents[region] = parents[parents[region]]; // Path halving.
+        region = parents[region];
+    }
+
+    return region;
+}
+
+
+/// A region on the other side of a connector from `main_region`, or -1 if it
+/// only connects regions that have already been merged.
+static int OtherRegion(int * parents, const connector_t * connector, int main_region)
+{
+    for ( int i = 0; i < connector->num_regions; i++ ) {
+        int root = FindRegion(parents, connector->regions[i]);
+        if ( root != main_region ) {
+            return root;
+        }
+    }
+
+    return -1;
+}
+
+
+
+
+/// A floor tile with only one way in or out.
+static bool IsDeadEnd(Map * map, TileCoord coord)
+{
+    if ( GetTile(map, coord)->type != TILE_DUNGEON_FLOOR ) {
+        return false;
+    }
+
+    // Count the number of non-wall connections to this tile.
+    int connection_count = 0;
+    for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
+        const Tile * adj = GetAdjacentTile(map, coord, d);
+        if ( adj->type != TILE_DUNGEON_WALL ) {
+            connection_count++;
+        }
+    }
+
+    return connection_count == 1;
+}
 
 
 /// Get an array of coordinates of tiles that are dead ends.
@@ -236,24 +270,10 @@ int GetDeadEnds(Map * map, TileCoord * out)
     for ( int y = 1; y < map->height - 1; y++ ) {
         for ( int x = 1; x < map->width - 1; x++ ) {
             TileCoord coord = { x, y };
-            Tile * tile = GetTile(map, coord);
-
-            if ( tile->type == TILE_DUNGEON_FLOOR ) {
-
-                // Count the number of non-wall connections to this tile.
-                int connection_count = 0;
-                for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
-//                    tile_t * adj = GetTile(map, x + x_deltas[d], y + y_deltas[d]);
-                    Tile * adj = GetAdjacentTile(map, coord, d);
-                    if ( adj->type != TILE_DUNGEON_WALL ) {
-                        connection_count++;
-                    }
-                }
 
-                if ( connection_count == 1 ) { // It's a dead end.
-                    out[count] = coord;
-                    count++;
-                }
+            if ( IsDeadEnd(map, coord) ) {
+                out[count] = coord;
+                count++;
             }
         }
     }
@@ -307,19 +327,12 @@ TileCoord GetRoomCenter(SDL_Rect room)
 /// Get a list of tiles in a room that are unoccupied by an actor and not
 /// adjacent to a door.
 ///
-static void GetValidRoomTiles(const World * world, int room_num)
+static void GetValidRoomTiles(LevelGen * gen, int room_num)
 {
-    const Map * map = world->map;
-    bool * occupied = calloc(map->width * map->height, sizeof(*occupied));
-
-    FOR_EACH_ACTOR_CONST(actor, world->map->actor_list) {
-        int x = actor->tile.x;
-        int y = actor->tile.y;
-        occupied[y * map->width + x] = true;
-    }
+    const Map * map = gen->maps;
 
     SDL_Rect room = map->rooms[room_num];
-    BufferClear();
+    BufferClear(gen);
 
     TileCoord coord;
     for ( coord.y = room.y; coord.y < room.y + room.h; coord.y++ ) {
@@ -334,13 +347,13 @@ static void GetValidRoomTiles(const World * world, int room_num)
             }
 
             // Actor there already?
-            if ( occupied[coord.y * map->width + coord.x] ) {
+            if ( GetActorAtTile(&map->actor_list, coord) ) {
                 valid = false;
             }
 
             // Adjacent to door?
             for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
-                const Tile * t = GetAdjacentTile((Map *)map, coord, d);
+                const Tile * t = GetAdjacentTile(map, coord, d);
 
                 if ( t->type == TILE_DUNGEON_DOOR || t->type == TILE_GOLD_DOOR ) {
                     valid = false;
@@ -349,24 +362,22 @@ static void GetValidRoomTiles(const World * world, int room_num)
             }
 
             if ( valid ) {
-                BufferAppend(coord);
+                BufferAppend(gen, coord);
             }
         }
     }
-
-    free(occupied);
 }
 
 
-static void GetReachableTiles(Map * map, TileCoord start, int ignore_flags)
+static void GetReachableTiles(LevelGen * gen, TileCoord start, int ignore_flags)
 {
+    Map * map = gen->maps;
 //    CalculateDistances(map, start, ignore_flags);
 
-    BufferClear();
+    // With the distances above not calculated, every tile counts.
+    BufferClear(gen);
     for ( int i = 0; i < map->width * map->height; i++ ) {
-        if ( map->tiles[i].distance >= 0 ) {
-            BufferAppend(GetCoordinate(map, i));
-        }
+        BufferAppend(gen, GetCoordinate(map, i));
     }
 }
 
@@ -377,11 +388,10 @@ static void InitTiles(Map * map)
     for ( coord.y = 0; coord.y < map->height; coord.y++ ) {
         for ( coord.x = 0; coord.x < map->width; coord.x++ ) {
 
-            Tile * t = GetTile(map, coord);
             TileID * id = GetTileID(map, coord);
 
-            *t = CreateTile(TILE_DUNGEON_WALL);
-            t->id = -1;
+            SetTile(map, coord, TILE_DUNGEON_WALL);
+            SetRegionID(map, coord, -1);
 
             if (   coord.x == 0
                 || coord.x == map->width - 1
@@ -397,23 +407,26 @@ static void InitTiles(Map * map)
 }
 
 
-void SpawnRooms(Map * map, int * current_id)
+void SpawnRooms(LevelGen * gen, int * current_id)
 {
+    Map * map = gen->maps;
+    Rng * rng = &gen->rng;
+
     for ( int tries = 1; tries <= 50; tries++ ) {
-        int size = Random(1, 3) * 2 + 1; // 3 - 7
-        int rectangularity = Random(0, 1 + size / 2) * 2; // 0 - 8
+        int size = RngInt(rng, 1, 3) * 2 + 1; // 3 - 7
+        int rectangularity = RngInt(rng, 0, 1 + size / 2) * 2; // 0 - 8
 
         SDL_Rect rect;
         rect.w = size;
         rect.h = size;
-        if ( Chance(0.5f) ) {
+        if ( RngChance(rng, 0.5f) ) {
             rect.w += rectangularity;
         } else {
             rect.h += rectangularity;
         }
 
-        rect.x = Random(1, (map->width - rect.w) / 2) * 2 - 1;
-        rect.y = Random(1, (map->height - rect.h) / 2) * 2 - 1;
+        rect.x = RngInt(rng, 1, (map->width - rect.w) / 2) * 2 - 1;
+        rect.y = RngInt(rng, 1, (map->height - rect.h) / 2) * 2 - 1;
 
         // Check that this potential room does not overlap with any
         // existing rooms.
@@ -429,10 +442,9 @@ void SpawnRooms(Map * map, int * current_id)
         TileCoord coord;
         for ( coord.y = rect.y; coord.y < rect.y + rect.h; coord.y++ ) {
             for ( coord.x = rect.x; coord.x < rect.x + rect.w; coord.x++ ) {
-                Tile * tile = GetTile(map, coord);
-                *tile = CreateTile(TILE_DUNGEON_FLOOR);
+                SetTile(map, coord, TILE_DUNGEON_FLOOR);
 //                tile->flags |= FLAG(TILE_ROOM);
-                tile->id = map->num_rooms;
+                SetRegionID(map, coord, map->num_rooms);
                 *GetTileID(map, coord) = *current_id;
             }
         }
@@ -450,10 +462,12 @@ void SpawnRooms(Map * map, int * current_id)
 }
 
 
-void GenerateHallways(Map * map, int * current_id)
+void GenerateHallways(LevelGen * gen, int * current_id)
 {
+    Map * map = gen->maps;
+
     do {
-        BufferClear();
+        BufferClear(gen);
 
         // Check all odd positions and make a list of viable spots at
         // which to begin a hallway.
@@ -461,64 +475,175 @@ void GenerateHallways(Map * map, int * current_id)
         for ( coord.y = 1; coord.y <= map->height - 2; coord.y += 2 ) {
             for ( coord.x = 1; coord.x <= map->width - 2; coord.x += 2 ) {
                 if ( GetTile(map, coord)->type == TILE_DUNGEON_WALL ) {
-                    BufferAppend(coord);
+                    BufferAppend(gen, coord);
                 }
             }
         }
 
-        if ( _count > 0 ) {
+        if ( gen->num_coords > 0 ) {
             // There are still spots at which to start a hallway. Select
             // a random one and begin carving it out.
-            int i = Random(0, _count - 1);
-            GenerateHallway_r(map, *current_id, _buffer[i]);
+            int i = RandomIndex(gen);
+            GenerateHallway(map, &gen->rng, *current_id, gen->coords[i]);
             (*current_id)++;
         }
-    } while ( _count > 0 );
+    } while ( gen->num_coords > 0 );
 }
 
 
-int ConnectRegions(Map * map, TileCoord * potential_door_locations, int num_regions)
+int ConnectRegions(LevelGen * gen, TileCoord * potential_door_locations, int num_regions)
 {
+    Map * map = gen->maps;
+
     // Pick a random region to start.
-    int main_region = Random(0, num_regions - 1);
+    int main_region = RngInt(&gen->rng, 0, num_regions - 1);
+
+    int map_size = map->width * map->height;
+    connector_t * connectors = calloc(map_size, sizeof(*connectors));
+    int num_connectors = GetConnectors(map, connectors);
+
+    // Make a list of the connectors touching each region: region r's are
+    // region_connectors[region_starts[r]] up to region_starts[r + 1].
+    int * region_starts = calloc(num_regions + 1, sizeof(*region_starts));
+    int * region_connectors = calloc(num_connectors * NUM_CARDINAL_DIRECTIONS,
+                                     sizeof(*region_connectors));
+    int * parents = calloc(num_regions, sizeof(*parents));
+    int * queue = calloc(num_connectors, sizeof(*queue));
+    if ( !region_starts || !region_connectors || !parents || !queue ) {
+        Error("Could not allocate region connection lists");
+    }
 
-    // While there are still connectors adjacent to the main region,
-    connector_t * connectors = calloc(map->width * map->height, sizeof(*connectors));
-    int num_connectors = 0;
+    for ( int i = 0; i < num_connectors; i++ ) {
+        for ( int j = 0; j < connectors[i].num_regions; j++ ) {
+            region_starts[connectors[i].regions[j] + 1]++;
+        }
+    }
+
+    for ( int r = 0; r < num_regions; r++ ) {
+        region_starts[r + 1] += region_starts[r];
+        parents[r] = r;
+    }
+
+    int * region_counts = calloc(num_regions, sizeof(*region_counts));
+    for ( int i = 0; i < num_connectors; i++ ) {
+        for ( int j = 0; j < connectors[i].num_regions; j++ ) {
+            int r = connectors[i].regions[j];
+            region_connectors[region_starts[r] + region_counts[r]++] = i;
+        }
+    }
+    free(region_counts);
+
+    // The connectors that may join the main region to another. Those that
+    // turn out to only touch merged regions are dropped when picked.
+    int queue_count = 0;
+    int region = main_region;
     int num_potential_door_locations = 0;
-    while ( (num_connectors = GetConnectors(map, main_region, connectors)) ) {
+
+    while ( true ) {
+        // Queue up the connectors of the region just merged.
+        for ( int i = region_starts[region]; i < region_starts[region + 1]; i++ ) {
+            connector_t * connector = &connectors[region_connectors[i]];
+            if ( !connector->queued ) {
+                connector->queued = true;
+                queue[queue_count++] = region_connectors[i];
+            }
+        }
 
         // Pick a random connector, open it up, and merge the other region with
         // the main.
-        connector_t connector = connectors[Random(0, num_connectors - 1)];
-
-        Tile * tile = GetTile(map, connector.coord);
-        *tile = CreateTile(TILE_DUNGEON_FLOOR);
+        region = -1;
+        while ( region == -1 && queue_count > 0 ) {
+            int i = RngInt(&gen->rng, 0, queue_count - 1);
+            connector_t * connector = &connectors[queue[i]];
+            region = OtherRegion(parents, connector, main_region);
+
+            if ( region == -1 ) {
+                queue[i] = queue[--queue_count];
+            } else {
+                SetTile(map, connector->coord, TILE_DUNGEON_FLOOR);
+                potential_door_locations[num_potential_door_locations++] = connector->coord;
+                parents[region] = main_region;
+//                RenderTilesWithDelay(map);
+            }
+        }
 
-        potential_door_locations[num_potential_door_locations++] = connector.coord;
-        ChangeAllIDs(map, connector.region, main_region);
+        if ( region == -1 ) {
+            break; // Nothing left to connect.
+        }
+    }
 
-//        RenderTilesWithDelay(map);
+    // Leave every tile labeled with the region it ended up in.
+    TileCoord coord;
+    for ( coord.y = 0; coord.y < map->height; coord.y++ ) {
+        for ( coord.x = 0; coord.x < map->width; coord.x++ ) {
+            TileID * id = GetTileID(map, coord);
+            if ( *id >= 0 ) {
+                *id = FindRegion(parents, *id);
+            }
+        }
     }
 
+    free(queue);
+    free(parents);
+    free(region_connectors);
+    free(region_starts);
     free(connectors);
 
     return num_potential_door_locations;
 }
 
 
+///
+/// Fill in dead ends until there are none left. All the current dead ends are
+/// filled at once, and only their neighbors can become the next ones.
+///
 void EliminateDeadEnds(Map * map)
 {
-    int num_deadends = 0;
-    TileCoord * deadends = calloc(map->width * map->height, sizeof(*deadends));
+    int map_size = map->width * map->height;
+    TileCoord * deadends = calloc(map_size, sizeof(*deadends));
+    TileCoord * next = calloc(map_size, sizeof(*next));
+    int * checked = calloc(map_size, sizeof(*checked)); // Round last checked.
+    if ( !deadends || !next || !checked ) {
+        Error("Could not allocate dead end lists");
+    }
+
+    int num_deadends = GetDeadEnds(map, deadends);
 
-    while ( (num_deadends = GetDeadEnds(map, deadends)) ) {
+    for ( int round = 1; num_deadends > 0; round++ ) {
         for ( int i = 0; i < num_deadends; i++ ) {
-            *GetTile(map, deadends[i]) = CreateTile(TILE_DUNGEON_WALL);
+            SetTile(map, deadends[i], TILE_DUNGEON_WALL);
 //            RenderTilesWithDelay(map);
         }
+
+        int num_next = 0;
+        for ( int i = 0; i < num_deadends; i++ ) {
+            for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
+                TileCoord coord = AdjacentTileCoord(deadends[i], d);
+
+                if (   coord.x < 1 || coord.x > map->width - 2
+                    || coord.y < 1 || coord.y > map->height - 2 )
+                {
+                    continue;
+                }
+
+                int index = coord.y * map->width + coord.x;
+                if ( checked[index] != round ) {
+                    checked[index] = round;
+                    if ( IsDeadEnd(map, coord) ) {
+                        next[num_next++] = coord;
+                    }
+                }
+            }
+        }
+
+        TileCoord * temp = deadends;
+        deadends = next;
+        next = temp;
+        num_deadends = num_next;
     }
 
+    free(checked);
+    free(next);
     free(deadends);
 }
 
@@ -528,7 +653,7 @@ void SpawnDoors(Map * map, TileCoord * potentials, int array_len)
     for ( int i = 0; i < array_len; i++ ) {
         Tile * tile = GetTile(map, potentials[i]);
 
-        Tile * adjacents[NUM_CARDINAL_DIRECTIONS];
+        const Tile * adjacents[NUM_CARDINAL_DIRECTIONS];
         for ( int d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
             adjacents[d] = GetAdjacentTile(map, potentials[i], d);
         }
@@ -538,7 +663,7 @@ void SpawnDoors(Map * map, TileCoord * potentials, int array_len)
             || (adjacents[WEST]->type == TILE_DUNGEON_FLOOR && adjacents[EAST]->type == TILE_DUNGEON_FLOOR);
 
         if ( tile->type == TILE_DUNGEON_FLOOR && is_valid ) {
-            *tile = CreateTile(TILE_DUNGEON_DOOR);
+            SetTile(map, potentials[i], TILE_DUNGEON_DOOR);
 //            RenderTilesWithDelay(map);
         }
     }
@@ -573,47 +698,46 @@ void SpawnDoors(Map * map, TileCoord * potentials, int array_len)
 }
 
 
-void SpawnPlayerAndStartTile(Game * game)
+void SpawnPlayerAndStartTile(LevelGen * gen)
 {
-    TileCoord pt = GetRoomCenter(game->world.map->rooms[0]);
+    TileCoord pt = GetRoomCenter(gen->maps->rooms[0]);
     printf("player start: %d, %d\n", pt.x, pt.y);
 
-    SpawnActor(game, ACTOR_PLAYER, pt);
-    *GetTile(game->world.map, pt) = CreateTile(TILE_START);
+    SpawnActorInList(gen->game, &gen->maps->actor_list, ACTOR_PLAYER, pt);
+    SetTile(gen->maps, pt, TILE_START);
 }
 
 
-void SpawnGoldKey(Game * game)
+void SpawnGoldKey(LevelGen * gen)
 {
-    Actor * player = FindActor(&game->world.map->actor_list, ACTOR_PLAYER);
-    Map * map = game->world.map;
+    Map * map = gen->maps;
+    Actor * player = FindActor(&map->actor_list, ACTOR_PLAYER);
 
-    GetReachableTiles(map, player->tile, FLAG(TILE_DUNGEON_DOOR));
+    GetReachableTiles(gen, player->tile, FLAG(TILE_DUNGEON_DOOR));
 
     // Remove any points that are not in a room (-1) or are in the start room (0)
-    for ( int i = _count - 1; i >= 0; i-- ) {
-        Tile * tile = GetTile(map, _buffer[i]);
-        if ( tile->id <= 0 ) {
-            BufferRemove(i);
+    for ( int i = gen->num_coords - 1; i >= 0; i-- ) {
+        TileCoord coord = gen->coords[i];
+        if ( GetRegionID(map, coord) <= 0 ) {
+            BufferRemove(gen, i);
         }
     }
 
     TileCoord gold_key_tile_coord;
 
-    if ( _count == 0 ) {
+    if ( gen->num_coords == 0 ) {
         puts("Could not find spot for gold key!");
         // The start room's only door is to the exit room.
         // For now, just spawn the key in the start room (lame).
-        GetValidRoomTiles(&game->world, 0);
+        GetValidRoomTiles(gen, 0);
     }
 
-    gold_key_tile_coord = _buffer[Random(0, _count - 1)];
+    gold_key_tile_coord = gen->coords[RandomIndex(gen)];
 
-    SpawnActor(game, ACTOR_GOLD_KEY, gold_key_tile_coord);
+    SpawnActorInList(gen->game, &map->actor_list, ACTOR_GOLD_KEY, gold_key_tile_coord);
 
     // Save the gold key's room number.
-    Tile * gold_key_tile = GetTile(map, gold_key_tile_coord);
-    map->gold_key_room_num = gold_key_tile->id;
+    map->gold_key_room_num = GetRegionID(map, gold_key_tile_coord);
 }
 
 
@@ -622,9 +746,9 @@ void SpawnGoldKey(Game * game)
 /// is not adjacent to a door. If none are found, place the exit in the center
 /// of the room.
 ///
-void SpawnExit(Game * game)
+void SpawnExit(LevelGen * gen)
 {
-    Map * map = game->world.map;
+    Map * map = gen->maps;
 
     int exit_room = map->num_rooms - 1;
 
@@ -650,18 +774,18 @@ void SpawnExit(Game * game)
     if ( num_usable == 0 ) {
         exit_coord = GetRoomCenter(map->rooms[exit_room]);
     } else {
-        int index = Random(0, num_usable - 1);
+        int index = RngInt(&gen->rng, 0, num_usable - 1);
         exit_coord = corners[usable_indices[index]];
     }
 
-    *GetTile(map, exit_coord) = CreateTile(TILE_DUNGEON_EXIT);
+    SetTile(map, exit_coord, TILE_DUNGEON_EXIT);
 
     // Spawn blocks adjacent to exit stairs.
     for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
-        Tile * adjacent = GetAdjacentTile(map, exit_coord, d);
+        const Tile * adjacent = GetAdjacentTile(map, exit_coord, d);
         TileCoord coord = AdjacentTileCoord(exit_coord, d);
         if ( adjacent->type == TILE_DUNGEON_FLOOR ) {
-            SpawnActor(game, ACTOR_PILLAR, coord);
+            SpawnActorInList(gen->game, &map->actor_list, ACTOR_PILLAR, coord);
         }
     }
 
@@ -677,21 +801,21 @@ void SpawnExit(Game * game)
     // TODO: do this not dumb.
     for ( int y = rect.y; y <= rect.y + rect.h; y++ ) {
         for ( int x = rect.x; x <= rect.x + rect.w; x++ ) {
-            Tile * tile = GetTile(map, ((TileCoord){ x, y }));
-            if ( tile->type == TILE_DUNGEON_DOOR ) {
-                *tile = CreateTile(TILE_GOLD_DOOR);
+            TileCoord coord = { x, y };
+            if ( GetTile(map, coord)->type == TILE_DUNGEON_DOOR ) {
+                SetTile(map, coord, TILE_GOLD_DOOR);
             }
         }
     }
 }
 
 
-void SpawnActorAtRandomPointInBuffer(Game * game, ActorType type)
+void SpawnActorAtRandomPointInBuffer(LevelGen * gen, ActorType type)
 {
-    if ( _count > 0 ) {
-        int i = Random(0, _count - 1);
-        SpawnActor(game, type, _buffer[i]);
-        BufferRemove(i);
+    if ( gen->num_coords > 0 ) {
+        int i = RandomIndex(gen);
+        SpawnActorInList(gen->game, &gen->maps->actor_list, type, gen->coords[i]);
+        BufferRemove(gen, i);
     } else {
         printf("no room to spawn %s!", actor_info_list[type].name);
     }
@@ -699,17 +823,16 @@ void SpawnActorAtRandomPointInBuffer(Game * game, ActorType type)
 
 
 // https://www.tomstephensondeveloper.co.uk/post/creating-simple-procedural-dungeon-generation
-void GenerateDungeon(Game * game, int width, int height)
+void GenerateDungeon(LevelGen * gen)
 {
+    int width = gen->width;
+    int height = gen->height;
+
     if ( width % 2 == 0 || height % 2 == 0 ) {
         Error("Dugeon width and height must be odd");
     }
 
-    game->world.area = AREA_DUNGEON;
-
-    Map * map = game->world.map;
-    map->width = width;
-    map->height = height;
+    Map * map = gen->maps;
 
     //
     // Init tiles.
@@ -721,79 +844,70 @@ void GenerateDungeon(Game * game, int width, int height)
 
     int map_size = width * height;
 
-    _count = 0;
-    _buffer = calloc(map_size, sizeof(*_buffer));
-    if ( _buffer == NULL ) {
-        Error("Could not allocate tile coord buffer");
-    }
-
-    if ( map->tiles ) {
-        free(map->tiles);
-    }
-
-    map->tiles = calloc(map_size, sizeof(*map->tiles));
-    if ( map->tiles == NULL ) {
-        Error("Could not allocate map tiles array");
-    }
-
-    if ( map->tile_ids ) {
-        free(map->tile_ids);
-    }
-
-    map->tile_ids = calloc(map_size, sizeof(*map->tile_ids));
-    if ( map->tile_ids == NULL ) {
-        Error("Could not allocate map tile id array");
-    }
-
+    ResizeMap(map, width, height);
     InitTiles(map);
 
     map->num_rooms = 0;
     int current_id = 0; // Regions
 
-    SpawnRooms(map, &current_id);
+    BeginGenPhase(gen, GEN_SPAWN_ROOMS);
+    SpawnRooms(gen, &current_id);
+    EndGenPhase(gen, GEN_SPAWN_ROOMS);
 
-    GenerateHallways(map, &current_id);
+    BeginGenPhase(gen, GEN_HALLWAYS);
+    GenerateHallways(gen, &current_id);
+    EndGenPhase(gen, GEN_HALLWAYS);
 
     const int num_regions = current_id;
 
     TileCoord * potential_door_locations = calloc(map_size, sizeof(*potential_door_locations));
-    int num_potential_door_locations = ConnectRegions(map, potential_door_locations, num_regions);
+
+    BeginGenPhase(gen, GEN_CONNECT_REGIONS);
+    int num_potential_door_locations = ConnectRegions(gen,
+                                                      potential_door_locations,
+                                                      num_regions);
+    EndGenPhase(gen, GEN_CONNECT_REGIONS);
+
+    BeginGenPhase(gen, GEN_DEAD_ENDS);
     EliminateDeadEnds(map);
+    EndGenPhase(gen, GEN_DEAD_ENDS);
+
+    BeginGenPhase(gen, GEN_DOORS);
     SpawnDoors(map, potential_door_locations, num_potential_door_locations);
+    EndGenPhase(gen, GEN_DOORS);
+
     free(potential_door_locations);
-    SpawnExit(game);
+    SpawnExit(gen);
 
     // Spawn actors.
 
-    SpawnPlayerAndStartTile(game);
+    SpawnPlayerAndStartTile(gen);
 
 
     // Pick a room that is not the start or end room for the button.
-    int button_room_num = Random(1, map->num_rooms - 2);
+    int button_room_num = RngInt(&gen->rng, 1, map->num_rooms - 2);
 
     // Get Reachable Tiles:
     // - ignoring doors, gold doors (but not exit pillars)
 
-    SpawnGoldKey(game);
+    SpawnGoldKey(gen);
 
     // In each room...
     for ( int i = 0; i < map->num_rooms; i++ ) {
-        GetValidRoomTiles(&game->world, i);
+        GetValidRoomTiles(gen, i);
         float chance = 1.0f;
         int area = map->rooms[i].w * map->rooms[i].h;
         int max_monsters = area / 4;
 
         if ( button_room_num == i ) {
-//            SpawnActor(game, ACTOR_BUTTON_UP, BufferRandom());
-            int index = RandomIndex();
-            Tile * tile = GetTile(map, _buffer[index]);
-            *tile = CreateTile(TILE_BUTTON_NOT_PRESSED);
-            BufferRemove(index);
+            int index = RandomIndex(gen);
+            SetTile(map, gen->coords[index], TILE_BUTTON_NOT_PRESSED);
+            BufferRemove(gen, index);
         }
 
         for ( int j = 0; j < 4; j++ ) {
-            if ( Chance(chance) ) {
-                SpawnActorAtRandomPointInBuffer(game, ACTOR_BLOB);
+            if ( RngChance(&gen->rng, chance) ) {
+                SpawnActorAtRandomPointInBuffer(gen, ACTOR_BLOB);
                 --max_monsters;
             }
 
@@ -806,13 +920,9 @@ void GenerateDungeon(Game * game, int width, int height)
 
         int max_vases = area / 9;
         for ( int j = 0; j < max_vases; j++ ) {
-            SpawnActorAtRandomPointInBuffer(game, ACTOR_VASE);
+            SpawnActorAtRandomPointInBuffer(gen, ACTOR_VASE);
         }
 
-        SpawnActorAtRandomPointInBuffer(game, ACTOR_CLOSED_CHEST);
-    }
-
-    if ( show_map_gen ) {
-        DebugWaitForKeyPress();
+        SpawnActorAtRandomPointInBuffer(gen, ACTOR_CLOSED_CHEST);
     }
 }
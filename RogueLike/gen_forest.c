@@ -10,61 +10,49 @@
 #include "mathlib.h"
 #include "array.h"
 #include "genlib.h"
+#include "noise.h"
 
-#define FOREST_MAX_SIZE 256
 
 struct region {
-    u16 region;
-    u16 area;
-} regions[FOREST_MAX_SIZE * FOREST_MAX_SIZE];
+    int region;
+    int area;
+};
 
-//int region_areas[FOREST_MAX_SIZE * FOREST_MAX_SIZE];
+// The forest works on the level generator's list of coordinates: usually the
+// tiles of one region.
 
-static int num_coords;
-static TileCoord coords[FOREST_MAX_SIZE * FOREST_MAX_SIZE]; // TODO: Use Array
-
-static void GetTilesInRegion(const Map * map, int region)
+static void GetTilesInRegion(LevelGen * gen, const Map * map, int region)
 {
-    num_coords = 0;
+    gen->num_coords = 0;
     TileCoord coord;
     for ( coord.y = 0; coord.y < map->height; coord.y++ ) {
         for ( coord.x = 0; coord.x < map->width; coord.x++ ) {
-            const Tile * tile = GetTile(map, coord);
-            if ( tile->id == region ) {
-                coords[num_coords++] = coord;
+            if ( GetRegionID(map, coord) == region ) {
+                AddGenCoord(gen, coord);
             }
         }
     }
 }
 
 
-static void AddTile(TileCoord coord)
-{
-    coords[num_coords++] = coord;
-}
-
-
-static void RemoveTile(int index)
+static void RemoveTile(LevelGen * gen, int index)
 {
-    coords[index] = coords[--num_coords];
+    gen->coords[index] = gen->coords[--gen->num_coords];
 }
 
 
-//static int RandomIndex(void)
-//{
-//    return Random(0, num_coords - 1);
-//}
-
-
-static Actor * SpawnActorAtRandomLocation(Game * game,
+static Actor * SpawnActorAtRandomLocation(LevelGen * gen,
                                           ActorType type,
                                           int min_index,
                                           int max_index)
 {
-    if ( num_coords != 0 ) {
-        int index = Random(min_index, max_index);
-        Actor * actor = SpawnActor(game, type, coords[index]);
-        RemoveTile(index);
+    if ( gen->num_coords != 0 ) {
+        int index = RngInt(&gen->rng, min_index, max_index);
+        Actor * actor = SpawnActorInList(gen->game,
+                                         &gen->maps[0].actor_list,
+                                         type,
+                                         gen->coords[index]);
+        RemoveTile(gen, index);
         return actor;
     } else {
         printf("%s: not tiles left!\n", __func__);
@@ -73,53 +61,86 @@ static Actor * SpawnActorAtRandomLocation(Game * game,
 }
 
 
-static Tile * CreateTileAtRandomLocation(Map * map,
+static Tile * CreateTileAtRandomLocation(LevelGen * gen,
                                          TileType type,
                                          int min_index,
                                          int max_index,
                                          TileCoord * out)
 {
-    int index = Random(min_index, max_index);
-    TileCoord coord = coords[index];
+    Map * map = &gen->maps[0];
+    int index = RngInt(&gen->rng, min_index, max_index);
+    TileCoord coord = gen->coords[index];
 
     if ( out ) {
         *out = coord;
     }
 
-    Tile * tile = GetTile(map, coord);
-    *tile = CreateTile(type);
+    SetTile(map, coord, type);
     if ( area_info[AREA_FOREST].reveal_all ) {
-        tile->flags.revealed = true;
+        GetTileFlags(map, coord)->revealed = true;
     }
-    RemoveTile(index);
+    RemoveTile(gen, index);
 
-    return tile;
+    return GetTile(map, coord);
 }
 
 
+/// A flood fill's stack of coordinates, which grows with the region.
+typedef struct {
+    TileCoord * coords;
+    int capacity;
+} FillStack;
+
+
 /// Sort all connected ground tiles into regions and calculate their areas.
-static void FloodFillGroundTiles_r(Map * map, TileCoord coord, int region)
+static void FloodFillGroundTiles(Map * map,
+                                 TileCoord start,
+                                 int region,
+                                 struct region * regions,
+                                 FillStack * stack)
 {
-    Tile * tile = GetTile(map, coord);
-    if ( tile == NULL ) {
-        printf("NULL tile\n");
-        return;
-    }
+    regions[region].region = region;
+    SetRegionID(map, start, region);
+    regions[region].area++;
+
+    // Tiles are labeled as they're pushed, so each is pushed at most once.
+    int top = 0;
+    stack->coords[top++] = start;
+
+    while ( top > 0 ) {
+        TileCoord coord = stack->coords[--top];
 
-    if ( tile->type == TILE_FOREST_GROUND && tile->id == -1 ) {
-        tile->id = region;
-//        region_areas[region]++;
-        regions[region].region = region;
-        regions[region].area++;
         for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
-            TileCoord adjacent_coord = AdjacentTileCoord(coord, d);
-            FloodFillGroundTiles_r(map, adjacent_coord, region);
+            TileCoord adjacent = AdjacentTileCoord(coord, d);
+            const Tile * tile = GetTile((const Map *)map, adjacent);
+            if ( tile == NULL ) {
+                continue;
+            }
+
+            if (   tile->type == TILE_FOREST_GROUND
+                && GetRegionID(map, adjacent) == -1 )
+            {
+                SetRegionID(map, adjacent, region);
+                regions[region].area++;
+
+                if ( top == stack->capacity ) {
+                    stack->capacity *= 2;
+                    stack->coords = realloc(stack->coords,
+                                            stack->capacity * sizeof(*stack->coords));
+                    if ( stack->coords == NULL ) {
+                        Error("could not allocate flood fill stack");
+                    }
+                }
+
+                stack->coords[top++] = adjacent;
+            }
         }
     }
 }
 
 
-static int GetTilesInFirstRegionSmallerThan(const Map * map,
+static int GetTilesInFirstRegionSmallerThan(LevelGen * gen,
+                                   const struct region * regions,
                                    int area,
                                    int backup_index,
                                    int num_regions)
@@ -127,7 +148,7 @@ static int GetTilesInFirstRegionSmallerThan(const Map * map,
     int result_area = -1;
     for ( int i = 0; i < num_regions; i++ ) {
         if ( regions[i].area < area ) {
-            GetTilesInRegion(map, regions[i].region);
+            GetTilesInRegion(gen, gen->maps, regions[i].region);
             result_area = regions[i].area;
             break;
         }
@@ -135,7 +156,7 @@ static int GetTilesInFirstRegionSmallerThan(const Map * map,
 
     if ( result_area == -1 ) {
         // If a region wasn't found, use the backup.
-        GetTilesInRegion(map, regions[backup_index].region);
+        GetTilesInRegion(gen, gen->maps, regions[backup_index].region);
         result_area = regions[backup_index].area;
     }
 
@@ -143,60 +164,289 @@ static int GetTilesInFirstRegionSmallerThan(const Map * map,
 }
 
 
-void CalculateTileDistancesFrom(Map * map, TileCoord coord)
+/// Set the distance of each of the level generator's coords from `coord`.
+void CalculateTileDistancesFrom(LevelGen * gen, TileCoord coord)
 {
-    for ( int i = 0; i < num_coords; i++ ) {
-        Tile * tile = GetTile(map, coords[i]);
-        tile->distance = TileDistance(coords[i], coord);
+    for ( int i = 0; i < gen->num_coords; i++ ) {
+        gen->distances[i] = TileDistance(gen->coords[i], coord);
     }
 }
 
 
-void SortCoordsByDistance(Map * map)
+/// Sort coords by distance, nearest first. Distances are small, so this is a
+/// counting sort, and it's stable: coords the same distance away stay in the
+/// order they were in.
+void SortCoordsByDistance(LevelGen * gen)
 {
-    // Sort coords by distance, farthest first.
+    TileCoord * coords = gen->coords;
+    int num_coords = gen->num_coords;
+
+    int max_distance = 0;
+    for ( int i = 0; i < num_coords; i++ ) {
+        max_distance = MAX(max_distance, gen->distances[i]);
+    }
+
+    int * starts = calloc(max_distance + 2, sizeof(*starts));
+    if ( starts == NULL ) {
+        Error("could not allocate distance counts");
+    }
+
     for ( int i = 0; i < num_coords; i++ ) {
-        for ( int j = i + 1; j < num_coords; j++ ) {
-            Tile * i_tile = GetTile(map, coords[i]);
-            Tile * j_tile = GetTile(map, coords[j]);
-
-            if ( j_tile->distance < i_tile->distance ) {
-                TileCoord temp = coords[i];
-                coords[i] = coords[j];
-                coords[j] = temp;
+        starts[gen->distances[i] + 1]++;
+    }
+
+    for ( int d = 1; d <= max_distance; d++ ) {
+        starts[d] += starts[d - 1];
+    }
+
+    for ( int i = 0; i < num_coords; i++ ) {
+        gen->sorted_coords[starts[gen->distances[i]]++] = coords[i];
+    }
+
+    SDL_memcpy(coords, gen->sorted_coords, num_coords * sizeof(*coords));
+    free(starts);
+}
+
+
+/// Largest area first, and regions of equal area in the order they were found.
+static int CompareRegions(const void * a, const void * b)
+{
+    const struct region * region1 = a;
+    const struct region * region2 = b;
+
+    if ( region1->area != region2->area ) {
+        return region2->area - region1->area;
+    }
+
+    return region1->region - region2->region;
+}
+
+
+#define NOISE_OCTAVES 6
+#define NOISE_BAND_ROWS (MAP_CHUNK_SIZE * 4) // Rows of noise filled at a time.
+
+// Noise streams, apart from the level generator's own.
+#define TERRAIN_NOISE_STREAM 0x7E44A1
+#define WATER_NOISE_STREAM 0x3A7E4
+
+typedef struct {
+    const Noise * terrain;
+    const Noise * water;
+    NoiseParams params;
+    int width;
+    int radius;
+    int first_row; // This job does every `row_step`th row from here...
+    int row_step;
+    int end_row; // ...up to here.
+    bool scalar;
+
+    // Noise for the band of rows from `band_start`.
+    int band_start;
+    float * terrain_noise;
+    float * water_noise;
+
+    // For jobs done on a worker thread.
+    SDL_sem * start; // Posted when the job has a new band, or should quit.
+    SDL_sem * done; // Posted by the worker when the band is filled.
+    bool quit;
+} NoiseJob;
+
+// Threads that stay up for a whole forest's noise fill, each doing one job's
+// rows of every band.
+typedef struct {
+    int num_jobs;
+    NoiseJob jobs[MAX_NOISE_THREADS];
+    SDL_Thread * threads[MAX_NOISE_THREADS]; // NULL for jobs done on this thread.
+    SDL_sem * done;
+} NoiseWorkers;
+
+
+/// Fill in the noise for the tiles within the level radius on the job's rows.
+static int FillNoiseRows(void * data)
+{
+    ProfileScope scope = PROFILE_BEGIN("FillNoiseRows");
+    const NoiseJob * job = data;
+    int center = job->width / 2;
+
+    for ( int y = job->first_row; y < job->end_row; y += job->row_step ) {
+        // The circle's span on this row, by the same test GenerateForest uses.
+        int x0 = 0;
+        while ( x0 < job->width && DISTANCE(x0, y, center, center) > job->radius ) {
+            x0++;
+        }
+
+        int x1 = job->width - 1;
+        while ( x1 >= x0 && DISTANCE(x1, y, center, center) > job->radius ) {
+            x1--;
+        }
+
+        int count = x1 - x0 + 1;
+        int index = (y - job->band_start) * job->width + x0;
+        float * terrain = &job->terrain_noise[index];
+        float * water = &job->water_noise[index];
+
+        if ( job->scalar ) {
+            for ( int i = 0; i < count; i++ ) {
+                terrain[i] = FractalNoise(job->terrain, &job->params, x0 + i, y);
+                water[i] = FractalNoise(job->water, &job->params, x0 + i, y);
             }
+        } else if ( count > 0 ) {
+            FractalNoiseRow(job->terrain, &job->params, y, x0, count, terrain);
+            FractalNoiseRow(job->water, &job->params, y, x0, count, water);
         }
     }
+
+    PROFILE_END(scope);
+    return 0;
 }
 
+
+static int NoiseWorker(void * data)
+{
+    NoiseJob * job = data;
+
+    while ( true ) {
+        SDL_SemWait(job->start);
+        if ( job->quit ) {
+            break;
+        }
+
+        FillNoiseRows(job);
+        SDL_SemPost(job->done);
+    }
+
+    return 0;
+}
+
+
+/// Set up the jobs for filling the terrain and water noise for tiles within
+/// `radius` of the center, and start their threads. Rows are interleaved
+/// across jobs so each gets a similar share of the circle.
+static void StartNoiseWorkers(NoiseWorkers * workers,
+                              const LevelGen * gen,
+                              const Noise * terrain,
+                              const Noise * water,
+                              int radius,
+                              float * terrain_noise,
+                              float * water_noise)
+{
+    workers->num_jobs = 1;
+    if ( !gen->scalar_noise ) {
+        workers->num_jobs = MIN(SDL_GetCPUCount(), MAX_NOISE_THREADS);
+    }
+
+    workers->done = SDL_CreateSemaphore(0);
+
+    for ( int i = 0; i < workers->num_jobs; i++ ) {
+        NoiseJob * job = &workers->jobs[i];
+        *job = (NoiseJob){
+            .terrain = terrain,
+            .water = water,
+            .params = {
+                .frequency = gen->forest_freq,
+                .octaves = NOISE_OCTAVES,
+                .amplitude = gen->forest_amp,
+                .persistence = gen->forest_pers,
+                .lacunarity = gen->forest_lec,
+            },
+            .width = gen->width,
+            .radius = radius,
+            .row_step = workers->num_jobs,
+            .scalar = gen->scalar_noise,
+            .terrain_noise = terrain_noise,
+            .water_noise = water_noise,
+            .done = workers->done,
+        };
+
+        // This thread does the first job, and any whose thread didn't start.
+        workers->threads[i] = NULL;
+        if ( i == 0 || workers->done == NULL ) {
+            continue;
+        }
+
+        job->start = SDL_CreateSemaphore(0);
+        if ( job->start ) {
+            workers->threads[i] = SDL_CreateThread(NoiseWorker,
+                                                   "forest noise",
+                                                   job);
+            if ( workers->threads[i] == NULL ) {
+                SDL_DestroySemaphore(job->start);
+            }
+        }
+    }
+}
+
+
+/// Fill the noise for rows `band_start` up to `band_end`.
+static void FillForestNoise(NoiseWorkers * workers, int band_start, int band_end)
+{
+    for ( int i = 0; i < workers->num_jobs; i++ ) {
+        NoiseJob * job = &workers->jobs[i];
+        job->first_row = band_start + i;
+        job->end_row = band_end;
+        job->band_start = band_start;
+
+        if ( workers->threads[i] ) {
+            SDL_SemPost(job->start);
+        }
+    }
+
+    for ( int i = 0; i < workers->num_jobs; i++ ) {
+        if ( workers->threads[i] == NULL ) {
+            FillNoiseRows(&workers->jobs[i]);
+        }
+    }
+
+    for ( int i = 0; i < workers->num_jobs; i++ ) {
+        if ( workers->threads[i] ) {
+            SDL_SemWait(workers->done);
+        }
+    }
+}
+
+
+static void StopNoiseWorkers(NoiseWorkers * workers)
+{
+    for ( int i = 0; i < workers->num_jobs; i++ ) {
+        if ( workers->threads[i] ) {
+            workers->jobs[i].quit = true;
+            SDL_SemPost(workers->jobs[i].start);
+            SDL_WaitThread(workers->threads[i], NULL);
+            SDL_DestroySemaphore(workers->jobs[i].start);
+        }
+    }
+
+    if ( workers->done ) {
+        SDL_DestroySemaphore(workers->done);
+    }
+}
+
+
 /// Generate a forest level. The map is square.
 /// - parameter width: The full width of the map.
 /// - radius: The radius of the centered, circular region in the center of the
 ///     map inside which clearings are generated.
-void GenerateForest(Game * game, int seed, int width)
+void GenerateForest(LevelGen * gen)
 {
-    if ( width > FOREST_MAX_SIZE ) {
-        Error("forest size must be <= %d\n", FOREST_MAX_SIZE);
-    }
+    int seed = gen->seed;
+    int width = gen->width;
 
     printf("\n- Generate Forest- \n");
     printf("(<>) seed: %d\n", seed);
-    printf("low: %0.2f\n", game->forest_low);
-    printf("high: %0.2f\n", game->forest_high);
-    printf("(u) freq: %.02f\n", game->forest_freq);
-    printf("(i) amp: %.01f\n", game->forest_amp);
-    printf("(o) pers: %.01f\n", game->forest_pers);
-    printf("(p) lac: %.01f\n", game->forest_lec);
+    printf("low: %0.2f\n", gen->forest_low);
+    printf("high: %0.2f\n", gen->forest_high);
+    printf("(u) freq: %.02f\n", gen->forest_freq);
+    printf("(i) amp: %.01f\n", gen->forest_amp);
+    printf("(o) pers: %.01f\n", gen->forest_pers);
+    printf("(p) lac: %.01f\n", gen->forest_lec);
 
-    World * world = &game->world;
-    world->area = AREA_FOREST;
-    world->map = &world->maps[0];
+    Map * map = &gen->maps[0];
 
-//    SDL_memset(region_areas, 0, sizeof(region_areas));
-    SDL_memset(regions, 0, sizeof(regions));
-
-    AllocateMapTiles(world->map, width, width, TILE_TREE);
-    RemoveAllActors(&world->map->actor_list);
+    // Trees with no region. Only chunks with something else in them are
+    // allocated.
+    AllocateMapTiles(map, width, width, TILE_TREE);
+    SetMapFill(map, -1, area_info[AREA_FOREST].reveal_all);
+    RemoveAllActors(&map->actor_list);
 
     int map_size = width * width;
     printf("Forest size: %d (%d x %d)\n", map_size, width, width);
@@ -204,83 +454,128 @@ void GenerateForest(Game * game, int seed, int width)
     int radius = (width / 2) * 0.75;
     printf("Outside radius: %d tiles\n", width / 2 - radius);
 
-    RandomizeNoise(seed);
-    num_coords = 0;
+    gen->num_coords = 0;
+
+    BeginGenPhase(gen, GEN_NOISE_FILL);
+
+    Noise terrain;
+    Noise water;
+    SeedNoise(&terrain, (u32)seed, TERRAIN_NOISE_STREAM);
+    SeedNoise(&water, (u32)seed, WATER_NOISE_STREAM);
+
+    // Noise is made a band of rows at a time, so large forests don't need a
+    // whole plane of it.
+    int band_size = NOISE_BAND_ROWS * width;
+    float * terrain_noise = malloc(band_size * sizeof(*terrain_noise));
+    float * water_noise_plane = malloc(band_size * sizeof(*water_noise_plane));
+    if ( terrain_noise == NULL || water_noise_plane == NULL ) {
+        Error("could not allocate forest noise");
+    }
+
+    NoiseWorkers workers;
+    StartNoiseWorkers(&workers,
+                      gen,
+                      &terrain,
+                      &water,
+                      radius,
+                      terrain_noise,
+                      water_noise_plane);
 
     // Generate forest (tree), ground, and water terrain.
     // Add all ground tile coords to the array.
     for ( int y = 0; y < width; y++ ) {
+        int band_row = y % NOISE_BAND_ROWS;
+        if ( band_row == 0 ) {
+            int band_end = MIN(y + NOISE_BAND_ROWS, width);
+            FillForestNoise(&workers, y, band_end);
+        }
+
         for ( int x = 0; x < width; x++ ) {
             TileCoord coord = { x, y };
+            int band_index = band_row * width + x;
 
             // Distance from this tile to center of map.
             float distance = DISTANCE(x, y, width / 2, width / 2);
 
-            float noise;
-            float water_noise;
+            float noise = -1.0f; // Outside level radius.
+            float water_noise = -1.0f;
 
             if ( distance <= radius ) {
                 float gradient = MAP(distance, 0.0f, (float)radius, 0.0f, 1.0f);
-                float freq = game->forest_freq;
-                float amp = game->forest_amp;
-                float pers = game->forest_pers;
-                float lac = game->forest_lec;
-                noise = Noise2(x, y, 1.0f, freq, 6, amp, pers, lac) - gradient;
-
-                water_noise
-                = Noise2(x, y, 8241931.0f, freq, 6, amp, pers, lac) - gradient;
-            } else {
-                noise = -1.0f; // Outside level radius.
-                water_noise = -1.0f;
-            }
-
-            Tile * tile = GetTile(world->map, coord);
-
-            if ( noise < game->forest_low || noise > game->forest_high ) {
-                *tile = CreateTile(TILE_TREE);
-            } else {
-                *tile = CreateTile(TILE_FOREST_GROUND);
+                noise = terrain_noise[band_index] - gradient;
+                water_noise = water_noise_plane[band_index] - gradient;
             }
 
-            if ( water_noise > game->forest_high ) {
-                *tile = CreateTile(TILE_WATER);
+            TileType type = TILE_TREE;
+            if ( water_noise > gen->forest_high ) {
+                type = TILE_WATER;
+            } else if ( noise >= gen->forest_low && noise <= gen->forest_high ) {
+                type = TILE_FOREST_GROUND;
+                AddGenCoord(gen, coord);
             }
 
-            if ( tile->type == TILE_FOREST_GROUND ) {
-                AddTile(coord);
-            }
-
-            tile->id = -1; // Reset all tiles' region
-            if ( area_info[AREA_FOREST].reveal_all ) {
-                tile->flags.revealed = true;
+            // Trees are already there, so chunks that are only trees are
+            // never written to.
+            if ( type != TILE_TREE ) {
+                SetTile(map, coord, type);
+                SetRegionID(map, coord, -1);
+                if ( area_info[AREA_FOREST].reveal_all ) {
+                    GetTileFlags(map, coord)->revealed = true;
+                }
             }
         }
     }
 
+    StopNoiseWorkers(&workers);
+    free(terrain_noise);
+    free(water_noise_plane);
+
+    EndGenPhase(gen, GEN_NOISE_FILL);
+    BeginGenPhase(gen, GEN_FLOOD_FILL);
+
     // For all ground tiles, sort into connected regions.
-    int region = -1;
-    for ( int i = 0; i < num_coords; i++ ) {
-        Tile * tile = GetTile(world->map, coords[i]);
+    FillStack fill_stack = { .capacity = 1024 };
+    fill_stack.coords = malloc(fill_stack.capacity * sizeof(*fill_stack.coords));
+    if ( fill_stack.coords == NULL ) {
+        Error("could not allocate flood fill stack");
+    }
 
-        if ( tile->id == -1 ) { // Not yet visited
+    int regions_capacity = 256;
+    struct region * regions = malloc(regions_capacity * sizeof(*regions));
+    if ( regions == NULL ) {
+        Error("could not allocate forest regions");
+    }
+
+    int region = -1;
+    for ( int i = 0; i < gen->num_coords; i++ ) {
+        if ( GetRegionID(map, gen->coords[i]) == -1 ) { // Not yet visited
             region++;
-            FloodFillGroundTiles_r(world->map, coords[i], region);
+
+            if ( region == regions_capacity ) {
+                regions_capacity *= 2;
+                regions = realloc(regions, regions_capacity * sizeof(*regions));
+                if ( regions == NULL ) {
+                    Error("could not allocate forest regions");
+                }
+            }
+
+            regions[region] = (struct region){ 0 };
+            FloodFillGroundTiles(map, gen->coords[i], region, regions, &fill_stack);
         }
     }
 
+    free(fill_stack.coords);
+
     int num_regions = region + 1;
-    num_coords = 0;
+    gen->num_coords = 0;
+
+    EndGenPhase(gen, GEN_FLOOD_FILL);
+    BeginGenPhase(gen, GEN_REGION_SORT);
 
     // Sort regions by highest area.
-    for ( int i = 0; i < num_regions ; i++ ) {
-        for ( int j = i + 1; j < num_regions; j++ ) {
-            if ( i != j && regions[j].area > regions[i].area ) {
-                struct region temp = regions[i];
-                regions[i] = regions[j];
-                regions[j] = temp;
-            }
-        }
-    }
+    qsort(regions, num_regions, sizeof(*regions), CompareRegions);
+
+    EndGenPhase(gen, GEN_REGION_SORT);
 
     for ( int i = 0; i < region; i++ ) {
         printf("- region %d: area %d\n", regions[i].region, regions[i].area);
@@ -292,57 +587,57 @@ void GenerateForest(Game * game, int seed, int width)
     // Just the player and a teleporter.
     //
 
-    int area = GetTilesInFirstRegionSmallerThan(world->map, 80, 3, num_regions);
+    int area = GetTilesInFirstRegionSmallerThan(gen, regions, 80, 3, num_regions);
 
-    Actor * player = SpawnActorAtRandomLocation(game,
+    Actor * player = SpawnActorAtRandomLocation(gen,
                                                 ACTOR_PLAYER,
                                                 0,
-                                                num_coords - 1);
+                                                gen->num_coords - 1);
 
-    CalculateTileDistancesFrom(world->map, player->tile);
-    SortCoordsByDistance(world->map);
+    CalculateTileDistancesFrom(gen, player->tile);
+    SortCoordsByDistance(gen);
 
-    Tile * tp = CreateTileAtRandomLocation(world->map,
+    Tile * tp = CreateTileAtRandomLocation(gen,
                                            TILE_TELEPORTER,
-                                           num_coords * 0.9f,
-                                           num_coords - 1,
+                                           gen->num_coords * 0.9f,
+                                           gen->num_coords - 1,
                                            NULL);
     tp->tag = 0;
 
-    SpawnActorAtRandomLocation(game,
+    SpawnActorAtRandomLocation(gen,
                                ACTOR_SUPER_SPIDER,
-                               num_coords * 0.4f,
-                               num_coords * 0.8f);
+                               gen->num_coords * 0.4f,
+                               gen->num_coords * 0.8f);
 
     //
     // Second region - small area
     // Spawn spiders, and teleporter
     //
 
-    area = GetTilesInFirstRegionSmallerThan(world->map, 128, 2, num_regions);
+    area = GetTilesInFirstRegionSmallerThan(gen, regions, 128, 2, num_regions);
 
     // Create first teleporter at a completely random location in region.
     TileCoord tp_coord;
-    tp = CreateTileAtRandomLocation(world->map,
+    tp = CreateTileAtRandomLocation(gen,
                                     TILE_TELEPORTER,
                                     0,
-                                    num_coords - 1,
+                                    gen->num_coords - 1,
                                     &tp_coord);
     tp->tag = 0;
 
     // Create second teleporter and spawn it far away from the first.
-    CalculateTileDistancesFrom(world->map, tp_coord);
-    SortCoordsByDistance(world->map);
-    tp = CreateTileAtRandomLocation(world->map,
+    CalculateTileDistancesFrom(gen, tp_coord);
+    SortCoordsByDistance(gen);
+    tp = CreateTileAtRandomLocation(gen,
                                     TILE_TELEPORTER,
-                                    num_coords * 0.85f,
-                                    num_coords - 1,
+                                    gen->num_coords * 0.85f,
+                                    gen->num_coords - 1,
                                     NULL);
     tp->tag = 1;
 
     // Scatter some spiders.
     for ( int i = 0; i < area / 20; i++ ) {
-        SpawnActorAtRandomLocation(game, ACTOR_SPIDER, 0, num_coords - 1);
+        SpawnActorAtRandomLocation(gen, ACTOR_SPIDER, 0, gen->num_coords - 1);
     }
 
     //
@@ -350,32 +645,32 @@ void GenerateForest(Game * game, int seed, int width)
     // Spawn second teleporter, spiders, super spiders.
     //
 
-    area = GetTilesInFirstRegionSmallerThan(world->map, 256, 1, num_regions);
+    area = GetTilesInFirstRegionSmallerThan(gen, regions, 256, 1, num_regions);
 
     // Create first teleporter and a random point in the region.
-    tp = CreateTileAtRandomLocation(world->map,
+    tp = CreateTileAtRandomLocation(gen,
                                     TILE_TELEPORTER,
                                     0,
-                                    num_coords - 1,
+                                    gen->num_coords - 1,
                                     &tp_coord);
     tp->tag = 1; // connected to previous region
 
     // Create second teleporter and spawn it far away from the first.
-    CalculateTileDistancesFrom(world->map, tp_coord);
-    SortCoordsByDistance(world->map);
-    tp = CreateTileAtRandomLocation(world->map,
+    CalculateTileDistancesFrom(gen, tp_coord);
+    SortCoordsByDistance(gen);
+    tp = CreateTileAtRandomLocation(gen,
                                     TILE_TELEPORTER,
-                                    num_coords * 0.85f,
-                                    num_coords - 1,
+                                    gen->num_coords * 0.85f,
+                                    gen->num_coords - 1,
                                     NULL);
     tp->tag = 2; // connected to next region
 
     // Spawn the shack in an open area so the player can get around it.
-    Array * viable_shack_spots = NewArray(num_coords, sizeof(TileCoord), 0);
-    for ( int i = 0; i < num_coords; i++ ) {
-        TileCoord coord = coords[i];
+    Array * viable_shack_spots = NewArray(gen->num_coords, sizeof(TileCoord), 0);
+    for ( int i = 0; i < gen->num_coords; i++ ) {
+        TileCoord coord = gen->coords[i];
         for ( int d = 0; d < NUM_DIRECTIONS; d++ ) {
-            Tile * adj = GetAdjacentTile(world->map, coord, d);
+            const Tile * adj = GetAdjacentTile(map, coord, d);
             if ( adj->type != TILE_FOREST_GROUND ) {
                 goto next_coord;
             }
@@ -386,22 +681,22 @@ void GenerateForest(Game * game, int seed, int width)
         ;
     }
 
-    int shack_index = Random(0, viable_shack_spots->count - 1);
+    int shack_index = RngInt(&gen->rng, 0, viable_shack_spots->count - 1);
     TileCoord * spawn_spot = Get(viable_shack_spots, shack_index);
-    SpawnActor(game, ACTOR_SHACK_CLOSED, *spawn_spot);
+    SpawnActorInList(gen->game, &map->actor_list, ACTOR_SHACK_CLOSED, *spawn_spot);
     // player->tile = *spawn_spot; // TODO: TEMP, debug
 
     FreeArray(viable_shack_spots);
 
     // Spawn spiders
     for ( int i = 0; i < area / 10; i++ ) {
-        if ( Chance(0.2) ) {
-            SpawnActorAtRandomLocation(game,
+        if ( RngChance(&gen->rng, 0.2) ) {
+            SpawnActorAtRandomLocation(gen,
                                        ACTOR_SUPER_SPIDER,
                                        0,
-                                       num_coords - 1);
+                                       gen->num_coords - 1);
         } else {
-            SpawnActorAtRandomLocation(game, ACTOR_SPIDER, 0, num_coords - 1);
+            SpawnActorAtRandomLocation(gen, ACTOR_SPIDER, 0, gen->num_coords - 1);
         }
     }
 
@@ -411,47 +706,46 @@ void GenerateForest(Game * game, int seed, int width)
     // Spawn the exit.
     //
 
-    GetTilesInRegion(world->map, regions[0].region);
+    GetTilesInRegion(gen, map, regions[0].region);
     area = regions[0].area;
 
-    tp = CreateTileAtRandomLocation(world->map,
+    tp = CreateTileAtRandomLocation(gen,
                                     TILE_TELEPORTER,
                                     0,
-                                    num_coords - 1,
+                                    gen->num_coords - 1,
                                     &tp_coord);
     tp->tag = 2; // connected to previous region
 
-    CalculateTileDistancesFrom(world->map, tp_coord);
-    SortCoordsByDistance(world->map);
+    CalculateTileDistancesFrom(gen, tp_coord);
+    SortCoordsByDistance(gen);
 
-    int index = Random(num_coords * 0.9f, num_coords - 1);
-    TileCoord exit_coord = coords[index];
-    Tile * tile = GetTile(world->map, exit_coord);
-    *tile = CreateTile(TILE_FOREST_EXIT);
+    int index = RngInt(&gen->rng, gen->num_coords * 0.9f, gen->num_coords - 1);
+    TileCoord exit_coord = gen->coords[index];
+    SetTile(map, exit_coord, TILE_FOREST_EXIT);
     if ( area_info[AREA_FOREST].reveal_all ) {
-        tile->flags.revealed = true;
+        GetTileFlags(map, exit_coord)->revealed = true;
     }
-    SpawnActor(game, ACTOR_WELL, exit_coord);
+    SpawnActorInList(gen->game, &map->actor_list, ACTOR_WELL, exit_coord);
 
     for ( int i = 0; i < area / 10; i++ ) {
         // TODO: tweak
-        if ( Chance(0.05) ) {
-            SpawnActorAtRandomLocation(game, ACTOR_GHOST, 0, num_coords - 1);
-        } else if ( Chance( 0.1 ) ) {
-            SpawnActorAtRandomLocation(game, ACTOR_SUPER_SPIDER, 0, num_coords - 1);
+        if ( RngChance(&gen->rng, 0.05) ) {
+            SpawnActorAtRandomLocation(gen, ACTOR_GHOST, 0, gen->num_coords - 1);
+        } else if ( RngChance(&gen->rng,  0.1 ) ) {
+            SpawnActorAtRandomLocation(gen, ACTOR_SUPER_SPIDER, 0, gen->num_coords - 1);
         } else {
-            SpawnActorAtRandomLocation(game, ACTOR_SPIDER, 0, num_coords - 1);
+            SpawnActorAtRandomLocation(gen, ACTOR_SPIDER, 0, gen->num_coords - 1);
         }
     }
 
     // Spawn the key near-ish to the well.
 
-    CalculateTileDistancesFrom(world->map, exit_coord);
-    SortCoordsByDistance(world->map);
-    SpawnActorAtRandomLocation(game,
+    CalculateTileDistancesFrom(gen, exit_coord);
+    SortCoordsByDistance(gen);
+    SpawnActorAtRandomLocation(gen,
                                ACTOR_OLD_KEY,
-                               num_coords * 0.1f,
-                               num_coords * 0.2f);
+                               gen->num_coords * 0.1f,
+                               gen->num_coords * 0.2f);
 
     //
     // Generate shack interior
@@ -478,26 +772,25 @@ void GenerateForest(Game * game, int seed, int width)
         "00000000000"
     };
 
-    world->map++;
+    Map * shack = &gen->maps[1];
 
     int shack_size = SHACK_WIDTH * SHACK_HEIGHT;
-    AllocateMapTiles(world->map, SHACK_WIDTH, SHACK_HEIGHT, TILE_WOODEN_FLOOR);
-    RemoveAllActors(&world->map->actor_list);
+    AllocateMapTiles(shack, SHACK_WIDTH, SHACK_HEIGHT, TILE_WOODEN_FLOOR);
+    RemoveAllActors(&shack->actor_list);
 
     // A list of possible spawn locations for mobs and the bucket.
     Array * shack_coords_array = NewArray(shack_size, sizeof(TileCoord), 0);
 
     const char * c = shack_map;
     for ( int i = 0; i < shack_size; i++, c++ ) {
-        TileCoord coord = GetCoordinate(world->map, i);
-        tile = &world->map->tiles[i];
+        TileCoord coord = GetCoordinate(shack, i);
 
         switch ( *c ) {
             case '0':
-                *tile = CreateTile(TILE_NULL);
+                SetTile(shack, coord, TILE_NULL);
                 break;
             case 'X':
-                *tile = CreateTile(TILE_WOODEN_WALL);
+                SetTile(shack, coord, TILE_WOODEN_WALL);
                 break;
             case '.':
                 if ( TileDistance(player->tile, coord) >= 3 ) {
@@ -505,8 +798,8 @@ void GenerateForest(Game * game, int seed, int width)
                 }
                 break;
             case '@':
-                *tile = CreateTile(TILE_WHITE_OPENING);
-                player = SpawnActor(game, ACTOR_PLAYER, coord);
+                SetTile(shack, coord, TILE_WHITE_OPENING);
+                player = SpawnActorInList(gen->game, &shack->actor_list, ACTOR_PLAYER, coord);
                 break;
             default: {
                 ASSERT("Weird character in shack!");
@@ -517,19 +810,19 @@ void GenerateForest(Game * game, int seed, int width)
 
     // Spawn the bucket.
     TileCoord * shack_coords = shack_coords_array->data;
-    index = Random(0, shack_coords_array->count - 1);
-    SpawnActor(game, ACTOR_ROPE, shack_coords[index]);
+    index = RngInt(&gen->rng, 0, shack_coords_array->count - 1);
+    SpawnActorInList(gen->game, &shack->actor_list, ACTOR_ROPE, shack_coords[index]);
     Remove(shack_coords_array, index);
 
     // Spawn a couple ghosts
-    int num_ghosts = Random(2, 3);
+    int num_ghosts = RngInt(&gen->rng, 2, 3);
     for ( int i = 0; i < num_ghosts; i++ ) {
-        index = Random(0, shack_coords_array->count - 1);
-        SpawnActor(game, ACTOR_GHOST, shack_coords[index]);
+        index = RngInt(&gen->rng, 0, shack_coords_array->count - 1);
+        SpawnActorInList(gen->game, &shack->actor_list, ACTOR_GHOST, shack_coords[index]);
         Remove(shack_coords_array, index);
     }
 
     FreeArray(shack_coords_array);
-
-    world->map--;
+    MapChanged(shack);
+    free(regions);
 }
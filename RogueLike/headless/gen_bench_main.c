@@ -0,0 +1,258 @@
+//
+//  gen_bench_main.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/10/23.
+//
+//  RogueLikeGenBench: generate levels over a matrix of seeds and sizes and
+//  report how long each generation phase took (min, median and 99th
+//  percentile) as CSV, one row per area, size and phase. The game's own
+//  logging goes to stdout, the summary to stderr.
+//
+//  Forests are generated twice, the second time with the scalar noise path,
+//  to check that both make identical levels and to report the speedup. The
+//  forests' mean share of ground and water tiles is reported too, to check
+//  the forest_low and forest_high thresholds against after noise changes.
+//
+
+#include "game.h"
+#include "genlib.h"
+#include "mathlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 576
+
+// The whole of GenerateLevel, after the per-phase rows.
+#define PHASE_TOTAL NUM_GEN_PHASES
+
+typedef struct {
+    const char * name;
+    Area area;
+    int size;
+    bool scalar_noise;
+    GenPhase first_phase;
+    GenPhase last_phase;
+} BenchCase;
+
+// Smaller forests don't reliably have enough clearings for all four regions.
+// The scalar forest must come after the other.
+static const BenchCase cases[] = {
+    { "dungeon", AREA_DUNGEON, 31, false, GEN_SPAWN_ROOMS, GEN_DOORS },
+    { "dungeon", AREA_DUNGEON, 47, false, GEN_SPAWN_ROOMS, GEN_DOORS },
+    { "dungeon", AREA_DUNGEON, 63, false, GEN_SPAWN_ROOMS, GEN_DOORS },
+    { "dungeon", AREA_DUNGEON, 127, false, GEN_SPAWN_ROOMS, GEN_DOORS },
+    { "forest", AREA_FOREST, FOREST_SIZE, false, GEN_NOISE_FILL, GEN_REGION_SORT },
+    { "forest-scalar", AREA_FOREST, FOREST_SIZE, true, GEN_NOISE_FILL, GEN_REGION_SORT },
+};
+
+static void Usage(const char * program)
+{
+    fprintf(stderr,
+            "usage: %s [-n seeds] [-s first-seed] [-o file]\n"
+            "  -n  number of seeds per area and size (default 500)\n"
+            "  -s  first seed (default 1)\n"
+            "  -o  CSV output file (default gen_bench.csv)\n",
+            program);
+    exit(EXIT_FAILURE);
+}
+
+static int CompareFloats(const void * a, const void * b)
+{
+    float f1 = *(const float *)a;
+    float f2 = *(const float *)b;
+
+    return (f1 > f2) - (f1 < f2);
+}
+
+/// FNV-1a hash of a map's tiles and regions, to compare levels.
+static u64 HashMap(const Map * map)
+{
+    u64 hash = 14695981039346656037ULL;
+    int size = map->width * map->height;
+
+    for ( int i = 0; i < size; i++ ) {
+        TileCoord coord = GetCoordinate(map, i);
+        hash = (hash ^ GetTile(map, coord)->type) * 1099511628211ULL;
+        hash = (hash ^ (u32)GetRegionID(map, coord)) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/// The fraction of a map's tiles that are of `type`.
+static float TileFraction(const Map * map, TileType type)
+{
+    int size = map->width * map->height;
+    int count = 0;
+
+    for ( int i = 0; i < size; i++ ) {
+        if ( GetTile(map, GetCoordinate(map, i))->type == type ) {
+            count++;
+        }
+    }
+
+    return (float)count / size;
+}
+
+
+/// Sort `samples` and write one CSV row for them, times in milliseconds.
+/// - returns: The median.
+static float WriteRow(FILE * csv,
+                     const BenchCase * bench_case,
+                     const char * phase_name,
+                     float * samples,
+                     int num_samples)
+{
+    qsort(samples, num_samples, sizeof(*samples), CompareFloats);
+
+    int p99_index = (num_samples * 99 + 99) / 100 - 1; // ceil(0.99n) - 1
+    float min = samples[0] * 1000.0f;
+    float median = samples[num_samples / 2] * 1000.0f;
+    float p99 = samples[p99_index] * 1000.0f;
+
+    const char * area = bench_case->name;
+
+    fprintf(csv, "%s,%d,%s,%d,%.4f,%.4f,%.4f\n",
+            area, bench_case->size, phase_name, num_samples, min, median, p99);
+    fprintf(stderr, "%-13s %4d  %-18s %9.4f %9.4f %9.4f\n",
+            area, bench_case->size, phase_name, min, median, p99);
+
+    return median;
+}
+
+int main(int argc, char ** argv)
+{
+    int num_seeds = 500;
+    int first_seed = 1;
+    const char * csv_path = "gen_bench.csv";
+
+    int option;
+    while ( (option = getopt(argc, argv, "n:s:o:")) != -1 ) {
+        switch ( option ) {
+            case 'n':
+                num_seeds = atoi(optarg);
+                break;
+            case 's':
+                first_seed = atoi(optarg);
+                break;
+            case 'o':
+                csv_path = optarg;
+                break;
+            default:
+                Usage(argv[0]);
+                break;
+        }
+    }
+
+    if ( num_seeds < 1 ) {
+        Usage(argv[0]);
+    }
+
+    FILE * csv = fopen(csv_path, "w");
+    if ( csv == NULL ) {
+        Error("could not open %s", csv_path);
+    }
+
+    fprintf(csv, "area,size,phase,levels,min_ms,median_ms,p99_ms\n");
+    fprintf(stderr, "%-13s %4s  %-18s %9s %9s %9s\n",
+            "area", "size", "phase", "min ms", "median", "p99");
+
+    Game * game = InitGame(BENCH_WIDTH, BENCH_HEIGHT);
+
+    int num_phases = NUM_GEN_PHASES + 1;
+    float * samples = malloc(num_phases * num_seeds * sizeof(*samples));
+    u64 * forest_hashes = malloc(num_seeds * sizeof(*forest_hashes));
+    if ( samples == NULL || forest_hashes == NULL ) {
+        Error("could not allocate samples");
+    }
+
+    float noise_median = 0.0f;
+    float scalar_noise_median = 0.0f;
+    float forest_ground = 0.0f;
+    float forest_water = 0.0f;
+
+    int num_cases = sizeof(cases) / sizeof(cases[0]);
+    float start = ProgramTime();
+
+    for ( int c = 0; c < num_cases; c++ ) {
+        const BenchCase * bench_case = &cases[c];
+
+        for ( int i = 0; i < num_seeds; i++ ) {
+            int seed = first_seed + i;
+
+            LevelGen gen;
+            InitLevelGen(&gen,
+                         game,
+                         game->world.maps,
+                         bench_case->area,
+                         seed,
+                         bench_case->size,
+                         bench_case->size);
+            gen.scalar_noise = bench_case->scalar_noise;
+
+            float level_start = ProgramTime();
+            GenerateLevel(&gen);
+            samples[PHASE_TOTAL * num_seeds + i] = ProgramTime() - level_start;
+
+            for ( int p = 0; p < NUM_GEN_PHASES; p++ ) {
+                samples[p * num_seeds + i] = gen.phase_msec[p];
+            }
+
+            if ( bench_case->area == AREA_FOREST ) {
+                u64 hash = HashMap(&game->world.maps[0]);
+
+                if ( !bench_case->scalar_noise ) {
+                    forest_hashes[i] = hash;
+                    forest_ground += TileFraction(&game->world.maps[0], TILE_FOREST_GROUND);
+                    forest_water += TileFraction(&game->world.maps[0], TILE_WATER);
+                } else if ( hash != forest_hashes[i] ) {
+                    Error("seed %d: scalar noise made a different forest", seed);
+                }
+            }
+        }
+
+        for ( GenPhase p = bench_case->first_phase; p <= bench_case->last_phase; p++ ) {
+            float median = WriteRow(csv,
+                                    bench_case,
+                                    gen_phase_names[p],
+                                    &samples[p * num_seeds],
+                                    num_seeds);
+
+            if ( p == GEN_NOISE_FILL ) {
+                if ( bench_case->scalar_noise ) {
+                    scalar_noise_median = median;
+                } else {
+                    noise_median = median;
+                }
+            }
+        }
+
+        WriteRow(csv,
+                 bench_case,
+                 "total",
+                 &samples[PHASE_TOTAL * num_seeds],
+                 num_seeds);
+    }
+
+    fprintf(stderr, "noise fill speedup over scalar: %.2fx (%d threads)\n",
+            scalar_noise_median / noise_median,
+            MIN(SDL_GetCPUCount(), MAX_NOISE_THREADS));
+    fprintf(stderr, "forest tiles: %.1f%% ground, %.1f%% water\n",
+            100.0f * forest_ground / num_seeds,
+            100.0f * forest_water / num_seeds);
+    fprintf(stderr, "%d levels in %.1f s, results in %s\n",
+            num_cases * num_seeds,
+            ProgramTime() - start,
+            csv_path);
+
+    free(forest_hashes);
+    free(samples);
+    fclose(csv);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+//
+//  headless.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/9/23.
+//
+//  Stand-ins for the video and sound libraries, for the headless simulation
+//  build. Nothing is drawn or played, and there's no window or renderer.
+//
+
+#include "video.h"
+#include "sound.h"
+
+#define CHAR_WIDTH 4 // FONT_4X6
+#define CHAR_HEIGHT 6
+
+SDL_Window * window;
+SDL_Renderer * renderer;
+
+#pragma mark - Video
+
+void V_InitVideo(video_info_t * info) { }
+void V_SetFont(int font) { }
+void V_SetTextScale(float x, float y) { }
+
+int V_PrintString(int x, int y, const char * format, ...)
+{
+    return x;
+}
+
+int V_CharWidth(void) { return CHAR_WIDTH; }
+int V_CharHeight(void) { return CHAR_HEIGHT; }
+
+void V_SetRGB(u8 r, u8 g, u8 b) { }
+void V_SetRGBA(u8 r, u8 g, u8 b, u8 a) { }
+void V_SetGray(u8 gray) { }
+void V_SetColor(SDL_Color color) { }
+
+void V_Clear(void) { }
+void V_ClearRGB(u8 r, u8 g, u8 b) { }
+void V_FillRect(const SDL_Rect * rect) { }
+void V_DrawRect(const SDL_Rect * rect) { }
+void V_DrawVLine(int x, int y1, int y2) { }
+void V_DrawTexture(SDL_Texture * texture, const SDL_Rect * src, const SDL_Rect * dst) { }
+void V_Refresh(void) { }
+void V_ToggleFullscreen(int mode) { }
+
+#pragma mark - Sound
+
+void S_InitSound(void) { }
+void S_Play(const char * string, ...) { }
@@ -0,0 +1,207 @@
+//
+//  sim_main.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/9/23.
+//
+//  RogueLikeSim: load a level and run a number of turns with a scripted or
+//  random player, then report turn throughput. The game's own logging goes to
+//  stdout, the results to stderr.
+//
+
+#include "sim.h"
+#include "pregen.h"
+#include "genlib.h"
+#include "mathlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Same render size as the game's window: 18 tiles high, 16:9.
+#define SIM_HEIGHT (18 * SCALED(TILE_SIZE))
+#define SIM_WIDTH (SIM_HEIGHT * 16 / 9)
+
+static void Usage(const char * program)
+{
+    fprintf(stderr,
+            "usage: %s [-n turns] [-l level] [-s seed] [-p moves] [-w file] [-t file]\n"
+            "       %s -r file [-t file]\n"
+            "  -n  number of turns to run (default 1000)\n"
+            "  -l  level to start on (default 1)\n"
+            "  -s  master seed (default: the time)\n"
+            "  -p  player moves, a string of w, a, s and d, repeated;\n"
+            "      random moves if not given\n"
+            "  -w  record the game to a file, starting on level 1\n"
+            "  -r  replay a game recorded here or in the game\n"
+            "  -t  write a Chrome trace of the run to a file\n",
+            program,
+            program);
+    exit(EXIT_FAILURE);
+}
+
+static Direction ScriptDirection(const char * script, int turn)
+{
+    switch ( script[turn % strlen(script)] ) {
+        case 'w': return NORTH;
+        case 'a': return WEST;
+        case 's': return SOUTH;
+        case 'd': return EAST;
+        default: return NO_DIRECTION;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    int num_turns = 1000;
+    int level_num = 1;
+    u64 seed = (u64)time(NULL);
+    const char * script = NULL;
+    const char * record_path = NULL;
+    const char * replay_path = NULL;
+    const char * trace_path = NULL;
+
+    int option;
+    while ( (option = getopt(argc, argv, "n:l:s:p:w:r:t:")) != -1 ) {
+        switch ( option ) {
+            case 'n':
+                num_turns = atoi(optarg);
+                break;
+            case 'l':
+                level_num = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'p':
+                script = optarg;
+                break;
+            case 'w':
+                record_path = optarg;
+                break;
+            case 'r':
+                replay_path = optarg;
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            default:
+                Usage(argv[0]);
+                break;
+        }
+    }
+
+    if ( num_turns < 1 || level_num < 1 ) {
+        Usage(argv[0]);
+    }
+
+    // Recordings always start on level one.
+    if ( (record_path || replay_path) && level_num != 1 ) {
+        Usage(argv[0]);
+    }
+
+    if ( script ) {
+        if ( *script == '\0' ) {
+            Usage(argv[0]);
+        }
+
+        for ( const char * c = script; *c; c++ ) {
+            if ( ScriptDirection(c, 0) == NO_DIRECTION ) {
+                Usage(argv[0]);
+            }
+        }
+    }
+
+    if ( trace_path ) {
+        StartProfiling();
+    }
+
+    Recording recording = { 0 };
+    Game * game;
+
+    if ( replay_path ) {
+        if ( !LoadRecording(&recording, replay_path) ) {
+            fprintf(stderr, "could not load recording %s\n", replay_path);
+            return EXIT_FAILURE;
+        }
+
+        seed = recording.master_seed;
+        num_turns = recording.num_commands;
+        game = InitReplaySimulation(SIM_WIDTH, SIM_HEIGHT, &recording);
+    } else {
+        if ( record_path ) {
+            StartRecording(record_path);
+        }
+
+        game = InitSimulation(SIM_WIDTH, SIM_HEIGHT, level_num, seed);
+    }
+
+    // Random moves get their own stream of the master seed.
+    Rng player_rng = SeedRng(seed, NUM_RNG_STREAMS);
+
+    int turns_run = 0;
+    bool alive = true;
+    float max_turn_msec = 0.0f;
+    float start = ProgramTime();
+
+    while ( alive && turns_run < num_turns ) {
+        Command command = { .type = COMMAND_MOVE };
+        if ( replay_path ) {
+            command = recording.commands[turns_run];
+        } else if ( script ) {
+            command.direction = ScriptDirection(script, turns_run);
+        } else {
+            command.direction = RandomPlayerDirection(game, &player_rng);
+        }
+
+        float turn_start = ProgramTime();
+        alive = SimulateCommand(game, command);
+        float turn_msec = (ProgramTime() - turn_start) * 1000.0f;
+
+        if ( turn_msec > max_turn_msec ) {
+            max_turn_msec = turn_msec;
+        }
+
+        turns_run++;
+    }
+
+    float elapsed = ProgramTime() - start;
+
+    fprintf(stderr, "%d turns from level %d to level %d%s, seed %llu\n",
+            turns_run,
+            level_num,
+            game->level,
+            alive ? "" : " (player died)",
+            (unsigned long long)seed);
+    fprintf(stderr, "%.1f ms total, %.3f ms per turn (max %.3f), %.0f turns/sec\n",
+            elapsed * 1000.0f,
+            elapsed * 1000.0f / turns_run,
+            max_turn_msec,
+            turns_run / elapsed);
+
+    // To check that a replay ended up where the recording did.
+    const Actor * player = FindActorConst(&game->world.map->actor_list,
+                                          ACTOR_PLAYER);
+    if ( player ) {
+        fprintf(stderr, "player at %d, %d with %d health\n",
+                player->tile.x,
+                player->tile.y,
+                player->stats.health);
+    }
+
+    StopRecordingAndReplay();
+    FreeRecording(&recording);
+    FreePregen();
+
+    if ( trace_path ) {
+        StopProfiling();
+        if ( !WriteTrace(trace_path) ) {
+            fprintf(stderr, "could not write %s\n", trace_path);
+        }
+    }
+    FreeProfiler();
+
+    return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include "game.h"
 #include "video.h"
 #include "texture.h"
+#include "sprite_batch.h"
 
 static struct {
     u8 x, y;
@@ -41,5 +42,6 @@ void RenderIcon(Icon icon, int x, int y, const RenderInfo * render_info)
     dst.x = x;
     dst.y = y;
 
-    V_DrawTexture(render_info->icon_texture, &src, &dst);
+    SDL_Color white = { 255, 255, 255, 255 };
+    BatchSprite(render_info->icon_texture, &src, &dst, white, SDL_FLIP_NONE);
 }
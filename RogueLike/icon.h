@@ -33,6 +33,7 @@ typedef enum {
     NUM_ICONS,
 } Icon;
 
+/// Batched: call FlushSprites() when done drawing icons.
 void RenderIcon(Icon icon, int x, int y, const RenderInfo * render_info);
 
 #endif /* icon_h */
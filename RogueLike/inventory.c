@@ -8,6 +8,7 @@
 #include "inventory.h"
 #include "video.h"
 #include "direction.h"
+#include "sprite_batch.h"
 
 #include <stdarg.h>
 
@@ -188,5 +189,6 @@ void RenderInventory(const Inventory * inv, const RenderInfo * info)
                        info);
     }
 
+    FlushSprites();
     SDL_RenderSetViewport(renderer, NULL);
 }
@@ -0,0 +1,283 @@
+//
+//  light_map.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/6/23.
+//
+
+#include "light_map.h"
+#include "world.h"
+#include "genlib.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CONTRIBUTION_CACHE_SIZE 64
+
+/// The tiles a light can reach: those within its radius with a clear
+/// horizontal-then-vertical or vertical-then-horizontal path to it.
+typedef struct {
+    u32 sight_generation; // Of the map it was calculated for. 0 if unused.
+    TileCoord origin;
+    int radius;
+
+    u8 * reachable; // A (2 * radius + 1)^2 square centered on `origin`.
+    int size; // Allocated size of `reachable`.
+    u32 last_used;
+} Contribution;
+
+static Contribution cache[CONTRIBUTION_CACHE_SIZE];
+static u32 use_count;
+static int num_calculated;
+
+static void CalculateContribution(Contribution * c, const Map * map)
+{
+    ProfileScope scope = PROFILE_BEGIN("CalculateContribution");
+
+    int r = c->radius;
+    int w = 2 * r + 1;
+    int i = 0;
+
+    TileCoord coord;
+    for ( coord.y = c->origin.y - r; coord.y <= c->origin.y + r; coord.y++ ) {
+        for ( coord.x = c->origin.x - r; coord.x <= c->origin.x + r; coord.x++ ) {
+            c->reachable[i++] = IsInBounds(map, coord.x, coord.y)
+                && TileDistance(c->origin, coord) <= r
+                && ManhattenPathsAreClear(map,
+                                          c->origin.x,
+                                          c->origin.y,
+                                          coord.x,
+                                          coord.y);
+        }
+    }
+
+    ASSERT(i == w * w);
+    num_calculated++;
+
+    PROFILE_END(scope);
+}
+
+static const Contribution * GetContribution(const Map * map, const Light * light)
+{
+    Contribution * lru = &cache[0];
+
+    for ( int i = 0; i < CONTRIBUTION_CACHE_SIZE; i++ ) {
+        Contribution * c = &cache[i];
+
+        if (   c->sight_generation == map->sight_generation
+            && c->radius == light->radius
+            && TileCoordsEqual(c->origin, light->origin) )
+        {
+            c->last_used = ++use_count;
+            return c;
+        }
+
+        if ( c->last_used < lru->last_used ) {
+            lru = c;
+        }
+    }
+
+    // Not cached: recalculate the least recently used entry.
+    int w = 2 * light->radius + 1;
+    if ( lru->size < w * w ) {
+        lru->reachable = realloc(lru->reachable, w * w);
+        if ( lru->reachable == NULL ) {
+            Error("could not allocate light contribution");
+        }
+        lru->size = w * w;
+    }
+
+    lru->sight_generation = map->sight_generation;
+    lru->origin = light->origin;
+    lru->radius = light->radius;
+    lru->last_used = ++use_count;
+    CalculateContribution(lru, map);
+
+    return lru;
+}
+
+/// Set each tile's light level according to its visibility flags.
+static void SetAmbientLight(Map * map, const AreaInfo * info, Box region)
+{
+    for ( int y = region.top; y <= region.bottom; y++ ) {
+        int x = region.left;
+
+        // A chunk's tiles are contiguous along a row, so step through each
+        // chunk's part of the row.
+        while ( x <= region.right ) {
+            int chunk_end = MIN(x | (MAP_CHUNK_SIZE - 1), region.right);
+            const TileChunk * chunk = GetTileChunk(map, x, y);
+            int i = TileChunkIndex(x, y);
+
+            for ( ; x <= chunk_end; x++, i++ ) {
+                TileFlags flags = chunk->flags[i];
+                u8 light;
+
+                if ( flags.bright ) {
+                    light = 255;
+                } else if ( info->reveal_all ) {
+                    light = info->visible_light;
+                    if ( !flags.visible ) {
+                        // Might give the chunk its own copy.
+                        SetTileVisible(map, (TileCoord){ x, y }, true);
+                        chunk = GetTileChunk(map, x, y);
+                    }
+                } else if ( flags.visible ) {
+                    light = info->visible_light;
+                } else if ( flags.revealed ) {
+                    light = info->revealed_light;
+                } else {
+                    light = info->unrevealed_light;
+                }
+
+                // Only written if changed, so unlit fill tiles stay shared.
+                if ( chunk->light[i] != light ) {
+                    TileChunk * writable = GetWritableTileChunk(map, x, y);
+                    writable->light[i] = light;
+                    TouchTileChunk(map, writable);
+                    chunk = writable;
+                }
+            }
+        }
+    }
+}
+
+/// Brighten visible, revealed tiles within the light's reach.
+static void ApplyLight(Map * map, const Light * light)
+{
+    const Contribution * c = GetContribution(map, light);
+    const u8 * reachable = c->reachable;
+    int r = light->radius;
+
+    for ( int y = light->origin.y - r; y <= light->origin.y + r; y++ ) {
+        for ( int x = light->origin.x - r; x <= light->origin.x + r; x++ ) {
+            if ( !*reachable++ ) {
+                continue;
+            }
+
+            const TileChunk * chunk = GetTileChunk(map, x, y);
+            int i = TileChunkIndex(x, y);
+            TileFlags flags = chunk->flags[i];
+
+            if (   flags.visible
+                && flags.revealed
+                && light->level > chunk->light[i] )
+            {
+                TileChunk * writable = GetWritableTileChunk(map, x, y);
+                writable->light[i] = light->level;
+                TouchTileChunk(map, writable);
+            }
+        }
+    }
+}
+
+void ResetLightMap(LightMap * lm)
+{
+    lm->num_lights = 0;
+    lm->dirty = true;
+}
+
+void InvalidateLightMap(LightMap * lm)
+{
+    lm->dirty = true;
+}
+
+void BeginLights(LightMap * lm)
+{
+    lm->num_added = 0;
+    lm->lights_changed = false;
+}
+
+void AddLight(LightMap * lm, TileCoord origin, int radius, u8 level)
+{
+    if ( radius == 0 ) {
+        return;
+    }
+
+    // Overwrite the previous list in place, noting whether anything changed.
+    int i = lm->num_added++;
+
+    if ( i < lm->num_lights ) {
+        Light * old = &lm->lights[i];
+        if (   TileCoordsEqual(old->origin, origin)
+            && old->radius == radius
+            && old->level == level )
+        {
+            return;
+        }
+    }
+
+    if ( i >= lm->lights_capacity ) {
+        lm->lights_capacity = lm->lights_capacity ? lm->lights_capacity * 2 : 64;
+        lm->lights = realloc(lm->lights, lm->lights_capacity * sizeof(*lm->lights));
+        if ( lm->lights == NULL ) {
+            Error("could not allocate lights");
+        }
+    }
+
+    lm->lights[i] = (Light){ origin, radius, level };
+    lm->lights_changed = true;
+}
+
+void UpdateLightMap(LightMap * lm, Map * map, const AreaInfo * info, Box region)
+{
+    if ( lm->num_added != lm->num_lights ) {
+        lm->lights_changed = true;
+        lm->num_lights = lm->num_added;
+    }
+
+    if (   !lm->dirty
+        && !lm->lights_changed
+        && lm->sight_generation == map->sight_generation
+        && lm->info == info
+        && memcmp(&lm->region, &region, sizeof(region)) == 0 )
+    {
+        lm->num_skipped++;
+        return;
+    }
+
+    lm->dirty = false;
+    lm->region = region;
+    lm->sight_generation = map->sight_generation;
+    lm->info = info;
+    lm->num_composites++;
+
+    ProfileScope scope = PROFILE_BEGIN("UpdateLightMap");
+
+    SetAmbientLight(map, info, region);
+
+    for ( int i = 0; i < lm->num_lights; i++ ) {
+        ApplyLight(map, &lm->lights[i]);
+    }
+
+    PROFILE_END(scope);
+}
+
+int LightContributionsCalculated(void)
+{
+    return num_calculated;
+}
+
+void FreeLightMap(LightMap * lm)
+{
+    free(lm->lights);
+    *lm = (LightMap){ 0 };
+}
+
+size_t LightContributionsMemoryUsage(void)
+{
+    size_t usage = 0;
+    for ( int i = 0; i < CONTRIBUTION_CACHE_SIZE; i++ ) {
+        usage += cache[i].size;
+    }
+
+    return usage;
+}
+
+void FreeLightContributions(void)
+{
+    for ( int i = 0; i < CONTRIBUTION_CACHE_SIZE; i++ ) {
+        free(cache[i].reachable);
+        cache[i] = (Contribution){ 0 };
+    }
+}
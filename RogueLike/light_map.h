@@ -0,0 +1,73 @@
+//
+//  light_map.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/6/23.
+//
+//  Per-tile light levels: the area's ambient light, brightened by light
+//  sources. The levels are kept in the map's tile chunks. Each source's reach
+//  is cached until it moves or a tile that blocks sight changes, and the light
+//  levels are only recomposited when the region, the lights, or tile
+//  visibility change.
+//
+
+#ifndef light_map_h
+#define light_map_h
+
+#include "coord.h"
+#include "shorttypes.h"
+
+#include <stddef.h>
+
+typedef struct map Map;
+typedef struct area_info AreaInfo;
+
+typedef struct {
+    TileCoord origin;
+    u8 radius;
+    u8 level;
+} Light;
+
+typedef struct {
+    Light * lights; // The lights from the last composite.
+    int num_lights;
+    int lights_capacity;
+    int num_added; // Since BeginLights().
+    bool lights_changed;
+
+    // The rest of the last composite's inputs.
+    bool dirty;
+    Box region;
+    u32 sight_generation;
+    const AreaInfo * info;
+
+    // Stats
+    int num_composites;
+    int num_skipped;
+} LightMap;
+
+/// Forget the lights and force a recomposite, for a new map.
+void ResetLightMap(LightMap * lm);
+
+/// Force a recomposite on the next update. Call whenever tiles' visible or
+/// revealed flags change.
+void InvalidateLightMap(LightMap * lm);
+
+/// Start a new list of light sources. Call AddLight() for each light,
+/// then UpdateLightMap().
+void BeginLights(LightMap * lm);
+void AddLight(LightMap * lm, TileCoord origin, int radius, u8 level);
+
+/// Set the light level of each tile in `region` according to its visibility
+/// flags, then brighten tiles within reach of each light. Does nothing if
+/// nothing changed since the last update.
+void UpdateLightMap(LightMap * lm, Map * map, const AreaInfo * info, Box region);
+
+/// The total number of light contributions calculated.
+int LightContributionsCalculated(void);
+size_t LightContributionsMemoryUsage(void);
+
+void FreeLightMap(LightMap * lm);
+void FreeLightContributions(void);
+
+#endif /* light_map_h */
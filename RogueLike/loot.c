@@ -51,7 +51,7 @@ const Loot loot_tables[NUM_ACTOR_TYPES][20] = {
 
 // Drop loot according to the loot table of parameter, `actor_type`.
 // - returns: The `ActorType` of the loot dropped.
-ActorType SelectLoot(ActorType actor_type)
+ActorType SelectLoot(ActorType actor_type, Rng * rng)
 {
     int total_weight = 0;
 
@@ -67,7 +67,7 @@ ActorType SelectLoot(ActorType actor_type)
         total_weight += table[i].weight;
     }
 
-    int r = Random(0, total_weight - 1);
+    int r = RngInt(rng, 0, total_weight - 1);
     int running_total = 0;
 
 
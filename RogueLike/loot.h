@@ -9,6 +9,7 @@
 #define loot_h
 
 #include "actor.h"
+#include "rng.h"
 
 typedef struct {
     ActorType actor_type;
@@ -16,6 +17,6 @@ typedef struct {
 } Loot;
 
 extern const Loot blob_loot[];
-ActorType SelectLoot(ActorType actor_type);
+ActorType SelectLoot(ActorType actor_type, Rng * rng);
 
 #endif /* loot_h */
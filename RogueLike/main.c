@@ -13,6 +13,14 @@
 #include "debug.h"
 #include "world.h"
 #include "config.h"
+#include "astar.h"
+#include "flow_field.h"
+#include "tile_cache.h"
+#include "pregen.h"
+#include "replay.h"
+#include "frame_stats.h"
+
+#include <string.h>
 
 static SDL_Rect InitVideo(void)
 {
@@ -50,18 +58,60 @@ static SDL_Rect InitVideo(void)
     return size;
 }
 
-int main(void)
+/// Options:
+/// -record <file>   record each new game to file
+/// -replay <file>   play a recorded game, then quit
+/// -uncapped        with -replay, run frames as fast as possible
+/// -norender        with -replay, don't draw anything
+/// -trace <file>    profile from the start, and write a trace to file at exit
+/// Anything else (such as the options Xcode passes) is ignored.
+int main(int argc, char ** argv)
 {
+    const char * record_path = NULL;
+    const char * replay_path = NULL;
+    const char * trace_path = NULL;
+    bool uncapped = false;
+    bool no_render = false;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp(argv[i], "-record") == 0 && i + 1 < argc ) {
+            record_path = argv[++i];
+        } else if ( strcmp(argv[i], "-replay") == 0 && i + 1 < argc ) {
+            replay_path = argv[++i];
+        } else if ( strcmp(argv[i], "-uncapped") == 0 ) {
+            uncapped = true;
+        } else if ( strcmp(argv[i], "-norender") == 0 ) {
+            no_render = true;
+        } else if ( strcmp(argv[i], "-trace") == 0 && i + 1 < argc ) {
+            trace_path = argv[++i];
+        }
+    }
+
     if ( SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0 ) {
         Error("Could not init SDL: %s", SDL_GetError());
     }
 
+    if ( trace_path ) {
+        StartProfiling();
+    }
+
     Randomize();
     LoadConfigFile();
     SDL_Rect game_size = InitVideo();
     S_InitSound();
     Game * game = InitGame(game_size.w, game_size.h);
 
+    if ( record_path ) {
+        StartRecording(record_path);
+    }
+
+    if ( replay_path ) {
+        skip_render = no_render;
+        StartReplay(game, replay_path, !uncapped);
+    } else {
+        uncapped = false;
+    }
+
     int old_time = SDL_GetTicks();
     const float target_dt = 1.0f / FPS;
 
@@ -69,27 +119,42 @@ int main(void)
         int new_time = SDL_GetTicks();
         float dt = (float)(new_time - old_time) / 1000.0f;
 
-        if ( dt < target_dt ) {
+        if ( dt < target_dt && !uncapped ) {
             SDL_Delay(1);
             continue;
         }
 
+        ProfileScope scope = PROFILE_BEGIN("Frame");
         PROFILE(DoFrame(game, target_dt), frame_msec);
-        if ( frame_msec > max_frame_msec ) {
-            max_frame_msec = frame_msec;
-        }
+        PROFILE_END(scope);
+        RecordFrameStats();
 
         old_time = new_time;
     }
 
     SaveConfigFile();
 
+    StopRecordingAndReplay();
+    FreePregen();
+
+    // Profiling started with -trace or F9 and never stopped.
+    if ( profiling ) {
+        StopProfiling();
+        WriteTrace(trace_path ? trace_path : DEFAULT_TRACE_FILE);
+    }
+    FreeProfiler();
     FreeDistanceMapQueue();
+    FreePathNodes();
+    FreeFlowFields();
+    FreeDistanceMapBuffers();
+    FreeLightContributions();
     DestroyActorList(&game->world.map->actor_list);
+    FreeTileCache();
     FreeRenderAssets(&game->render_info);
     FreeVisibleActorsArray();
-    free(game->world.map->tiles);
-    free(game->world.map->tile_ids);
+    FreeDistanceMap(&game->world.map->player_distances);
+    FreeLightMap(&game->world.map->light_map);
+    FreeMapTiles(game->world.map);
     free(game);
 
     return 0;
@@ -6,6 +6,8 @@
 //
 
 #include "game.h"
+#include "astar.h"
+#include "flow_field.h"
 
 #include "mathlib.h"
 #include "video.h"
@@ -55,16 +57,16 @@ int CalculateWallSignature(const Map * map, TileCoord coord, bool ignore_reveal)
     int signature = 0;
 
     for ( Direction i = 0; i < NUM_DIRECTIONS; i++ ) {
-        Tile * adjacent = GetAdjacentTile((Map *)map, coord, i);
+        const TileFlags * adjacent = GetTileFlags(map, AdjacentTileCoord(coord, i));
 
         if ( adjacent ) {
             bool is_floor = true;
 
-            if ( adjacent->flags.blocks_movement ) {
+            if ( adjacent->blocks_movement ) {
                 is_floor = false;
             }
 
-            if ( !ignore_reveal && !adjacent->flags.revealed ) {
+            if ( !ignore_reveal && !adjacent->revealed ) {
                 is_floor = false;
             }
 
@@ -84,7 +86,7 @@ bool IsInBounds(const Map * map, int x, int y)
 }
 
 
-Tile * GetAdjacentTile(Map * map, TileCoord coord, Direction direction)
+const Tile * GetAdjacentTile(const Map * map, TileCoord coord, Direction direction)
 {
     if ( direction == NO_DIRECTION ) {
         return GetTile(map, coord);
@@ -94,13 +96,37 @@ Tile * GetAdjacentTile(Map * map, TileCoord coord, Direction direction)
 }
 
 
+TileChunk * GetWritableTileChunk(Map * map, int x, int y)
+{
+    TileChunk ** chunk = &map->chunks[(y >> MAP_CHUNK_SHIFT) * map->chunks_wide
+                                      + (x >> MAP_CHUNK_SHIFT)];
+
+    if ( *chunk == map->fill_chunk ) {
+        TileChunk * copy = malloc(sizeof(*copy));
+        if ( copy == NULL ) {
+            Error("Could not allocate map chunk");
+        }
+
+        // The fill chunk's signatures aren't kept: the copy's are worked out
+        // as needed until the next MapChanged().
+        *copy = *map->fill_chunk;
+        copy->signatures_valid = false;
+        *chunk = copy;
+        map->num_chunks_allocated++;
+    }
+
+    return *chunk;
+}
+
+
 Tile * GetTileNonConst(Map * map, TileCoord coord)
 {
     if ( !IsInBounds(map, coord.x, coord.y) ) {
         return NULL;
     }
 
-    return &map->tiles[coord.y * map->width + coord.x];
+    TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+    return &chunk->tiles[TileChunkIndex(coord.x, coord.y)];
 }
 
 
@@ -110,7 +136,85 @@ const Tile * GetTileConst(const Map * map, TileCoord coord)
         return NULL;
     }
 
-    return &map->tiles[coord.y * map->width + coord.x];
+    const TileChunk * chunk = GetTileChunk(map, coord.x, coord.y);
+    return &chunk->tiles[TileChunkIndex(coord.x, coord.y)];
+}
+
+
+TileFlags * GetTileFlagsNonConst(Map * map, TileCoord coord)
+{
+    if ( !IsInBounds(map, coord.x, coord.y) ) {
+        return NULL;
+    }
+
+    TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+    return &chunk->flags[TileChunkIndex(coord.x, coord.y)];
+}
+
+
+const TileFlags * GetTileFlagsConst(const Map * map, TileCoord coord)
+{
+    if ( !IsInBounds(map, coord.x, coord.y) ) {
+        return NULL;
+    }
+
+    const TileChunk * chunk = GetTileChunk(map, coord.x, coord.y);
+    return &chunk->flags[TileChunkIndex(coord.x, coord.y)];
+}
+
+
+/// The tile's cached wall signature. Tiles in chunks that haven't been
+/// written to since the last MapChanged() have it calculated.
+u8 GetWallSignature(const Map * map, TileCoord coord)
+{
+    ASSERT(IsInBounds(map, coord.x, coord.y));
+    const TileChunk * chunk = GetTileChunk(map, coord.x, coord.y);
+
+    if ( !chunk->signatures_valid ) {
+        return CalculateWallSignature(map, coord, false);
+    }
+
+    return chunk->wall_signatures[TileChunkIndex(coord.x, coord.y)];
+}
+
+
+/// The tile's current light level. See UpdateLightMap().
+u8 GetTileLight(const Map * map, TileCoord coord)
+{
+    ASSERT(IsInBounds(map, coord.x, coord.y));
+    return GetTileChunk(map, coord.x, coord.y)->light[TileChunkIndex(coord.x, coord.y)];
+}
+
+
+/// Set every tile's light level, without allocating any chunks.
+void SetMapLight(Map * map, u8 light)
+{
+    memset(map->fill_chunk->light, light, sizeof(map->fill_chunk->light));
+    TouchTileChunk(map, map->fill_chunk);
+
+    for ( int i = 0; i < map->chunks_wide * map->chunks_high; i++ ) {
+        if ( map->chunks[i] != map->fill_chunk ) {
+            memset(map->chunks[i]->light, light, sizeof(map->chunks[i]->light));
+            TouchTileChunk(map, map->chunks[i]);
+        }
+    }
+}
+
+
+/// The tile's forest region or dungeon room. See SetRegionID().
+s32 GetRegionID(const Map * map, TileCoord coord)
+{
+    ASSERT(IsInBounds(map, coord.x, coord.y));
+    const TileChunk * chunk = GetTileChunk(map, coord.x, coord.y);
+    return chunk->region_ids[TileChunkIndex(coord.x, coord.y)];
+}
+
+
+void SetRegionID(Map * map, TileCoord coord, s32 region_id)
+{
+    ASSERT(IsInBounds(map, coord.x, coord.y));
+    TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+    chunk->region_ids[TileChunkIndex(coord.x, coord.y)] = region_id;
 }
 
 
@@ -122,7 +226,7 @@ TileCoord GetCoordinate(const Map * map, int index)
 
 
 /// Is `t2` visible from `t1`?
-bool LineOfSight(Map * map, TileCoord t1, TileCoord t2)
+bool LineOfSight(const Map * map, TileCoord t1, TileCoord t2)
 {
     int dx = abs(t2.x - t1.x);
     int dy = -abs(t2.y - t1.y);
@@ -134,13 +238,13 @@ bool LineOfSight(Map * map, TileCoord t1, TileCoord t2)
     TileCoord current = t1;
 
     while ( current.x != t2.x || current.y != t2.y ) {
-        Tile * tile = GetTile(map, current);
+        const TileFlags * flags = GetTileFlags(map, current);
 
-        if ( tile == NULL ) {
+        if ( flags == NULL ) {
             return false;
         }
 
-        if ( tile->flags.blocks_sight ) {
+        if ( flags->blocks_sight ) {
             return false;
         }
 
@@ -160,19 +264,19 @@ bool LineOfSight(Map * map, TileCoord t1, TileCoord t2)
     return true;
 }
 
-static bool HLineIsClear(Map * map, int y, int x0, int x1)
+static bool HLineIsClear(const Map * map, int y, int x0, int x1)
 {
     int x = x0;
 
     // Walk along the x axis.
     while ( x != x1 ) {
-        Tile * tile = GetTile(map, ((TileCoord){ x, y }));
-        
-        if ( tile == NULL ) {
+        const TileFlags * flags = GetTileFlags(map, ((TileCoord){ x, y }));
+
+        if ( flags == NULL ) {
             return false;
         }
 
-        if ( tile->flags.blocks_sight ) {
+        if ( flags->blocks_sight ) {
             return false;
         }
 
@@ -186,13 +290,13 @@ static bool HLineIsClear(Map * map, int y, int x0, int x1)
     return true;
 }
 
-static bool VLineIsClear(Map * map, int x, int y0, int y1)
+static bool VLineIsClear(const Map * map, int x, int y0, int y1)
 {
     int y = y0;
 
     while ( y != y1 ) {
-        Tile * tile = GetTile(map, ((TileCoord){ x, y }));
-        if ( tile->flags.blocks_sight ) {
+        const TileFlags * flags = GetTileFlags(map, ((TileCoord){ x, y }));
+        if ( flags->blocks_sight ) {
             return false;
         }
 
@@ -214,7 +318,7 @@ static bool VLineIsClear(Map * map, int x, int y0, int y1)
  . 0 * * * * .
  . . . . . . .
  */
-bool ManhattenPathsAreClear(Map * map, int x0, int y0, int x1, int y1)
+bool ManhattenPathsAreClear(const Map * map, int x0, int y0, int x1, int y1)
 {
     if ( x0 == x1 && y0 == y1 ) {
         return true;
@@ -295,7 +399,7 @@ bool TileIsAdjacentTo(const Map * map,
                       int num_directions)
 {
     for ( Direction d = 0; d < num_directions; d++ ) {
-        const Tile * check = GetAdjacentTile((Map *)map, coord, d);
+        const Tile * check = GetAdjacentTile(map, coord, d);
         if ( check->type == type ) {
             return true;
         }
@@ -307,120 +411,123 @@ bool TileIsAdjacentTo(const Map * map,
 
 #pragma mark - DISTANCE MAP
 
-typedef struct {
-    Tile * tile;
-    TileCoord coord;
-} qtile_t;
-
-static qtile_t * queue;
+static TileCoord * queue;
 static int queue_size;
-static int head, tail;
 
-static void Put(qtile_t qtile)
+void FreeDistanceMapQueue(void)
 {
-    queue[tail++] = qtile;
-
-    if ( tail > queue_size ) {
-        tail = 0;
-    }
+    free(queue);
+    queue = NULL;
+    queue_size = 0;
 }
 
-static qtile_t Get(void)
+size_t DistanceMapQueueMemoryUsage(void)
 {
-    qtile_t qtile = queue[head++];
-
-    if ( head > queue_size ) {
-        head = 0;
-    }
-
-    return qtile;
+    return queue_size * sizeof(*queue);
 }
 
-void FreeDistanceMapQueue(void)
+/// Whether tile `i` of `chunk` can be walked through, ignoring tiles of the
+/// types in `ignore_flags`. Only the flags are needed, unless there are types
+/// to ignore and the tile blocks movement.
+static inline bool IsPassable(const TileChunk * chunk, int i, int ignore_flags)
 {
-    if ( queue ) {
-        free(queue);
-    }
+    return !chunk->flags[i].blocks_movement
+        || (ignore_flags && ignore_flags & FLAG(chunk->tiles[i].type));
 }
 
-#if 1
-/// For all walkable tiles, update tile `distance` property
-/// with distance to x, y.
+/// For all walkable tiles, calculate the distance to `coord`. Unreachable
+/// tiles are set to -1.
 /// - parameter coord: The tile from which distances are calculated.
 /// - parameter ignore_flags: The tile types to be ignored, as bit flags.
-void CalculateDistances(Map * map, TileCoord coord, int ignore_flags, bool player)
+/// - parameter distances: Output. Only chunks with reachable tiles in them
+///   are allocated.
+/// - returns: The number of tiles reached.
+int CalculateDistances(const Map * map,
+                       TileCoord coord,
+                       int ignore_flags,
+                       DistancePlane * distances)
 {
-//    float start_time = ProgramTime();
+    ProfileScope scope = PROFILE_BEGIN("CalculateDistances");
 
-    for ( int i = 0; i < map->width * map->height; i++ ) {
-        if ( player ) {
-            map->tiles[i].player_distance = -1;
-        } else {
-            map->tiles[i].distance = -1;
-        }
-    }
+    ClearDistancePlane(distances, map->width, map->height);
 
-    int size_needed = map->width * map->height;
-    if ( queue_size < size_needed ) {
-        size_t new_size = size_needed * sizeof(*queue);
-        if ( queue == NULL ) {
-            queue = malloc(new_size);
-        } else {
-            queue = realloc(queue, new_size);
-        }
+    // Each tile is queued at most once, so the queue never wraps. It only
+    // grows as big as the reachable area.
+    int head = 0;
+    int tail = 0;
+
+    int width = map->width;
+    int height = map->height;
 
+    if ( queue_size == 0 ) {
+        queue_size = 1024;
+        queue = malloc(queue_size * sizeof(*queue));
         ASSERT(queue != NULL);
-        queue_size = size_needed;
     }
 
-    head = 0;
-    tail = 0;
+    SetDistance(distances, coord, 0);
+    queue[tail++] = coord;
 
-    {
-        Tile * tile = GetTile(map, coord);
-        if ( player ) {
-            tile->player_distance = 0;
-        } else {
-            tile->distance = 0;
-        }
-        qtile_t start = { tile, coord };
-        Put(start);
-    }
-
-    int num_visited = 0;
+    // The neighbors are found with offsets rather than per-direction calls:
+    // the order they're visited in doesn't change the distances.
     while ( head != tail ) {
-        num_visited++;
-        qtile_t qtile = Get();
-        int distance = player ? qtile.tile->player_distance : qtile.tile->distance;
-
-        for ( int d = 0; d < NUM_DIRECTIONS; d++ ) {
-            Tile * edge = GetAdjacentTile(map, qtile.coord, d);
-            if ( edge ) {
-                TileCoord edge_coord = AdjacentTileCoord(qtile.coord, d);
-                s16 * dist = player ? &edge->player_distance : &edge->distance;
-                
-                if ( edge == NULL ) continue; // out of bounds
-                if ( *dist != -1 ) continue; // already visited
-                
-                // This tile blocks movement and is not of a type to be ignored.
-                bool ignore = ignore_flags & FLAG(edge->type);
-                if ( edge->flags.blocks_movement && !ignore ) continue;
-                
+        TileCoord current = queue[head++];
+        int x = current.x;
+        int y = current.y;
+
+        // This tile has a distance, so its distance chunk is already current.
+        DistanceChunk * distance_chunk = GetWritableDistanceChunk(distances, x, y);
+        const TileChunk * tile_chunk = GetTileChunk(map, x, y);
+        int i = TileChunkIndex(x, y);
+        s16 distance = distance_chunk->distances[i] + 1;
+
+        // Away from the edges of its chunk, all its neighbors are in the same
+        // chunks, so they needn't be looked up.
+        int chunk_x = x & (MAP_CHUNK_SIZE - 1);
+        int chunk_y = y & (MAP_CHUNK_SIZE - 1);
+        bool interior = chunk_x > 0 && chunk_x < MAP_CHUNK_SIZE - 1
+                     && chunk_y > 0 && chunk_y < MAP_CHUNK_SIZE - 1;
+
+        for ( int dy = -1; dy <= 1; dy++ ) {
+            if ( y + dy < 0 || y + dy >= height ) continue;
+
+            for ( int dx = -1; dx <= 1; dx++ ) {
+                if ( dx == 0 && dy == 0 ) continue;
+                if ( x + dx < 0 || x + dx >= width ) continue;
+
+                TileCoord edge = { x + dx, y + dy };
+
+                if ( interior ) {
+                    int edge_i = i + dy * MAP_CHUNK_SIZE + dx;
+                    if ( distance_chunk->distances[edge_i] != -1 ) continue; // already visited
+                    if ( !IsPassable(tile_chunk, edge_i, ignore_flags) ) continue;
+                    distance_chunk->distances[edge_i] = distance;
+                } else {
+                    if ( GetDistance(distances, edge) != -1 ) continue; // already visited
+
+                    const TileChunk * edge_chunk = GetTileChunk(map, edge.x, edge.y);
+                    int edge_i = TileChunkIndex(edge.x, edge.y);
+                    if ( !IsPassable(edge_chunk, edge_i, ignore_flags) ) continue;
+
+                    // Might allocate a chunk, but not move this tile's.
+                    SetDistance(distances, edge, distance);
+                }
+
                 // Nothing blocking this tile and not yet visited:
-                *dist = distance + 1;
-                
-                qtile_t next_qtile = { edge, edge_coord };
-                Put(next_qtile);
+                if ( tail == queue_size ) {
+                    queue_size *= 2;
+                    queue = realloc(queue, queue_size * sizeof(*queue));
+                    ASSERT(queue != NULL);
+                }
+                queue[tail++] = edge;
             }
         }
     }
 
-//    printf("%s: %.2f ms (%d tiles)\n",
-//           __func__,
-//           (ProgramTime() - start_time) * 1000.0f,
-//           num_visited);
+    PROFILE_END(scope);
+    return tail;
 }
-#endif
+
 
 #if 0
 int num_visited = 0;
@@ -479,19 +586,263 @@ void CalculateDistances2(Map * map, TileCoord coord, int ignore_flags)
 #endif
 
 
-void AllocateMapTiles(Map * map, int width, int height, TileType fill)
+void FreeMapTiles(Map * map)
+{
+    if ( map->chunks ) {
+        for ( int i = 0; i < map->chunks_wide * map->chunks_high; i++ ) {
+            if ( map->chunks[i] != map->fill_chunk ) {
+                free(map->chunks[i]);
+            }
+        }
+
+        free(map->chunks);
+        map->chunks = NULL;
+    }
+
+    free(map->fill_chunk);
+    map->fill_chunk = NULL;
+    map->num_chunks_allocated = 0;
+}
+
+
+static u32 NextGeneration(void)
+{
+    // Generations are unique across all maps, so a (map, generation) pair
+    // can't be confused with a previous level loaded into the same map. Maps
+    // are also generated on the pregen thread, hence atomic.
+    static SDL_atomic_t next_generation;
+    return (u32)SDL_AtomicAdd(&next_generation, 1) + 1;
+}
+
+
+/// Reallocate the map's tile chunks. Every tile starts out as the fill chunk's,
+/// which is cleared to zero.
+void ResizeMap(Map * map, int width, int height)
 {
+    FreeMapTiles(map);
+
     map->width = width;
     map->height = height;
+    map->chunks_wide = ChunksToCover(width);
+    map->chunks_high = ChunksToCover(height);
+
+    int num_chunks = map->chunks_wide * map->chunks_high;
+    map->chunks = malloc(num_chunks * sizeof(*map->chunks));
+    map->fill_chunk = calloc(1, sizeof(*map->fill_chunk));
+    if ( map->chunks == NULL || map->fill_chunk == NULL ) {
+        Error("Could not allocate map tiles");
+    }
+
+    for ( int i = 0; i < num_chunks; i++ ) {
+        map->chunks[i] = map->fill_chunk;
+    }
+
+    // Each allocation's stamps start past any earlier map's, so the tile cache
+    // can't mistake a level swapped into this map for the previous one.
+    map->draw_stamp = (u64)NextGeneration() << 32;
+    TouchTileChunk(map, map->fill_chunk);
+
+    ResizeActorGrid(&map->actor_list, width, height);
+    ResetLightMap(&map->light_map);
+}
+
+
+/// Reallocate the map's tiles, all as a new tile of type `fill`. Only the
+/// chunks that are then written to take up memory of their own.
+void AllocateMapTiles(Map * map, int width, int height, TileType fill)
+{
+    ResizeMap(map, width, height);
+
+    TileChunk * chunk = map->fill_chunk;
+    for ( int i = 0; i < MAP_CHUNK_AREA; i++ ) {
+        chunk->tiles[i] = CreateTile(fill);
+        chunk->flags[i] = TileTypeFlags(fill);
+    }
+
+    MapChanged(map);
+}
+
+
+/// Set the region ID and revealed flag of the tiles that haven't been written
+/// to since AllocateMapTiles().
+void SetMapFill(Map * map, s32 region_id, bool revealed)
+{
+    ASSERT(map->num_chunks_allocated == 0);
+
+    TileChunk * chunk = map->fill_chunk;
+    for ( int i = 0; i < MAP_CHUNK_AREA; i++ ) {
+        chunk->region_ids[i] = region_id;
+        chunk->flags[i].revealed = revealed;
+    }
+
+    TouchTileChunk(map, chunk);
+}
 
-    if ( map->tiles ) {
-        free(map->tiles);
+
+size_t MapMemoryUsage(const Map * map)
+{
+    size_t tiles = 0;
+    if ( map->chunks ) {
+        tiles = map->chunks_wide * map->chunks_high * sizeof(*map->chunks)
+            + (map->num_chunks_allocated + 1) * sizeof(TileChunk);
     }
 
-    int size = width * height;
-    map->tiles = calloc(size, sizeof(map->tiles[0]));
+    const LightMap * light_map = &map->light_map;
+
+    return tiles
+        + light_map->lights_capacity * sizeof(*light_map->lights)
+        + DistancePlaneMemoryUsage(&map->player_distances.distances)
+        + ActorGridMemoryUsage(&map->actor_list)
+        + ActorPoolMemoryUsage(&map->actor_list);
+}
+
+
+size_t SharedMapMemoryUsage(void)
+{
+    return FlowFieldMemoryUsage()
+        + DistanceMapBuffersMemoryUsage()
+        + DistanceMapQueueMemoryUsage()
+        + PathNodesMemoryUsage()
+        + LightContributionsMemoryUsage();
+}
+
+
+/// A tile's wall signature depends only on its neighbors, so update those
+/// after the tile at `coord` changes. Chunks without valid signatures work
+/// them out when asked.
+static void UpdateAdjacentWallSignatures(Map * map, TileCoord coord)
+{
+    for ( Direction d = 0; d < NUM_DIRECTIONS; d++ ) {
+        TileCoord adjacent = AdjacentTileCoord(coord, d);
+        if ( !IsInBounds(map, adjacent.x, adjacent.y) ) {
+            continue;
+        }
+
+        TileChunk * chunk = map->chunks[(adjacent.y >> MAP_CHUNK_SHIFT) * map->chunks_wide
+                                        + (adjacent.x >> MAP_CHUNK_SHIFT)];
+        if ( chunk->signatures_valid ) {
+            int i = TileChunkIndex(adjacent.x, adjacent.y);
+            chunk->wall_signatures[i] = CalculateWallSignature(map, adjacent, false);
+        }
+    }
+}
+
+
+/// Call after generating or otherwise changing the whole map. Caches the wall
+/// signatures of every allocated chunk; the fill chunk's tiles have theirs
+/// calculated when needed.
+void MapChanged(Map * map)
+{
+    map->generation = NextGeneration();
+    map->sight_generation = map->generation;
+
+    for ( int cy = 0; cy < map->chunks_high; cy++ ) {
+        for ( int cx = 0; cx < map->chunks_wide; cx++ ) {
+            TileChunk * chunk = map->chunks[cy * map->chunks_wide + cx];
+            if ( chunk == map->fill_chunk ) {
+                continue;
+            }
+
+            int x0 = cx * MAP_CHUNK_SIZE;
+            int y0 = cy * MAP_CHUNK_SIZE;
+            int x1 = MIN(x0 + MAP_CHUNK_SIZE, map->width);
+            int y1 = MIN(y0 + MAP_CHUNK_SIZE, map->height);
+
+            TileCoord coord;
+            for ( coord.y = y0; coord.y < y1; coord.y++ ) {
+                for ( coord.x = x0; coord.x < x1; coord.x++ ) {
+                    int i = TileChunkIndex(coord.x, coord.y);
+                    chunk->wall_signatures[i] = CalculateWallSignature(map, coord, false);
+                }
+            }
+
+            chunk->signatures_valid = true;
+        }
+    }
+}
+
+
+/// A tile's variety is a hash of its position and the level's seed, so it
+/// doesn't draw from any random number generator, a level looks the same
+/// however it was generated, and it needn't be stored.
+u8 TileVariety(const Map * map, TileCoord coord)
+{
+    u32 hash = map->seed ^ ((u32)coord.x * 0x9E3779B1u) ^ ((u32)coord.y * 0x85EBCA77u);
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    hash *= 0x297A2D39u;
+    hash ^= hash >> 15;
+
+    return hash >> 24;
+}
+
+
+/// Replace the tile at `coord` with a new tile of `type`, resetting all of
+/// its data. Used during level generation, see ChangeTile().
+void SetTile(Map * map, TileCoord coord, TileType type)
+{
+    ASSERT(IsInBounds(map, coord.x, coord.y));
+    TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+    int i = TileChunkIndex(coord.x, coord.y);
+
+    chunk->tiles[i] = CreateTile(type);
+    chunk->flags[i] = TileTypeFlags(type);
+    chunk->region_ids[i] = 0;
+    TouchTileChunk(map, chunk);
+}
+
+
+/// Replace the tile at `coord` with a new tile of `type`. Use this, rather than
+/// SetTile(), for any change to the map during play.
+void ChangeTile(Map * map, TileCoord coord, TileType type)
+{
+    TileFlags * flags = GetTileFlags(map, coord);
+    ASSERT(flags != NULL);
+
+    u32 old_generation = map->generation;
+    bool blocked_sight = flags->blocks_sight;
+
+    SetTile(map, coord, type);
+
+    map->generation = NextGeneration();
+    if ( flags->blocks_sight != blocked_sight ) {
+        map->sight_generation = map->generation;
+    }
+
+    UpdateAdjacentWallSignatures(map, coord);
+    DistanceMapTileChanged(&map->player_distances, map, coord, old_generation);
+}
+
+
+/// Set the tile at `coord` as revealed. Use this, rather than setting the flag
+/// directly, during play.
+void SetTileRevealed(Map * map, TileCoord coord)
+{
+    const TileFlags * flags = GetTileFlags((const Map *)map, coord);
+    ASSERT(flags != NULL);
+
+    // Only write tiles that change, so revealing an already-revealed area
+    // doesn't allocate its chunks.
+    if ( !flags->revealed ) {
+        TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+        chunk->flags[TileChunkIndex(coord.x, coord.y)].revealed = true;
+        TouchTileChunk(map, chunk);
+        UpdateAdjacentWallSignatures(map, coord);
+    }
+}
+
+
+/// Set whether the tile at `coord` is in view. Like SetTileRevealed(), only
+/// writes the tile if it changes.
+void SetTileVisible(Map * map, TileCoord coord, bool visible)
+{
+    const TileFlags * flags = GetTileFlags((const Map *)map, coord);
+    ASSERT(flags != NULL);
 
-    for ( int i = 0; i < size; i++ ) {
-        map->tiles[i] = CreateTile(fill);
+    if ( flags->visible != visible ) {
+        TileChunk * chunk = GetWritableTileChunk(map, coord.x, coord.y);
+        chunk->flags[TileChunkIndex(coord.x, coord.y)].visible = visible;
+        TouchTileChunk(map, chunk);
     }
 }
@@ -13,44 +13,129 @@
 #include "coord.h"
 #include "direction.h"
 #include "actor_list.h"
+#include "distance_map.h"
+#include "light_map.h"
 
 #include "mathlib.h"
 
 #define MAX_ROOMS 64
+#define MAP_MAX_SIZE 4096 // Width or height. Tile coordinates are s16.
 
+/// The tile planes for a square of the map, one entry per tile in each,
+/// indexed by TileChunkIndex().
 typedef struct {
+    Tile tiles[MAP_CHUNK_AREA];
+    TileFlags flags[MAP_CHUNK_AREA];
+    s32 region_ids[MAP_CHUNK_AREA]; // Forest region, or dungeon room (-1 if none).
+    TileID tile_ids[MAP_CHUNK_AREA]; // Dungeon generation's region labels.
+    u8 wall_signatures[MAP_CHUNK_AREA]; // Cached CalculateWallSignature(), not ignoring reveal.
+    u8 light[MAP_CHUNK_AREA]; // See LightMap.
+    bool signatures_valid; // Whether `wall_signatures` is up to date. See MapChanged().
+    u64 draw_stamp; // The map's `draw_stamp` when a tile in it last changed how it's drawn.
+} TileChunk;
+
+typedef struct map {
     int width;
     int height;
+    u32 generation; // Changes whenever tiles are changed. See MapChanged().
+    u32 sight_generation; // Changes whenever tiles change blocking sight.
+    u32 seed; // The level's seed, which tile variety is derived from.
+    u64 draw_stamp; // Bumped whenever a tile changes how it's drawn. See TouchTileChunk().
 
     ActorList actor_list;
-    Tile * tiles;
-    TileID * tile_ids;
+
+    // Tile data, in chunks of MAP_CHUNK_SIZE x MAP_CHUNK_SIZE tiles. Chunks
+    // that haven't been written to all share `fill_chunk`, which holds the
+    // tile the map was allocated with, and get a copy of their own the first
+    // time a tile in them is written; getting a tile or its flags through a
+    // non-const map counts as writing. Tile types only change via SetTile()
+    // and ChangeTile(). Once a level is generated, tiles change only through
+    // the setters, which keep each chunk's `draw_stamp`.
+    TileChunk ** chunks;
+    TileChunk * fill_chunk;
+    int chunks_wide;
+    int chunks_high;
+    int num_chunks_allocated;
+
+    DistanceMap player_distances; // Plane of distances to the player.
+    LightMap light_map; // Lights for the light levels in `chunks`.
 
     int num_rooms;
     SDL_Rect rooms[MAX_ROOMS];
     int gold_key_room_num;
 } Map;
 
-Tile * GetAdjacentTile(Map * map, TileCoord coord, Direction direction);
+/// The chunk holding tile (`x`, `y`), which must be in bounds. Might be the
+/// map's fill chunk, so only for reading.
+static inline const TileChunk * GetTileChunk(const Map * map, int x, int y)
+{
+    return map->chunks[(y >> MAP_CHUNK_SHIFT) * map->chunks_wide + (x >> MAP_CHUNK_SHIFT)];
+}
+
+/// The chunk holding tile (`x`, `y`), allocating it if it's still the fill
+/// chunk.
+TileChunk * GetWritableTileChunk(Map * map, int x, int y);
+
+/// Note that a tile in `chunk` changed type, light level or reveal state, so
+/// the tile cache redraws the chunks showing it and its neighbors' walls.
+static inline void TouchTileChunk(Map * map, TileChunk * chunk)
+{
+    chunk->draw_stamp = ++map->draw_stamp;
+}
+
+const Tile * GetAdjacentTile(const Map * map, TileCoord coord, Direction direction);
 
 TileCoord GetCoordinate(const Map * map, int index);
 Box GetCameraVisibleRegion(const Map * map, const RenderInfo * render_info);
 Box GetPlayerVisibleRegion(const Map * map, TileCoord player_coord);
 bool IsInBounds(const Map * map, int x, int y);
-bool LineOfSight(Map * map, TileCoord t1, TileCoord t2);
-void CalculateDistances(Map * map, TileCoord coord, int ignore_flags, bool player);
-bool ManhattenPathsAreClear(Map * map, int x0, int y0, int x1, int y1);
+bool LineOfSight(const Map * map, TileCoord t1, TileCoord t2);
+int CalculateDistances(const Map * map,
+                       TileCoord coord,
+                       int ignore_flags,
+                       DistancePlane * distances);
+bool ManhattenPathsAreClear(const Map * map, int x0, int y0, int x1, int y1);
 void FreeDistanceMapQueue(void);
+size_t DistanceMapQueueMemoryUsage(void);
 bool TileIsAdjacentTo(const Map * map, TileCoord coord, TileType type, int num_directions);
 int CalculateWallSignature(const Map * map, TileCoord coord, bool ignore_reveal);
+u8 GetWallSignature(const Map * map, TileCoord coord);
+u8 TileVariety(const Map * map, TileCoord coord);
+void ResizeMap(Map * map, int width, int height);
 void AllocateMapTiles(Map * map, int width, int height, TileType fill);
+void SetMapFill(Map * map, s32 region_id, bool revealed);
+void FreeMapTiles(Map * map);
+
+/// Bytes allocated for the map's tile chunks, actor grid, lights, player
+/// distances, and actors.
+size_t MapMemoryUsage(const Map * map);
+
+/// Bytes allocated for the buffers and caches shared by all maps: flow
+/// fields, distance and path finding work buffers, and light contributions.
+size_t SharedMapMemoryUsage(void);
+void MapChanged(Map * map);
+void SetTile(Map * map, TileCoord coord, TileType type);
+void ChangeTile(Map * map, TileCoord coord, TileType type);
+void SetTileRevealed(Map * map, TileCoord coord);
+void SetTileVisible(Map * map, TileCoord coord, bool visible);
 
 #define GetTile(map, coord) _Generic((map), \
     const Map *: GetTileConst,              \
     Map *: GetTileNonConst                  \
 )(map, coord)
 
+#define GetTileFlags(map, coord) _Generic((map), \
+    const Map *: GetTileFlagsConst,              \
+    Map *: GetTileFlagsNonConst                  \
+)(map, coord)
+
 Tile * GetTileNonConst(Map * map, TileCoord coord);
 const Tile * GetTileConst(const Map * map, TileCoord coord);
+TileFlags * GetTileFlagsNonConst(Map * map, TileCoord coord);
+const TileFlags * GetTileFlagsConst(const Map * map, TileCoord coord);
+u8 GetTileLight(const Map * map, TileCoord coord);
+void SetMapLight(Map * map, u8 light);
+s32 GetRegionID(const Map * map, TileCoord coord);
+void SetRegionID(Map * map, TileCoord coord, s32 region_id);
 
 #endif /* map_h */
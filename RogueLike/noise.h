@@ -0,0 +1,48 @@
+//
+//  noise.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/12/23.
+//
+//  Fractal gradient noise for level generation. Each Noise has its own
+//  permutation table, so any number can be in use at once on any thread.
+//  FractalNoiseRow() evaluates several tiles at a time and gives exactly the
+//  same values as FractalNoise() one tile at a time.
+//
+//  This replaced mathlib's Noise2 for forests, so a seed no longer makes the
+//  same forest it did before. The terrain proportions are unchanged.
+//
+
+#ifndef noise_h
+#define noise_h
+
+#include "shorttypes.h"
+
+#define NOISE_PERIOD 256
+
+typedef struct {
+    u8 perm[NOISE_PERIOD * 2]; // A shuffle of 0-255, twice.
+} Noise;
+
+typedef struct {
+    float frequency;
+    int octaves;
+    float amplitude;
+    float persistence; // Amplitude multiplier per octave.
+    float lacunarity; // Frequency multiplier per octave.
+} NoiseParams;
+
+void SeedNoise(Noise * noise, u64 seed, u64 stream);
+
+/// Noise at `x`, `y`, from -1 to 1.
+float FractalNoise(const Noise * noise, const NoiseParams * params, float x, float y);
+
+/// Noise at each integer `x` from `x0` to `x0 + count - 1` on row `y`.
+void FractalNoiseRow(const Noise * noise,
+                     const NoiseParams * params,
+                     int y,
+                     int x0,
+                     int count,
+                     float * out);
+
+#endif /* noise_h */
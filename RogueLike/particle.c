@@ -7,6 +7,7 @@
 
 #include "particle.h"
 #include "video.h"
+#include "sprite_batch.h"
 
 void InitParticleArray(ParticleArray * array)
 {
@@ -60,7 +61,6 @@ void RenderParticles(const ParticleArray * array, int draw_scale, vec2_t offset)
         r.x = p->position.x * draw_scale - draw_scale / 2 - offset.x;
         r.y = p->position.y * draw_scale - draw_scale / 2 - offset.y;
 
-        V_SetColor(p->color);
-        V_FillRect(&r);
+        BatchRect(&r, p->color);
     }
 }
@@ -28,6 +28,7 @@ typedef struct {
 void InitParticleArray(ParticleArray * array);
 void InsertParticle(ParticleArray * array, Particle particle);
 void UpdateParticles(ParticleArray * array, float dt);
+/// Batched: call FlushSprites() when done drawing.
 void RenderParticles(const ParticleArray * array, int draw_scale, vec2_t offset);
 
 #endif /* particle_h */
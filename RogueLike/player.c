@@ -7,42 +7,39 @@
 
 #include "game.h"
 #include "sound.h"
+#include "fov.h"
 
 
 void RevealTile(Map * map, TileCoord coord)
 {
-    Tile * tile = GetTile(map, coord);
-
-    tile->flags.visible = true;
-    tile->flags.revealed = true;
+    SetTileVisible(map, coord, true);
+    SetTileRevealed(map, coord);
 
     // Also reveals tiles adjacent to floors.
-    if ( !tile->flags.blocks_movement ) {
+    if ( !GetTileFlags((const Map *)map, coord)->blocks_movement ) {
         for ( Direction d = 0; d < NUM_DIRECTIONS; d++ ) {
-            Tile * adj = GetAdjacentTile(map, coord, d);
-            if ( adj ) {
-                adj->flags.visible = true;
-                adj->flags.revealed = true;
+            TileCoord adj_coord = AdjacentTileCoord(coord, d);
+            if ( IsInBounds(map, adj_coord.x, adj_coord.y) ) {
+                SetTileVisible(map, adj_coord, true);
+                SetTileRevealed(map, adj_coord);
             }
         }
     }
 }
 
 
-/// Reveal and set tiles visible if LOS to player.
+/// Reveal and set tiles visible if in the player's field of view.
 void PlayerCastSight(World * world, const RenderInfo * render_info)
 {
+    ProfileScope scope = PROFILE_BEGIN("PlayerCastSight");
+
     const Actor * player = FindActor(&world->map->actor_list, ACTOR_PLAYER);
     Box vis = GetPlayerVisibleRegion(world->map, player->tile);
 
-    TileCoord coord;
-    for ( coord.y = vis.top; coord.y <= vis.bottom; coord.y++ ) {
-        for ( coord.x = vis.left; coord.x <= vis.right; coord.x++ ) {
-            if ( LineOfSight(world->map, player->tile, coord) ) {
-                RevealTile(world->map, coord);
-            }
-        }
-    }
+    CastFieldOfView(world->map, player->tile, vis, RevealTile);
+    InvalidateLightMap(&world->map->light_map);
+
+    PROFILE_END(scope);
 }
 
 
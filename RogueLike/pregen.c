@@ -0,0 +1,104 @@
+//
+//  pregen.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/11/23.
+//
+
+#include "pregen.h"
+#include "genlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static Map spare_maps[MAX_MAPS];
+static LevelGen pending; // Valid while `thread` is running or `ready`.
+static SDL_Thread * thread;
+static bool ready;
+
+static int GenerateInBackground(void * data)
+{
+    GenerateLevel(&pending);
+    return 0;
+}
+
+
+static void WaitForPregen(void)
+{
+    if ( thread ) {
+        SDL_WaitThread(thread, NULL);
+        thread = NULL;
+        ready = true;
+    }
+}
+
+
+void PregenerateLevel(Game * game, int level_num)
+{
+    // Levels generated while watching map generation need the main thread.
+    if ( show_map_gen ) {
+        return;
+    }
+
+    WaitForPregen();
+    ready = false;
+
+    int seed = LevelSeed(game, level_num);
+    InitLevelGenForLevel(&pending, game, spare_maps, level_num, seed);
+
+    thread = SDL_CreateThread(GenerateInBackground, "pregen", NULL);
+    if ( thread == NULL ) {
+        printf("could not start level pregen: %s\n", SDL_GetError());
+    }
+}
+
+
+bool TakePregeneratedLevel(Game * game, const LevelGen * wanted)
+{
+    WaitForPregen();
+
+    if ( !ready
+        || pending.seed != wanted->seed
+        || pending.area != wanted->area
+        || pending.width != wanted->width
+        || pending.height != wanted->height
+        || pending.forest_freq != wanted->forest_freq
+        || pending.forest_amp != wanted->forest_amp
+        || pending.forest_pers != wanted->forest_pers
+        || pending.forest_lec != wanted->forest_lec
+        || pending.forest_low != wanted->forest_low
+        || pending.forest_high != wanted->forest_high )
+    {
+        return false;
+    }
+
+    // The previous level's maps become the spare ones, to be reused by the
+    // next pregen.
+    World * world = &game->world;
+    for ( int i = 0; i < MAX_MAPS; i++ ) {
+        Map swap = world->maps[i];
+        world->maps[i] = spare_maps[i];
+        spare_maps[i] = swap;
+    }
+
+    world->area = pending.area;
+    world->info = &area_info[pending.area];
+    world->map = &world->maps[0];
+    ready = false;
+
+    return true;
+}
+
+
+void FreePregen(void)
+{
+    WaitForPregen();
+    ready = false;
+
+    for ( int i = 0; i < MAX_MAPS; i++ ) {
+        DestroyActorList(&spare_maps[i].actor_list);
+        FreeDistanceMap(&spare_maps[i].player_distances);
+        FreeLightMap(&spare_maps[i].light_map);
+        FreeMapTiles(&spare_maps[i]);
+    }
+}
@@ -0,0 +1,29 @@
+//
+//  pregen.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/11/23.
+//
+//  Background level generation. While a level is being played, the next one is
+//  generated on a worker thread into a spare set of maps, which are swapped
+//  with the world's when the player gets there.
+//
+
+#ifndef pregen_h
+#define pregen_h
+
+#include "game.h"
+
+/// Start generating level `level_num` in the background, after waiting for
+/// any level already being generated.
+void PregenerateLevel(Game * game, int level_num);
+
+/// If the pregenerated level matches `wanted`, swap it into the world and make
+/// it the current map. Waits for it to finish first.
+/// - returns: False if there's no matching level, in which case the world is
+///   unchanged.
+bool TakePregeneratedLevel(Game * game, const LevelGen * wanted);
+
+void FreePregen(void);
+
+#endif /* pregen_h */
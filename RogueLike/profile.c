@@ -0,0 +1,238 @@
+//
+//  profile.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/13/23.
+//
+//  Each thread that records a scope gets a buffer, kept in thread-local
+//  storage. When the thread exits its buffer goes back to the pool, recorded
+//  scopes and all, so the noise fill's short-lived workers share a few buffers
+//  (and a few rows in the trace) instead of using up a new one each level.
+//
+
+#include "profile.h"
+#include "genlib.h"
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROFILE_RING_SIZE 65536 // Per thread. Must be a power of two.
+#define MAX_PROFILE_THREADS 32
+
+typedef struct {
+    const char * name;
+    u64 start;
+    u64 end;
+} ProfileEvent;
+
+typedef struct {
+    SDL_SpinLock lock; // Between its thread and WriteTrace.
+    bool is_main_thread;
+    u64 num_events; // Ever recorded. The ring holds the latest.
+    ProfileEvent events[PROFILE_RING_SIZE];
+} ProfileBuffer;
+
+atomic_bool profiling;
+
+static SDL_TLSID buffer_tls;
+static SDL_threadID main_thread;
+static u64 trace_start;
+
+static SDL_SpinLock buffers_lock;
+static ProfileBuffer * buffers[MAX_PROFILE_THREADS];
+static bool buffer_in_use[MAX_PROFILE_THREADS];
+static int num_buffers;
+
+/// Called when a thread with a buffer exits.
+static void ReleaseBuffer(void * data)
+{
+    SDL_AtomicLock(&buffers_lock);
+
+    for ( int i = 0; i < num_buffers; i++ ) {
+        if ( buffers[i] == data ) {
+            buffer_in_use[i] = false;
+        }
+    }
+
+    SDL_AtomicUnlock(&buffers_lock);
+}
+
+
+/// - returns: NULL if all buffers are in use.
+static ProfileBuffer * ThreadBuffer(void)
+{
+    ProfileBuffer * buffer = SDL_TLSGet(buffer_tls);
+    if ( buffer ) {
+        return buffer;
+    }
+
+    SDL_AtomicLock(&buffers_lock);
+
+    for ( int i = 0; i < num_buffers; i++ ) {
+        if ( !buffer_in_use[i] ) {
+            buffer = buffers[i];
+            buffer_in_use[i] = true;
+            break;
+        }
+    }
+
+    if ( buffer == NULL && num_buffers < MAX_PROFILE_THREADS ) {
+        buffer = calloc(1, sizeof(*buffer));
+        if ( buffer == NULL ) {
+            Error("could not allocate profile buffer");
+        }
+
+        buffers[num_buffers] = buffer;
+        buffer_in_use[num_buffers] = true;
+        num_buffers++;
+    }
+
+    if ( buffer ) {
+        buffer->is_main_thread = SDL_ThreadID() == main_thread;
+    }
+
+    SDL_AtomicUnlock(&buffers_lock);
+
+    if ( buffer ) {
+        SDL_TLSSet(buffer_tls, buffer, ReleaseBuffer);
+    }
+
+    return buffer;
+}
+
+
+ProfileScope StartProfileScope(const char * name)
+{
+    return (ProfileScope){ name, SDL_GetPerformanceCounter() };
+}
+
+
+void FinishProfileScope(const ProfileScope * scope)
+{
+    u64 end = SDL_GetPerformanceCounter();
+    ProfileBuffer * buffer = ThreadBuffer();
+    if ( buffer == NULL ) {
+        return;
+    }
+
+    SDL_AtomicLock(&buffer->lock);
+
+    u64 index = buffer->num_events++ & (PROFILE_RING_SIZE - 1);
+    buffer->events[index] = (ProfileEvent){ scope->name, scope->start, end };
+
+    SDL_AtomicUnlock(&buffer->lock);
+}
+
+
+void StartProfiling(void)
+{
+    if ( buffer_tls == 0 ) {
+        buffer_tls = SDL_TLSCreate();
+    }
+
+    main_thread = SDL_ThreadID();
+
+    SDL_AtomicLock(&buffers_lock);
+
+    for ( int i = 0; i < num_buffers; i++ ) {
+        SDL_AtomicLock(&buffers[i]->lock);
+        buffers[i]->num_events = 0;
+        SDL_AtomicUnlock(&buffers[i]->lock);
+    }
+
+    trace_start = SDL_GetPerformanceCounter();
+
+    SDL_AtomicUnlock(&buffers_lock);
+
+    atomic_store(&profiling, true);
+    printf("profiling started\n");
+}
+
+
+void StopProfiling(void)
+{
+    atomic_store(&profiling, false);
+}
+
+
+bool WriteTrace(const char * path)
+{
+    FILE * file = fopen(path, "w");
+    if ( file == NULL ) {
+        return false;
+    }
+
+    double usec_per_count = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+    int num_events = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    SDL_AtomicLock(&buffers_lock);
+
+    for ( int i = 0; i < num_buffers; i++ ) {
+        ProfileBuffer * buffer = buffers[i];
+        SDL_AtomicLock(&buffer->lock);
+
+        fprintf(file,
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s %d\"}}",
+                i == 0 ? "" : ",\n",
+                i,
+                buffer->is_main_thread ? "main" : "worker",
+                i);
+
+        // The oldest events have been overwritten if the ring is full.
+        u64 first = 0;
+        if ( buffer->num_events > PROFILE_RING_SIZE ) {
+            first = buffer->num_events - PROFILE_RING_SIZE;
+        }
+
+        for ( u64 e = first; e < buffer->num_events; e++ ) {
+            const ProfileEvent * event = &buffer->events[e & (PROFILE_RING_SIZE - 1)];
+
+            // Began before profiling was last started.
+            if ( event->start < trace_start ) {
+                continue;
+            }
+
+            fprintf(file,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name,
+                    i,
+                    (event->start - trace_start) * usec_per_count,
+                    (event->end - event->start) * usec_per_count);
+            num_events++;
+        }
+
+        SDL_AtomicUnlock(&buffer->lock);
+    }
+
+    SDL_AtomicUnlock(&buffers_lock);
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("wrote %d profile scopes to %s\n", num_events, path);
+
+    return true;
+}
+
+
+void FreeProfiler(void)
+{
+    StopProfiling();
+
+    SDL_AtomicLock(&buffers_lock);
+
+    for ( int i = 0; i < num_buffers; i++ ) {
+        free(buffers[i]);
+        buffers[i] = NULL;
+        buffer_in_use[i] = false;
+    }
+
+    num_buffers = 0;
+
+    SDL_AtomicUnlock(&buffers_lock);
+}
@@ -0,0 +1,63 @@
+//
+//  profile.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/13/23.
+//
+//  Profiling scopes, for finding out where a frame or turn went. While
+//  profiling is on, each scope's start and end time are kept in a ring buffer
+//  for the thread it ran on, and can be written out as a Chrome trace (open it
+//  in chrome://tracing or ui.perfetto.dev), where scopes show nested by thread.
+//  While it's off, a scope costs a load and a branch.
+//
+//  ProfileScope scope = PROFILE_BEGIN("Thing");
+//  DoThing();
+//  PROFILE_END(scope);
+//
+//  Scope names must be strings that last until the trace is written, such as
+//  literals or actor names.
+//
+
+#ifndef profile_h
+#define profile_h
+
+#include "shorttypes.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+typedef struct {
+    const char * name; // NULL if profiling was off when the scope began.
+    u64 start;
+} ProfileScope;
+
+#define DEFAULT_TRACE_FILE "trace.json"
+
+extern atomic_bool profiling;
+
+#define PROFILE_BEGIN(name) \
+    (atomic_load_explicit(&profiling, memory_order_relaxed) \
+        ? StartProfileScope(name) \
+        : (ProfileScope){ NULL, 0 })
+
+#define PROFILE_END(scope) \
+    do { \
+        if ( (scope).name ) { \
+            FinishProfileScope(&(scope)); \
+        } \
+    } while ( 0 )
+
+ProfileScope StartProfileScope(const char * name);
+void FinishProfileScope(const ProfileScope * scope);
+
+/// Clear any recorded scopes and start recording.
+void StartProfiling(void);
+void StopProfiling(void);
+
+/// Write the recorded scopes as a Chrome trace event JSON file.
+/// - returns: False if the file couldn't be written.
+bool WriteTrace(const char * path);
+
+void FreeProfiler(void);
+
+#endif /* profile_h */
@@ -58,12 +58,15 @@ static SDL_Texture * CreateForestBackgroundTexture(int width, int height)
     V_SetColor(area_info[AREA_FOREST].render_clear_color);
     V_Clear();
 
+    // The same sky every time.
+    Rng rng = SeedRng(0, RNG_STARS);
+
     for ( int i = 0; i < 5000; i++ ) {
         SDL_Point pt;
-        pt.x = Random(0, width - 1);
-        pt.y = Random(0, height - 1);
+        pt.x = RngInt(&rng, 0, width - 1);
+        pt.y = RngInt(&rng, 0, height - 1);
 
-        int n = Random(0, 1000);
+        int n = RngInt(&rng, 0, 1000);
         if ( n == 1000 ) {
             V_SetRGB(0, 248, 0);
         } else if ( n < 500 ) {
@@ -155,6 +158,11 @@ RenderInfo InitRenderInfo(int width, int height)
 
     info.inventory_x = width; // Start closed.
 
+    // No assets when running headless.
+    if ( renderer == NULL ) {
+        return info;
+    }
+
     info.stars = CreateForestBackgroundTexture(width, height);
 
     info.actor_texture = LoadTexture("assets/actors.png");
@@ -0,0 +1,318 @@
+//
+//  replay.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/13/23.
+//
+//  File format, all numbers little endian:
+//
+//  "RLRP", version (u32), master seed (u64), forest size (s32), forest seed
+//  (s32), then four bytes per command to the end of the file: type, direction
+//  and wait ticks (u16).
+//
+
+#include "replay.h"
+#include "debug.h"
+#include "frame_stats.h"
+#include "genlib.h"
+#include "mathlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_MAGIC "RLRP"
+#define REPLAY_VERSION 1
+
+static const char * record_path;
+static FILE * record_file;
+static int last_command_tick;
+
+static bool replaying;
+static bool replay_paced;
+static Recording replay;
+static int next_command;
+
+// Stats for the summary at the end of a replay.
+static int replay_frames;
+static float replay_start;
+static float total_frame_msec;
+static float max_replay_frame_msec;
+
+#pragma mark - Writing
+
+static void WriteU32(FILE * file, u32 value)
+{
+    u8 bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    fwrite(bytes, sizeof(bytes), 1, file);
+}
+
+
+static void WriteU64(FILE * file, u64 value)
+{
+    WriteU32(file, (u32)value);
+    WriteU32(file, (u32)(value >> 32));
+}
+
+
+void StartRecording(const char * path)
+{
+    record_path = path;
+}
+
+
+void RecordNewGame(const Game * game)
+{
+    if ( record_path == NULL || replaying ) {
+        return;
+    }
+
+    if ( record_file ) {
+        fclose(record_file);
+    }
+
+    record_file = fopen(record_path, "wb");
+    if ( record_file == NULL ) {
+        printf("could not open %s for recording\n", record_path);
+        record_path = NULL;
+        return;
+    }
+
+    fwrite(REPLAY_MAGIC, 4, 1, record_file);
+    WriteU32(record_file, REPLAY_VERSION);
+    WriteU64(record_file, game->master_seed);
+    WriteU32(record_file, (u32)game->forest_size);
+    WriteU32(record_file, (u32)game->forest_seed);
+    fflush(record_file);
+
+    last_command_tick = game->ticks;
+    printf("recording to %s\n", record_path);
+}
+
+
+void RecordCommand(const Game * game, Command command)
+{
+    if ( record_file == NULL ) {
+        return;
+    }
+
+    int wait = MIN(game->ticks - last_command_tick, UINT16_MAX);
+    last_command_tick = game->ticks;
+
+    u8 bytes[4] = { command.type, command.direction, wait, wait >> 8 };
+    fwrite(bytes, sizeof(bytes), 1, record_file);
+
+    // Keep what's been recorded so far if the game crashes.
+    fflush(record_file);
+}
+
+
+#pragma mark - Reading
+
+static bool ReadU32(FILE * file, u32 * value)
+{
+    u8 b[4];
+    if ( fread(b, sizeof(b), 1, file) != 1 ) {
+        return false;
+    }
+
+    *value = b[0] | b[1] << 8 | b[2] << 16 | (u32)b[3] << 24;
+    return true;
+}
+
+
+static bool ReadU64(FILE * file, u64 * value)
+{
+    u32 low, high;
+    if ( !ReadU32(file, &low) || !ReadU32(file, &high) ) {
+        return false;
+    }
+
+    *value = (u64)high << 32 | low;
+    return true;
+}
+
+
+bool LoadRecording(Recording * recording, const char * path)
+{
+    *recording = (Recording){ 0 };
+
+    FILE * file = fopen(path, "rb");
+    if ( file == NULL ) {
+        return false;
+    }
+
+    char magic[4];
+    u32 version, forest_size, forest_seed;
+
+    if ( fread(magic, sizeof(magic), 1, file) != 1
+        || memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0
+        || !ReadU32(file, &version)
+        || version != REPLAY_VERSION
+        || !ReadU64(file, &recording->master_seed)
+        || !ReadU32(file, &forest_size)
+        || !ReadU32(file, &forest_seed) )
+    {
+        fclose(file);
+        return false;
+    }
+
+    recording->forest_size = (int)forest_size;
+    recording->forest_seed = (int)forest_seed;
+
+    int capacity = 0;
+    u8 bytes[4];
+
+    while ( fread(bytes, sizeof(bytes), 1, file) == 1 ) {
+        if ( recording->num_commands == capacity ) {
+            capacity = capacity ? capacity * 2 : 256;
+            size_t size = capacity * sizeof(*recording->commands);
+            recording->commands = realloc(recording->commands, size);
+            if ( recording->commands == NULL ) {
+                Error("could not allocate replay commands");
+            }
+        }
+
+        Command * command = &recording->commands[recording->num_commands++];
+        command->type = bytes[0];
+        command->direction = bytes[1];
+        command->wait_ticks = bytes[2] | bytes[3] << 8;
+
+        if ( command->type >= NUM_COMMANDS ) {
+            FreeRecording(recording);
+            fclose(file);
+            return false;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+
+void FreeRecording(Recording * recording)
+{
+    free(recording->commands);
+    *recording = (Recording){ 0 };
+}
+
+
+#pragma mark - Replay
+
+void StartReplay(Game * game, const char * path, bool paced)
+{
+    if ( !LoadRecording(&replay, path) ) {
+        Error("could not load replay %s", path);
+    }
+
+    printf("replaying %s: %d commands, seed %llu\n",
+           path,
+           replay.num_commands,
+           (unsigned long long)replay.master_seed);
+
+    replaying = true;
+    replay_paced = paced;
+    next_command = 0;
+    replay_frames = 0;
+    total_frame_msec = 0.0f;
+    max_replay_frame_msec = 0.0f;
+
+    game->master_seed = replay.master_seed;
+    game->forest_size = replay.forest_size;
+    game->forest_seed = replay.forest_seed;
+    NewGame(game);
+
+    last_command_tick = game->ticks;
+    replay_start = ProgramTime();
+}
+
+
+bool IsReplaying(void)
+{
+    return replaying;
+}
+
+
+static void EndReplay(Game * game, const char * reason)
+{
+    float elapsed = ProgramTime() - replay_start;
+
+    printf("replay %s after %d of %d commands\n",
+           reason,
+           next_command,
+           replay.num_commands);
+    printf("%d frames in %.2f s, %.3f ms per frame (max %.3f), %.0f frames/sec\n",
+           replay_frames,
+           elapsed,
+           total_frame_msec * 1000.0f / MAX(replay_frames, 1),
+           max_replay_frame_msec * 1000.0f,
+           replay_frames / elapsed);
+
+    FramePercentiles frames = GetFramePercentiles();
+    printf("last %d frames: p50 %.3f, p95 %.3f, p99 %.3f ms\n",
+           MIN(replay_frames, FRAME_HISTORY),
+           frames.p50 * 1000.0f,
+           frames.p95 * 1000.0f,
+           frames.p99 * 1000.0f);
+
+    replaying = false;
+    game->is_running = false;
+}
+
+
+void UpdateReplay(Game * game)
+{
+    if ( !replaying ) {
+        return;
+    }
+
+    // frame_msec is the previous frame's.
+    if ( replay_frames > 0 ) {
+        total_frame_msec += frame_msec;
+        max_replay_frame_msec = MAX(max_replay_frame_msec, frame_msec);
+    }
+    replay_frames++;
+
+    const GameState * state = GetGameState(game);
+
+    if ( state == &gs_death_screen ) {
+        EndReplay(game, "ended, player died,");
+        return;
+    }
+
+    // The game takes commands when input would be, see DoFrame.
+    if ( state != &gs_level_idle
+        || (game->fade_state.type != FADE_NONE
+            && game->fade_state.type != FADE_IN) )
+    {
+        return;
+    }
+
+    if ( next_command == replay.num_commands ) {
+        EndReplay(game, "finished");
+        return;
+    }
+
+    const Command * command = &replay.commands[next_command];
+
+    if ( replay_paced && game->ticks - last_command_tick < command->wait_ticks ) {
+        return;
+    }
+
+    last_command_tick = game->ticks;
+    next_command++;
+    DoCommand(game, *command);
+}
+
+
+void StopRecordingAndReplay(void)
+{
+    if ( record_file ) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+
+    record_path = NULL;
+    replaying = false;
+    FreeRecording(&replay);
+}
@@ -0,0 +1,53 @@
+//
+//  replay.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/13/23.
+//
+//  Recording and replay of play sessions. A recording is a game's master seed
+//  followed by every command the player gave on the level, so replaying it
+//  plays out exactly the same game. Replays can run at the recorded pace or
+//  as fast as possible, with or without rendering, to make repeatable
+//  workloads for profiling.
+//
+//  Debug keys handled by DoFrame (level skipping, killing all actors, etc.)
+//  aren't recorded, and using them makes a recording that won't replay.
+//
+
+#ifndef replay_h
+#define replay_h
+
+#include "game.h"
+
+typedef struct {
+    u64 master_seed;
+    int forest_size;
+    int forest_seed;
+    int num_commands;
+    Command * commands;
+} Recording;
+
+/// Record each new game to `path`, overwriting it.
+void StartRecording(const char * path);
+
+/// Begin a recording's game, called from NewGame.
+void RecordNewGame(const Game * game);
+void RecordCommand(const Game * game, Command command);
+
+/// - returns: False if the file couldn't be read or isn't a recording.
+bool LoadRecording(Recording * recording, const char * path);
+void FreeRecording(Recording * recording);
+
+/// Set up `game` to play out a recording and start the game.
+/// - parameter paced: Wait as many frames before each command as the player
+///   did. Otherwise commands are given as soon as the game can take them.
+void StartReplay(Game * game, const char * path, bool paced);
+bool IsReplaying(void);
+
+/// Give the next command if it's time, or end the replay and quit if there
+/// are no more or the player died. Called once per frame.
+void UpdateReplay(Game * game);
+
+void StopRecordingAndReplay(void);
+
+#endif /* replay_h */
@@ -0,0 +1,75 @@
+//
+//  rng.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/11/23.
+//
+//  PCG32 (XSH RR), see https://www.pcg-random.org
+//
+
+#include "rng.h"
+
+#define PCG_MULTIPLIER 6364136223846793005ULL
+
+Rng SeedRng(u64 seed, u64 stream)
+{
+    Rng rng = { 0, (stream << 1) | 1 };
+
+    RngNext(&rng);
+    rng.state += seed;
+    RngNext(&rng);
+
+    return rng;
+}
+
+
+u64 SplitSeed(u64 seed, u64 key)
+{
+    u64 z = seed + (key + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+u32 RngNext(Rng * rng)
+{
+    u64 old_state = rng->state;
+    rng->state = old_state * PCG_MULTIPLIER + rng->increment;
+
+    u32 xor_shifted = (u32)(((old_state >> 18) ^ old_state) >> 27);
+    u32 rotation = (u32)(old_state >> 59);
+
+    return (xor_shifted >> rotation) | (xor_shifted << ((-rotation) & 31));
+}
+
+
+int RngInt(Rng * rng, int min, int max)
+{
+    if ( max <= min ) {
+        return min;
+    }
+
+    u32 range = (u32)(max - min) + 1;
+    return min + (int)(RngNext(rng) % range);
+}
+
+
+// 24 random bits, which a float holds exactly, from 0 up to 1.
+static float RngUnit(Rng * rng)
+{
+    return (RngNext(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+
+float RngFloat(Rng * rng, float min, float max)
+{
+    return min + RngUnit(rng) * (max - min);
+}
+
+
+bool RngChance(Rng * rng, float chance)
+{
+    return RngUnit(rng) < chance;
+}
@@ -0,0 +1,57 @@
+//
+//  rng.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/11/23.
+//
+//  Random number generators that carry their own state, for work that
+//  shouldn't share mathlib's global Random(), such as level generation on
+//  another thread.
+//
+//  A game is played from one master seed. Each level's seed is split off from
+//  it, and each subsystem draws from its own stream of that seed, so a level
+//  plays out the same given the same seed and player input, no matter how
+//  many numbers other subsystems used.
+//
+
+#ifndef rng_h
+#define rng_h
+
+#include "shorttypes.h"
+#include <stdbool.h>
+
+/// A PCG32 generator. Generators with the same seed but different streams
+/// produce unrelated sequences.
+typedef struct {
+    u64 state;
+    u64 increment; // Selects the stream. Always odd.
+} Rng;
+
+/// Streams for each subsystem, used with a level's seed.
+typedef enum {
+    RNG_LEVEL_GEN,
+    RNG_LOOT,
+    RNG_PARTICLES,
+    RNG_AI,
+    RNG_STARS,
+    NUM_RNG_STREAMS
+} RngStream;
+
+Rng SeedRng(u64 seed, u64 stream);
+
+/// Derive an unrelated seed from `seed` and `key` (SplitMix64), such as a
+/// level's seed from the master seed and level number.
+u64 SplitSeed(u64 seed, u64 key);
+
+u32 RngNext(Rng * rng);
+
+/// A random number from `min` to `max`, inclusive, like Random().
+int RngInt(Rng * rng, int min, int max);
+
+/// A random float from `min` up to, but not including, `max`.
+float RngFloat(Rng * rng, float min, float max);
+
+/// True with a probability of `chance`, like Chance().
+bool RngChance(Rng * rng, float chance);
+
+#endif /* rng_h */
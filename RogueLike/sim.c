@@ -0,0 +1,116 @@
+//
+//  sim.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/9/23.
+//
+
+#include "sim.h"
+#include "mathlib.h"
+
+// Long enough that any animation or fade finishes in one or two updates.
+#define SIM_DT 1.0f
+
+// Plenty for the longest sequence: a level exit's fade out, intermission and
+// fade in.
+#define MAX_SIM_UPDATES 1000
+
+/// Run game updates until the player can move again.
+/// - returns: False if the player died.
+static bool RunUntilIdle(Game * game)
+{
+    for ( int i = 0; i < MAX_SIM_UPDATES; i++ ) {
+        const GameState * state = GetGameState(game);
+
+        if ( state == &gs_death_screen ) {
+            return false;
+        }
+
+        if ( state == &gs_level_idle && game->fade_state.type == FADE_NONE ) {
+            return true;
+        }
+
+        UpdateState(game, SIM_DT);
+        game->ticks++;
+    }
+
+    Error("simulation did not return to level idle");
+    return false;
+}
+
+Game * InitSimulation(int width, int height, int level_num, u64 master_seed)
+{
+    Game * game = InitGame(width, height);
+
+    // Level one was pregenerated with the title screen's seed, so this will
+    // generate it again.
+    game->master_seed = master_seed;
+    NewGame(game);
+
+    if ( level_num != game->level ) {
+        LoadLevel(game, level_num, false);
+    }
+
+    RunUntilIdle(game);
+
+    return game;
+}
+
+Game * InitReplaySimulation(int width, int height, const Recording * recording)
+{
+    Game * game = InitGame(width, height);
+
+    game->master_seed = recording->master_seed;
+    game->forest_size = recording->forest_size;
+    game->forest_seed = recording->forest_seed;
+    NewGame(game);
+    RunUntilIdle(game);
+
+    return game;
+}
+
+bool SimulateCommand(Game * game, Command command)
+{
+    DoCommand(game, command);
+
+    return RunUntilIdle(game);
+}
+
+bool SimulateTurn(Game * game, Direction direction)
+{
+    Command command = { .type = COMMAND_MOVE, .direction = direction };
+
+    return SimulateCommand(game, command);
+}
+
+Direction RandomPlayerDirection(const Game * game, Rng * rng)
+{
+    const Map * map = game->world.map;
+    const Actor * player = FindActorConst(&map->actor_list, ACTOR_PLAYER);
+
+    Direction open[NUM_CARDINAL_DIRECTIONS];
+    int num_open = 0;
+
+    if ( player ) {
+        for ( Direction d = 0; d < NUM_CARDINAL_DIRECTIONS; d++ ) {
+            TileCoord coord = AdjacentTileCoord(player->tile, d);
+            const TileFlags * flags = GetTileFlags(map, coord);
+
+            if ( flags == NULL ) {
+                continue;
+            }
+
+            // Bumping a door opens it.
+            int type = GetTile(map, coord)->type;
+            if ( !flags->blocks_movement || type == TILE_DUNGEON_DOOR ) {
+                open[num_open++] = d;
+            }
+        }
+    }
+
+    if ( num_open == 0 ) {
+        return RngInt(rng, 0, NUM_CARDINAL_DIRECTIONS - 1);
+    }
+
+    return open[RngInt(rng, 0, num_open - 1)];
+}
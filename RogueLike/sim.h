@@ -0,0 +1,42 @@
+//
+//  sim.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/9/23.
+//
+//  Headless simulation: the game's turn logic driven directly, with no window,
+//  input or sound. Used by the RogueLikeSim command line tool, which links the
+//  RogueLikeCore library (the game without main.c or cgdlib's video, texture,
+//  sprite, input and sound) with the stubs in headless/ in their place.
+//
+
+#ifndef sim_h
+#define sim_h
+
+#include "game.h"
+#include "replay.h"
+
+/// Start a new game on `level_num` and wait for it to become playable.
+/// - parameter width: Render width, which with `height` sets how much of the
+///   level is visible and lit around the player.
+/// - parameter master_seed: The game's master seed. The same seed and player
+///   moves always play out the same way.
+Game * InitSimulation(int width, int height, int level_num, u64 master_seed);
+
+/// Start the game in `recording` and wait for it to become playable.
+Game * InitReplaySimulation(int width, int height, const Recording * recording);
+
+/// Do a command and run the game until it's waiting for the next one.
+/// - returns: False if the player died.
+bool SimulateCommand(Game * game, Command command);
+
+/// Move the player and run the game until it's waiting for the next move,
+/// including any level change the move caused.
+/// - returns: False if the player died.
+bool SimulateTurn(Game * game, Direction direction);
+
+/// A random cardinal direction the player can move (or open a door) in, or any
+/// cardinal direction if the player is boxed in.
+Direction RandomPlayerDirection(const Game * game, Rng * rng);
+
+#endif /* sim_h */
@@ -0,0 +1,152 @@
+//
+//  sprite_batch.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/8/23.
+//
+
+#include "sprite_batch.h"
+#include "video.h"
+
+#define MAX_BATCH_SPRITES 4096
+
+static SDL_Vertex vertices[MAX_BATCH_SPRITES * 4];
+static int indices[MAX_BATCH_SPRITES * 6];
+static bool indices_ready;
+static int num_sprites;
+
+static SDL_Texture * batch_texture; // NULL for solid color quads.
+static float texture_w;
+static float texture_h;
+
+static SpriteBatchStats stats;
+static SpriteBatchStats last_stats;
+
+/// Two triangles per quad, the same for every batch.
+static void InitIndices(void)
+{
+    for ( int i = 0; i < MAX_BATCH_SPRITES; i++ ) {
+        int * index = &indices[i * 6];
+        int v = i * 4;
+
+        index[0] = v + 0;
+        index[1] = v + 1;
+        index[2] = v + 2;
+        index[3] = v + 2;
+        index[4] = v + 3;
+        index[5] = v + 0;
+    }
+}
+
+void FlushSprites(void)
+{
+    if ( num_sprites == 0 ) {
+        return;
+    }
+
+    SDL_RenderGeometry(renderer,
+                       batch_texture,
+                       vertices,
+                       num_sprites * 4,
+                       indices,
+                       num_sprites * 6);
+
+    stats.draw_calls++;
+    num_sprites = 0;
+}
+
+/// Flush if needed so the next quad can be added with `texture`.
+static SDL_Vertex * AddQuad(SDL_Texture * texture)
+{
+    if ( !indices_ready ) {
+        InitIndices();
+        indices_ready = true;
+    }
+
+    if ( texture != batch_texture || num_sprites == MAX_BATCH_SPRITES ) {
+        FlushSprites();
+    }
+
+    if ( num_sprites == 0 ) {
+        batch_texture = texture;
+
+        if ( texture ) {
+            int w, h;
+            SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+            texture_w = w;
+            texture_h = h;
+        }
+    }
+
+    stats.sprites++;
+
+    return &vertices[num_sprites++ * 4];
+}
+
+static void SetQuad(SDL_Vertex * quad, const SDL_Rect * rect, SDL_Color color)
+{
+    float x1 = rect->x;
+    float y1 = rect->y;
+    float x2 = rect->x + rect->w;
+    float y2 = rect->y + rect->h;
+
+    quad[0] = (SDL_Vertex){ .position = { x1, y1 }, .color = color };
+    quad[1] = (SDL_Vertex){ .position = { x2, y1 }, .color = color };
+    quad[2] = (SDL_Vertex){ .position = { x2, y2 }, .color = color };
+    quad[3] = (SDL_Vertex){ .position = { x1, y2 }, .color = color };
+}
+
+void BatchSprite(SDL_Texture * texture,
+                 const SDL_Rect * src,
+                 const SDL_Rect * dst,
+                 SDL_Color color,
+                 SDL_RendererFlip flip)
+{
+    SDL_Vertex * quad = AddQuad(texture);
+    SetQuad(quad, dst, color);
+
+    float u1 = 0.0f;
+    float v1 = 0.0f;
+    float u2 = 1.0f;
+    float v2 = 1.0f;
+
+    if ( src ) {
+        u1 = src->x / texture_w;
+        v1 = src->y / texture_h;
+        u2 = (src->x + src->w) / texture_w;
+        v2 = (src->y + src->h) / texture_h;
+    }
+
+    if ( flip & SDL_FLIP_HORIZONTAL ) {
+        float temp = u1;
+        u1 = u2;
+        u2 = temp;
+    }
+
+    if ( flip & SDL_FLIP_VERTICAL ) {
+        float temp = v1;
+        v1 = v2;
+        v2 = temp;
+    }
+
+    quad[0].tex_coord = (SDL_FPoint){ u1, v1 };
+    quad[1].tex_coord = (SDL_FPoint){ u2, v1 };
+    quad[2].tex_coord = (SDL_FPoint){ u2, v2 };
+    quad[3].tex_coord = (SDL_FPoint){ u1, v2 };
+}
+
+void BatchRect(const SDL_Rect * rect, SDL_Color color)
+{
+    SetQuad(AddQuad(NULL), rect, color);
+}
+
+void EndSpriteBatchFrame(void)
+{
+    last_stats = stats;
+    stats = (SpriteBatchStats){ 0 };
+}
+
+SpriteBatchStats GetSpriteBatchStats(void)
+{
+    return last_stats;
+}
@@ -0,0 +1,46 @@
+//
+//  sprite_batch.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/8/23.
+//
+//  Collects textured and solid color quads and draws them with one
+//  SDL_RenderGeometry call per run of quads sharing a texture. Quads are
+//  tinted with a vertex color instead of the texture's color mod.
+//
+//  Batched quads are drawn in order, but not until the texture changes or
+//  FlushSprites() is called, so flush before drawing anything else that must
+//  go on top, changing the viewport, or changing the render target.
+//
+
+#ifndef sprite_batch_h
+#define sprite_batch_h
+
+#include <SDL.h>
+
+typedef struct {
+    int draw_calls;
+    int sprites;
+} SpriteBatchStats;
+
+/// Add a quad showing `src` of `texture` at `dst`, multiplied by `color`.
+/// - parameter src: The whole texture if NULL.
+void BatchSprite(SDL_Texture * texture,
+                 const SDL_Rect * src,
+                 const SDL_Rect * dst,
+                 SDL_Color color,
+                 SDL_RendererFlip flip);
+
+/// Add a solid `color` rectangle.
+void BatchRect(const SDL_Rect * rect, SDL_Color color);
+
+/// Draw all batched quads.
+void FlushSprites(void);
+
+/// Start counting a new frame.
+void EndSpriteBatchFrame(void);
+
+/// Counts from the last complete frame.
+SpriteBatchStats GetSpriteBatchStats(void);
+
+#endif /* sprite_batch_h */
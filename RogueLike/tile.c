@@ -11,6 +11,7 @@
 #include "mathlib.h"
 #include "video.h"
 #include "texture.h"
+#include "sprite_batch.h"
 
 // Sprite sheet location.
 // Tiles with multiple visible varieties are layed out horizontally
@@ -83,53 +84,36 @@ static struct tile_info {
 };
 
 
-static Tile tile_templates[NUM_TILE_TYPES] = {
-    [TILE_NULL] = {
-        .flags = { .blocks_movement = true, .blocks_sight = true },
-    },
-    [TILE_DUNGEON_WALL] = {
-        .flags = { .blocks_movement = true, .blocks_sight = true },
-    },
-    [TILE_TREE] = {
-        .flags = { .blocks_movement = true, .blocks_sight = true }
-    },
-    [TILE_DUNGEON_DOOR] = {
-        .flags = { .blocks_movement = true, .blocks_sight = true },
-    },
-    [TILE_FOREST_EXIT] = {
-        .flags = { .player_only = true, },
-    },
-    [TILE_DUNGEON_EXIT] = {
-        .flags = { .player_only = true, },
-    },
-    [TILE_GOLD_DOOR] = {
-        .flags = { .blocks_movement = true, .blocks_sight = true },
-    },
-    [TILE_TELEPORTER] = {
-        .flags = { .bright = true, .player_only = true },
-    },
-    [TILE_WATER] = {
-        .flags = { .blocks_movement = true }
-    },
-    [TILE_BUTTON_NOT_PRESSED] = {
-        .flags = { .blocks_movement = true, .player_only = true },
-    },
-    [TILE_WOODEN_WALL] = {
-        .flags = { .blocks_movement = true, .blocks_sight = true },
-    }
+static const TileFlags tile_type_flags[NUM_TILE_TYPES] = {
+    [TILE_NULL] = { .blocks_movement = true, .blocks_sight = true },
+    [TILE_DUNGEON_WALL] = { .blocks_movement = true, .blocks_sight = true },
+    [TILE_TREE] = { .blocks_movement = true, .blocks_sight = true },
+    [TILE_DUNGEON_DOOR] = { .blocks_movement = true, .blocks_sight = true },
+    [TILE_FOREST_EXIT] = { .player_only = true },
+    [TILE_DUNGEON_EXIT] = { .player_only = true },
+    [TILE_GOLD_DOOR] = { .blocks_movement = true, .blocks_sight = true },
+    [TILE_TELEPORTER] = { .bright = true, .player_only = true },
+    [TILE_WATER] = { .blocks_movement = true },
+    [TILE_BUTTON_NOT_PRESSED] = { .blocks_movement = true, .player_only = true },
+    [TILE_WOODEN_WALL] = { .blocks_movement = true, .blocks_sight = true }
 };
 
 
 Tile CreateTile(TileType type)
 {
-    Tile tile = tile_templates[type];
+    Tile tile = { 0 };
     tile.type = type;
-    tile.variety = Random(0, 255);
 
     return tile;
 }
 
 
+TileFlags TileTypeFlags(TileType type)
+{
+    return tile_type_flags[type];
+}
+
+
 const char * TileName(TileType type)
 {
     switch ( type ) {
@@ -155,8 +139,12 @@ const char * TileName(TileType type)
 }
 
 
+/// Batched: call FlushSprites() when done drawing tiles.
+/// - parameter variety: The tile's TileVariety().
 /// - parameter debug: Ignore lighting and tile's revealed property.
 void RenderTile(const Tile * tile,
+                u8 variety,
+                u8 light,
                 int area,
                 int signature,
                 int pixel_x,
@@ -168,15 +156,16 @@ void RenderTile(const Tile * tile,
     SDL_Texture * tiles = render_info->tile_texture;
     tile_info_t * info = &_info[tile->type];
 
-    if ( debug || tile->flags.bright ) {
+    SDL_Color color;
+    if ( debug || tile_type_flags[tile->type].bright ) {
         // In debug, always draw at full light.
-        SDL_SetTextureColorMod(tiles, 255, 255, 255);
+        color = (SDL_Color){ 255, 255, 255, 255 };
     } else {
         // Apply tile's light level.
         if ( area == AREA_FOREST ) {
-            SDL_SetTextureColorMod(tiles, tile->light, tile->light, 128);
+            color = (SDL_Color){ light, light, 128, 255 };
         } else {
-            SDL_SetTextureColorMod(tiles, tile->light, tile->light, tile->light);
+            color = (SDL_Color){ light, light, light, 255 };
         }
     }
 
@@ -204,7 +193,7 @@ void RenderTile(const Tile * tile,
             if ( area == AREA_DUNGEON ) {
                 src.x = 1 * TILE_SIZE;
                 src.y = 0 * TILE_SIZE;
-                V_DrawTexture(tiles, &src, &dst); // Blank it to start.
+                BatchSprite(tiles, &src, &dst, color, SDL_FLIP_NONE); // Blank it to start.
 
                 Direction draw_order[NUM_DIRECTIONS] = {
                     NORTH,
@@ -223,43 +212,35 @@ void RenderTile(const Tile * tile,
 
                     if ( signature & DIR_BIT(direction) ) {
                         src.x = direction * TILE_SIZE;
-                        V_DrawTexture(tiles, &src, &dst);
+                        BatchSprite(tiles, &src, &dst, color, SDL_FLIP_NONE);
                     }
                 }
                 return;
             }
             break;
         case TILE_FOREST_GROUND:
-            if ( tile->variety == 012 ) {
+            if ( variety == 012 ) {
                 src.x += (info->num_variants - 1) * TILE_SIZE; // flower
-            } else if ( tile->variety < 170 ) {
-                src.x += (tile->variety % (info->num_variants - 1)) * TILE_SIZE;
+            } else if ( variety < 170 ) {
+                src.x += (variety % (info->num_variants - 1)) * TILE_SIZE;
             }
             break;
         case TILE_DUNGEON_FLOOR:
-            if ( tile->variety > 112 ) {
-                src.x += (tile->variety % info->num_variants) * TILE_SIZE;
+            if ( variety > 112 ) {
+                src.x += (variety % info->num_variants) * TILE_SIZE;
             }
             break;
         case TILE_WATER:
-            if ( tile->variety < 112 ) {
-                src.x += (tile->variety % info->num_variants) * TILE_SIZE;
+            if ( variety < 112 ) {
+                src.x += (variety % info->num_variants) * TILE_SIZE;
             }
             break;
         default:
             if ( info->num_variants > 1 ) {
-                src.x += tile->variety % info->num_variants * TILE_SIZE;
+                src.x += variety % info->num_variants * TILE_SIZE;
             }
             break;
     }
 
-    V_DrawTexture(tiles, &src, &dst);
-
-    // Show tile distance to player
-    if ( !tile->flags.blocks_movement ) {
-        if ( show_distances ) {
-            V_SetGray(255);
-            V_PrintString(dst.x, dst.y, "%d", tile->player_distance);
-        }
-    }
+    BatchSprite(tiles, &src, &dst, color, SDL_FLIP_NONE);
 }
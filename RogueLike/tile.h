@@ -36,31 +36,33 @@ typedef enum {
 } TileType;
 
 
-typedef s8 TileID;
+typedef s32 TileID;
 
+/// A map tile's record. Data that is read in bulk (flags, region IDs) is kept
+/// in separate planes in the map's chunks, light in the `Map`'s light map, and
+/// its visual variety is worked out from its position, see TileVariety().
 typedef struct {
     u8 type; // a tile_type_t
-    u8 variety; // A value that can be used for visual randomization.
-    s16 id; // forest region, or dungeon room (-1 if none).
-
-    struct {
-        bool blocks_movement    : 1;
-        bool blocks_sight       : 1;
-        bool player_only        : 1;
-        bool visible            : 1;
-        bool revealed           : 1;
-        bool bright             : 1;
-    } flags;
-
-    u8 light; // Current light level.
-    s16 distance; // For pathfinding. Updated via CalculateDistances()
-    s16 player_distance; // "   "
     u8 tag;
 } Tile;
 
+typedef struct {
+    bool blocks_movement    : 1;
+    bool blocks_sight       : 1;
+    bool player_only        : 1;
+    bool visible            : 1;
+    bool revealed           : 1;
+    bool bright             : 1;
+} TileFlags;
+
 Tile CreateTile(TileType type);
 
+/// The flags a new tile of `type` starts with.
+TileFlags TileTypeFlags(TileType type);
+
 void RenderTile(const Tile * tile,
+                u8 variety,
+                u8 light,
                 int area,
                 int signature,
                 int pixel_x,
@@ -0,0 +1,334 @@
+//
+//  tile_cache.c
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/7/23.
+//
+
+#include "tile_cache.h"
+#include "genlib.h"
+#include "video.h"
+#include "sprite_batch.h"
+
+#include <stdlib.h>
+
+#define CHUNK_PIXELS (TILE_CHUNK_SIZE * TILE_SIZE)
+#define NUM_CHUNK_TEXTURES 64
+#define NO_SLOT -1
+
+/// A chunk texture. Slots are handed out to chunks as they come into view and
+/// reclaimed from whichever chunk was drawn least recently.
+typedef struct {
+    SDL_Texture * texture;
+    int chunk; // Index of the chunk drawn in this texture, or NO_SLOT.
+    u64 draw_stamp; // The map's when the chunk was drawn.
+    u32 last_used;
+} ChunkSlot;
+
+static ChunkSlot slots[NUM_CHUNK_TEXTURES];
+static u32 frame_count;
+
+// The chunk grid of the map the slots were drawn for.
+static s8 * chunk_slots; // One per chunk, NO_SLOT if not drawn.
+static int chunk_slots_size;
+static int chunks_wide;
+static int chunks_high;
+static const Map * cached_map;
+static int cached_width;
+static int cached_height;
+static Area cached_area;
+
+static TileCacheStats stats;
+
+/// Forget all drawn chunks if the map, its size, or the area changed.
+static void CheckMap(const World * world)
+{
+    const Map * map = world->map;
+
+    if (   map == cached_map
+        && map->width == cached_width
+        && map->height == cached_height
+        && world->area == cached_area )
+    {
+        return;
+    }
+
+    cached_map = map;
+    cached_width = map->width;
+    cached_height = map->height;
+    cached_area = world->area;
+
+    chunks_wide = (map->width + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    chunks_high = (map->height + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    int num_chunks = chunks_wide * chunks_high;
+
+    if ( chunk_slots_size < num_chunks ) {
+        free(chunk_slots);
+        chunk_slots = malloc(num_chunks * sizeof(*chunk_slots));
+        if ( chunk_slots == NULL ) {
+            Error("could not allocate tile chunks");
+        }
+        chunk_slots_size = num_chunks;
+    }
+
+    for ( int i = 0; i < num_chunks; i++ ) {
+        chunk_slots[i] = NO_SLOT;
+    }
+
+    for ( int i = 0; i < NUM_CHUNK_TEXTURES; i++ ) {
+        slots[i].chunk = NO_SLOT;
+    }
+}
+
+/// The tiles a chunk shows: its own, plus the row above, since tall tiles
+/// (trees, forest ground) hang down into the next row.
+static Box ChunkTiles(const Map * map, int cx, int cy)
+{
+    Box box;
+    box.left = cx * TILE_CHUNK_SIZE;
+    box.top = MAX(cy * TILE_CHUNK_SIZE - 1, 0);
+    box.right = MIN(box.left + TILE_CHUNK_SIZE, map->width) - 1;
+    box.bottom = MIN(cy * TILE_CHUNK_SIZE + TILE_CHUNK_SIZE, map->height) - 1;
+
+    return box;
+}
+
+/// Whether any tile the chunk shows changed since the map's draw stamp was
+/// `draw_stamp`. Wall signatures depend on the tiles around them, and the chunk
+/// shows the row above its own, so the map chunks all around it are checked.
+static bool ChunkChanged(const Map * map, int cx, int cy, u64 draw_stamp)
+{
+    for ( int y = MAX(cy - 1, 0); y <= MIN(cy + 1, map->chunks_high - 1); y++ ) {
+        for ( int x = MAX(cx - 1, 0); x <= MIN(cx + 1, map->chunks_wide - 1); x++ ) {
+            if ( map->chunks[y * map->chunks_wide + x]->draw_stamp > draw_stamp ) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/// - returns: NO_SLOT if every slot is already showing a chunk this frame.
+static int GetSlot(int chunk)
+{
+    if ( chunk_slots[chunk] != NO_SLOT ) {
+        return chunk_slots[chunk];
+    }
+
+    // Take the least recently drawn slot.
+    int lru = 0;
+    for ( int i = 1; i < NUM_CHUNK_TEXTURES; i++ ) {
+        if ( slots[i].last_used < slots[lru].last_used ) {
+            lru = i;
+        }
+    }
+
+    if ( slots[lru].last_used == frame_count ) {
+        return NO_SLOT;
+    }
+
+    ChunkSlot * slot = &slots[lru];
+
+    if ( slot->texture == NULL ) {
+        slot->texture = SDL_CreateTexture(renderer,
+                                          SDL_PIXELFORMAT_RGBA8888,
+                                          SDL_TEXTUREACCESS_TARGET,
+                                          CHUNK_PIXELS,
+                                          CHUNK_PIXELS);
+        if ( slot->texture == NULL ) {
+            Error("could not create tile chunk texture: %s", SDL_GetError());
+        }
+
+        SDL_SetTextureBlendMode(slot->texture, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureScaleMode(slot->texture, SDL_ScaleModeNearest);
+    }
+
+    if ( slot->chunk != NO_SLOT ) {
+        chunk_slots[slot->chunk] = NO_SLOT;
+    }
+
+    slot->chunk = chunk;
+    chunk_slots[chunk] = lru;
+
+    return lru;
+}
+
+/// Draw the chunk's tiles into its texture at native size.
+static void RebuildChunk(const World * world,
+                         SDL_Texture * texture,
+                         Box tiles,
+                         int cx,
+                         int cy,
+                         const RenderInfo * render_info)
+{
+    const Map * map = world->map;
+
+    SDL_SetRenderTarget(renderer, texture);
+    V_SetRGBA(0, 0, 0, 0);
+    V_Clear();
+
+    int origin_x = cx * CHUNK_PIXELS;
+    int origin_y = cy * CHUNK_PIXELS;
+
+    for ( int y = tiles.top; y <= tiles.bottom; y++ ) {
+        for ( int x = tiles.left; x <= tiles.right; x++ ) {
+            TileCoord coord = { x, y };
+            RenderTile(GetTile(map, coord),
+                       TileVariety(map, coord),
+                       GetTileLight(map, coord),
+                       world->area,
+                       GetWallSignature(map, coord),
+                       x * TILE_SIZE - origin_x,
+                       y * TILE_SIZE - origin_y,
+                       TILE_SIZE,
+                       false,
+                       render_info);
+        }
+    }
+
+    FlushSprites();
+    stats.chunks_rebuilt++;
+}
+
+/// For when there are more chunks on screen than textures: draw the chunk's
+/// tiles straight to the screen, clipped to the chunk like its texture would
+/// be.
+static void RenderUncachedChunk(const World * world,
+                                int cx,
+                                int cy,
+                                const SDL_Rect * dst,
+                                vec2_t offset,
+                                const RenderInfo * render_info)
+{
+    const Map * map = world->map;
+    Box tiles = ChunkTiles(map, cx, cy);
+    int tile_size = SCALED(TILE_SIZE);
+
+    FlushSprites(); // Clip only this chunk's tiles.
+
+    SDL_Rect old_clip;
+    bool was_clipped = SDL_RenderIsClipEnabled(renderer);
+    SDL_RenderGetClipRect(renderer, &old_clip);
+    SDL_RenderSetClipRect(renderer, dst);
+
+    for ( int y = tiles.top; y <= tiles.bottom; y++ ) {
+        for ( int x = tiles.left; x <= tiles.right; x++ ) {
+            TileCoord coord = { x, y };
+            RenderTile(GetTile(map, coord),
+                       TileVariety(map, coord),
+                       GetTileLight(map, coord),
+                       world->area,
+                       GetWallSignature(map, coord),
+                       x * tile_size - offset.x,
+                       y * tile_size - offset.y,
+                       tile_size,
+                       false,
+                       render_info);
+        }
+    }
+
+    FlushSprites();
+    SDL_RenderSetClipRect(renderer, was_clipped ? &old_clip : NULL);
+}
+
+void RenderCachedTiles(const World * world,
+                       Box region,
+                       vec2_t offset,
+                       const RenderInfo * render_info)
+{
+    const Map * map = world->map;
+
+    CheckMap(world);
+    frame_count++;
+    stats = (TileCacheStats){ 0 };
+
+    int left = MAX(region.left, 0) / TILE_CHUNK_SIZE;
+    int top = MAX(region.top, 0) / TILE_CHUNK_SIZE;
+    int right = MIN(region.right / TILE_CHUNK_SIZE, chunks_wide - 1);
+    int bottom = MIN(region.bottom / TILE_CHUNK_SIZE, chunks_high - 1);
+
+    // Bring every chunk up to date first, so the render target only changes
+    // when something needs redrawing.
+
+    SDL_Rect viewport;
+    SDL_RenderGetViewport(renderer, &viewport);
+    bool target_changed = false;
+
+    for ( int cy = top; cy <= bottom; cy++ ) {
+        for ( int cx = left; cx <= right; cx++ ) {
+            int chunk = cy * chunks_wide + cx;
+            bool drawn = chunk_slots[chunk] != NO_SLOT;
+
+            int slot_index = GetSlot(chunk);
+            if ( slot_index == NO_SLOT ) {
+                continue; // Drawn uncached below.
+            }
+
+            ChunkSlot * slot = &slots[slot_index];
+            slot->last_used = frame_count;
+
+            if ( !drawn || ChunkChanged(map, cx, cy, slot->draw_stamp) ) {
+                Box tiles = ChunkTiles(map, cx, cy);
+                RebuildChunk(world, slot->texture, tiles, cx, cy, render_info);
+                slot->draw_stamp = map->draw_stamp;
+                target_changed = true;
+            }
+        }
+    }
+
+    if ( target_changed ) {
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_RenderSetViewport(renderer, &viewport);
+    }
+
+    int chunk_size = SCALED(CHUNK_PIXELS);
+
+    for ( int cy = top; cy <= bottom; cy++ ) {
+        for ( int cx = left; cx <= right; cx++ ) {
+            SDL_Rect dst = {
+                .x = cx * chunk_size - offset.x,
+                .y = cy * chunk_size - offset.y,
+                .w = chunk_size,
+                .h = chunk_size
+            };
+
+            int slot = chunk_slots[cy * chunks_wide + cx];
+
+            if ( slot == NO_SLOT ) {
+                RenderUncachedChunk(world, cx, cy, &dst, offset, render_info);
+                stats.chunks_uncached++;
+                continue;
+            }
+
+            BatchSprite(slots[slot].texture,
+                        NULL,
+                        &dst,
+                        (SDL_Color){ 255, 255, 255, 255 },
+                        SDL_FLIP_NONE);
+            stats.chunks_drawn++;
+        }
+    }
+
+    FlushSprites();
+}
+
+TileCacheStats GetTileCacheStats(void)
+{
+    return stats;
+}
+
+void FreeTileCache(void)
+{
+    for ( int i = 0; i < NUM_CHUNK_TEXTURES; i++ ) {
+        if ( slots[i].texture ) {
+            SDL_DestroyTexture(slots[i].texture);
+        }
+        slots[i] = (ChunkSlot){ 0 };
+    }
+
+    free(chunk_slots);
+    chunk_slots = NULL;
+    chunk_slots_size = 0;
+    cached_map = NULL;
+}
@@ -0,0 +1,37 @@
+//
+//  tile_cache.h
+//  RogueLike
+//
+//  Created by Thomas Foster on 6/7/23.
+//
+//  Pre-rendered tile chunks. The map is split into square chunks, each drawn
+//  once into a texture at native tile size and redrawn only when the map
+//  stamps it or a neighbor as changed. See TouchTileChunk().
+//
+
+#ifndef tile_cache_h
+#define tile_cache_h
+
+#include "world.h"
+
+#define TILE_CHUNK_SIZE MAP_CHUNK_SIZE // In tiles. The map's, to share its stamps.
+
+typedef struct {
+    int chunks_drawn;
+    int chunks_rebuilt;
+    int chunks_uncached; // Over the texture limit, drawn tile by tile.
+} TileCacheStats;
+
+/// Draw the chunks covering `region`, rebuilding any that are out of date.
+/// Tiles are drawn at `SCALED(TILE_SIZE)`.
+void RenderCachedTiles(const World * world,
+                       Box region,
+                       vec2_t offset,
+                       const RenderInfo * render_info);
+
+/// Chunk counts from the last call to `RenderCachedTiles`.
+TileCacheStats GetTileCacheStats(void);
+
+void FreeTileCache(void);
+
+#endif /* tile_cache_h */
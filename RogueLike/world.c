@@ -8,6 +8,9 @@
 #include "world.h"
 #include "game.h"
 #include "debug.h"
+#include "flow_field.h"
+#include "tile_cache.h"
+#include "sprite_batch.h"
 
 #include "video.h"
 
@@ -40,6 +43,17 @@ const AreaInfo area_info[NUM_AREAS] = {
     },
 };
 
+const char * const gen_phase_names[NUM_GEN_PHASES] = {
+    [GEN_SPAWN_ROOMS] = "SpawnRooms",
+    [GEN_HALLWAYS] = "GenerateHallways",
+    [GEN_CONNECT_REGIONS] = "ConnectRegions",
+    [GEN_DEAD_ENDS] = "EliminateDeadEnds",
+    [GEN_DOORS] = "SpawnDoors",
+    [GEN_NOISE_FILL] = "noise fill",
+    [GEN_FLOOD_FILL] = "flood fill",
+    [GEN_REGION_SORT] = "region sort",
+};
+
 
 World InitWorld(void)
 {
@@ -51,36 +65,143 @@ World InitWorld(void)
 }
 
 
-void GenerateWorld(Game * game, Area area, int seed, int width, int height)
+void InitLevelGen(LevelGen * gen,
+                  Game * game,
+                  Map * maps,
+                  Area area,
+                  int seed,
+                  int width,
+                  int height)
+{
+    *gen = (LevelGen){
+        .game = game,
+        .maps = maps,
+        .area = area,
+        .seed = seed,
+        .width = width,
+        .height = height,
+        .forest_freq = game->forest_freq,
+        .forest_amp = game->forest_amp,
+        .forest_pers = game->forest_pers,
+        .forest_lec = game->forest_lec,
+        .forest_low = game->forest_low,
+        .forest_high = game->forest_high,
+        .rng = SeedRng((u32)seed, RNG_LEVEL_GEN),
+    };
+}
+
+
+void GenerateLevel(LevelGen * gen)
 {
+    if ( gen->width > MAP_MAX_SIZE || gen->height > MAP_MAX_SIZE ) {
+        Error("map size must be <= %d", MAP_MAX_SIZE);
+    }
+
+    ProfileScope scope = PROFILE_BEGIN("GenerateLevel");
+
+    gen->coords = NULL;
+    gen->sorted_coords = NULL;
+    gen->distances = NULL;
+    gen->num_coords = 0;
+    gen->coords_capacity = 0;
+
+    for ( int i = 0; i < NUM_GEN_PHASES; i++ ) {
+        gen->phase_msec[i] = 0.0f;
+    }
+
     // Free up all previously loaded actors.
-    RemoveAllActors(&game->world.map->actor_list);
+    RemoveAllActors(&gen->maps[0].actor_list);
 
-    game->world.area = area;
-    game->world.info = &area_info[area];
+    for ( int i = 0; i < MAX_MAPS; i++ ) {
+        gen->maps[i].seed = gen->seed;
+    }
 
-    switch ( area ) {
+    switch ( gen->area ) {
         case AREA_FOREST:
-            GenerateForest(game, seed, width);
+            GenerateForest(gen);
             break;
         case AREA_DUNGEON:
-            GenerateDungeon(game, width, height);
+            GenerateDungeon(gen);
             break;
         default:
             Error("weird area number!");
             break;
     }
+
+    MapChanged(&gen->maps[0]);
+
+    free(gen->distances);
+    free(gen->sorted_coords);
+    free(gen->coords);
+    gen->distances = NULL;
+    gen->sorted_coords = NULL;
+    gen->coords = NULL;
+    gen->coords_capacity = 0;
+
+    PROFILE_END(scope);
+}
+
+
+void AddGenCoord(LevelGen * gen, TileCoord coord)
+{
+    if ( gen->num_coords == gen->coords_capacity ) {
+        int capacity = gen->coords_capacity ? gen->coords_capacity * 2 : 1024;
+        gen->coords = realloc(gen->coords, capacity * sizeof(*gen->coords));
+        gen->sorted_coords = realloc(gen->sorted_coords,
+                                     capacity * sizeof(*gen->sorted_coords));
+        gen->distances = realloc(gen->distances, capacity * sizeof(*gen->distances));
+        if (   gen->coords == NULL
+            || gen->sorted_coords == NULL
+            || gen->distances == NULL )
+        {
+            Error("Could not allocate level generation buffers");
+        }
+
+        gen->coords_capacity = capacity;
+    }
+
+    gen->coords[gen->num_coords++] = coord;
+}
+
+
+void BeginGenPhase(LevelGen * gen, GenPhase phase)
+{
+    gen->phase_scope = PROFILE_BEGIN(gen_phase_names[phase]);
+    gen->phase_start = ProgramTime();
+}
+
+
+void EndGenPhase(LevelGen * gen, GenPhase phase)
+{
+    gen->phase_msec[phase] = ProgramTime() - gen->phase_start;
+    PROFILE_END(gen->phase_scope);
+}
+
+
+void GenerateWorld(Game * game, Area area, int seed, int width, int height)
+{
+    LevelGen gen;
+    InitLevelGen(&gen, game, game->world.maps, area, seed, width, height);
+    GenerateLevel(&gen);
+
+    game->world.area = area;
+    game->world.info = &area_info[area];
+    game->world.map = &game->world.maps[0];
+
+    if ( area == AREA_DUNGEON && show_map_gen ) {
+        DebugWaitForKeyPress();
+    }
 }
 
 
 static int CompareActors(const void * a, const void * b) {
-    const Actor ** actor1 = (const Actor **)a;
-    const Actor ** actor2 = (const Actor **)b;
+    const Actor * actor1 = DerefActor(*(const ActorRef *)a);
+    const Actor * actor2 = DerefActor(*(const ActorRef *)b);
 
-    if ((*actor1)->tile.y != (*actor2)->tile.y) {
-        return (*actor1)->tile.y - (*actor2)->tile.y;
+    if (actor1->tile.y != actor2->tile.y) {
+        return actor1->tile.y - actor2->tile.y;
     } else {
-        return (*actor1)->info->sprite.draw_priority - (*actor2)->info->sprite.draw_priority;
+        return actor1->info->sprite.draw_priority - actor2->info->sprite.draw_priority;
     }
 }
 
@@ -102,30 +223,34 @@ void RenderWorld(const World * world, const RenderInfo * render_info, int ticks)
     Box vis_rect = GetCameraVisibleRegion(world->map, render_info);
 
     RenderTiles(world, &vis_rect, offset, false, render_info);
-    RenderParticles(&world->particles, DRAW_SCALE, offset);
+    PROFILE(RenderParticles(&world->particles, DRAW_SCALE, offset), particles_msec);
 
     // Make a list of visible actors.
 
 
     int num_visible_actors = 0;
-    Actor ** visible_actors = GetVisibleActors(world,
-                                               render_info,
-                                               &num_visible_actors);
-    SDL_qsort(visible_actors, num_visible_actors, sizeof(Actor *), CompareActors);
+    ActorRef * visible_actors = GetVisibleActors(world,
+                                                 render_info,
+                                                 &num_visible_actors);
+    SDL_qsort(visible_actors, num_visible_actors, sizeof(*visible_actors), CompareActors);
 
     // Draw actors.
 
+    ProfileScope scope = PROFILE_BEGIN("RenderActors");
     float start = ProgramTime();
 
     for ( int i = 0; i < num_visible_actors; i++ ) {
-        const Actor * a = visible_actors[i];
+        const Actor * a = DerefActor(visible_actors[i]);
         int size = SCALED(TILE_SIZE);
         int x = a->tile.x * size + a->offset_current.x - offset.x;
         int y = a->tile.y * size + a->offset_current.y - offset.y;
         RenderActor(a, x, y, size, false, ticks);
     }
 
+    FlushSprites();
+
     actors_msec = ProgramTime() - start;
+    PROFILE_END(scope);
 
     SDL_RenderSetViewport(renderer, NULL);
 }
@@ -139,6 +264,7 @@ void RenderTiles(const World * world,
                  bool debug,
                  const RenderInfo * render_info)
 {
+    ProfileScope scope = PROFILE_BEGIN("RenderTiles");
     float start = ProgramTime();
 
     const Map * map = world->map;
@@ -158,24 +284,58 @@ void RenderTiles(const World * world,
         use = *region;
     }
 
+    const DistancePlane * player_distances = NULL;
+    if ( show_distances ) {
+        const Actor * player = FindActorConst(&map->actor_list, ACTOR_PLAYER);
+        if ( player ) {
+            player_distances = GetFlowField(map, player->tile, 0);
+        }
+    }
+
     TileCoord coord;
-    for ( coord.y = use.top; coord.y <= use.bottom; coord.y++ ) {
-        for ( coord.x = use.left; coord.x <= use.right; coord.x++ ) {
-            const Tile * tile = GetTile((Map *)map, coord);
 
-            int signature = CalculateWallSignature(map, coord, false);
+    if ( !debug && use_tile_cache ) {
+        RenderCachedTiles(world, use, offset, render_info);
+    } else {
+        for ( coord.y = use.top; coord.y <= use.bottom; coord.y++ ) {
+            for ( coord.x = use.left; coord.x <= use.right; coord.x++ ) {
+                RenderTile(GetTile(map, coord),
+                           TileVariety(map, coord),
+                           GetTileLight(map, coord),
+                           world->area,
+                           GetWallSignature(map, coord),
+                           coord.x * tile_size - offset.x,
+                           coord.y * tile_size - offset.y,
+                           tile_size,
+                           debug,
+                           render_info);
+            }
+        }
+
+        FlushSprites();
+    }
 
+    // Debug overlays
+
+    if ( player_distances == NULL && !show_debug_info ) {
+        tiles_msec = ProgramTime() - start;
+        PROFILE_END(scope);
+        return;
+    }
+
+    for ( coord.y = use.top; coord.y <= use.bottom; coord.y++ ) {
+        for ( coord.x = use.left; coord.x <= use.right; coord.x++ ) {
             int pixel_x = coord.x * tile_size - offset.x;
             int pixel_y = coord.y * tile_size - offset.y;
 
-            RenderTile(tile,
-                       world->area,
-                       signature,
-                       pixel_x,
-                       pixel_y,
-                       tile_size,
-                       debug,
-                       render_info);
+            // Show tile distance to player
+            if ( player_distances && !GetTileFlags(map, coord)->blocks_movement ) {
+                V_SetGray(255);
+                V_PrintString(pixel_x,
+                              pixel_y,
+                              "%d",
+                              GetDistance(player_distances, coord));
+            }
 
             if ( show_debug_info && TileCoordsEqual(coord, world->mouse_tile) ) {
                 SDL_Rect highlight = { pixel_x, pixel_y, tile_size, tile_size };
@@ -186,6 +346,7 @@ void RenderTiles(const World * world,
     }
 
     tiles_msec = ProgramTime() - start;
+    PROFILE_END(scope);
 }
 
 
@@ -198,10 +359,11 @@ void ResetTileVisibility(World * world,
     TileCoord coord;
     for ( coord.y = vis.top; coord.y <= vis.bottom; coord.y++ ) {
         for ( coord.x = vis.left; coord.x <= vis.right; coord.x++ ) {
-            Tile * tile = GetTile(world->map, coord);
             if ( !world->info->reveal_all ) {
-                tile->flags.visible = false;
+                SetTileVisible(world->map, coord, false);
             }
         }
     }
+
+    InvalidateLightMap(&world->map->light_map);
 }
@@ -12,6 +12,12 @@
 #include "map.h"
 #include "particle.h"
 #include "render.h"
+#include "rng.h"
+#include "profile.h"
+
+#define FOREST_SIZE 256 // The first level's, by default.
+#define MAX_MAPS 2 // Main level and sublevel.
+#define MAX_NOISE_THREADS 16 // For forest generation.
 
 typedef enum area {
     AREA_FOREST,
@@ -20,7 +26,7 @@ typedef enum area {
     NUM_AREAS,
 } Area;
 
-typedef struct {
+typedef struct area_info {
     u8 unrevealed_light;
     u8 revealed_light;
     u8 visible_light;
@@ -37,20 +43,92 @@ typedef struct world {
     const AreaInfo * info;
 
     Map * map;
-    Map maps[2]; // Main level and sublevel.
+    Map maps[MAX_MAPS];
     ParticleArray particles;
 
     TileCoord mouse_tile;
 } World;
 
+/// Timed steps of level generation. The first five are the dungeon's, the
+/// rest the forest's.
+typedef enum {
+    GEN_SPAWN_ROOMS,
+    GEN_HALLWAYS,
+    GEN_CONNECT_REGIONS,
+    GEN_DEAD_ENDS,
+    GEN_DOORS,
+    GEN_NOISE_FILL,
+    GEN_FLOOD_FILL,
+    GEN_REGION_SORT,
+    NUM_GEN_PHASES
+} GenPhase;
+
+/// Everything level generation works with. Generation touches nothing but this
+/// and the maps it's given, so a level can be generated on another thread.
+typedef struct {
+    Game * game; // Owner of spawned actors, otherwise not used.
+    Map * maps; // The level, and for forests, its sublevel.
+    Area area;
+    int seed;
+    int width;
+    int height;
+
+    // Forest noise settings, copied from the game's.
+    float forest_freq;
+    float forest_amp;
+    float forest_pers;
+    float forest_lec;
+    float forest_low;
+    float forest_high;
+    bool scalar_noise; // Fill forest noise one tile at a time, on one thread.
+
+    Rng rng;
+
+    // Scratch lists of tile coordinates. They grow as coords are added, so
+    // they take room for the tiles generation works on, not the whole map.
+    // See AddGenCoord().
+    TileCoord * coords;
+    int num_coords;
+    int coords_capacity;
+    TileCoord * sorted_coords;
+    s16 * distances; // Of each coord, see CalculateTileDistancesFrom().
+
+    float phase_msec[NUM_GEN_PHASES]; // In seconds. Zero for other areas'.
+    float phase_start;
+    ProfileScope phase_scope;
+} LevelGen;
+
 extern const AreaInfo area_info[NUM_AREAS];
+extern const char * const gen_phase_names[NUM_GEN_PHASES];
 
 World InitWorld(void);
 void RenderWorld(const World * world, const RenderInfo * render_info, int ticks);
 
+/// Generate a level into the world's maps and switch to it.
 void GenerateWorld(Game * game, Area area, int seed, int width, int height);
-void GenerateForest(Game * game, int seed, int width);
-void GenerateDungeon(Game * game, int width, int height);
+
+/// Set up `gen` to generate a level into `maps` (MAX_MAPS of them) with the game's
+/// current settings.
+void InitLevelGen(LevelGen * gen,
+                  Game * game,
+                  Map * maps,
+                  Area area,
+                  int seed,
+                  int width,
+                  int height);
+
+/// Generate the level described by `gen`.
+void GenerateLevel(LevelGen * gen);
+
+/// Append `coord` to the level generator's list of coordinates.
+void AddGenCoord(LevelGen * gen, TileCoord coord);
+
+/// Time a phase of generation, into `gen->phase_msec` and the profiler.
+void BeginGenPhase(LevelGen * gen, GenPhase phase);
+void EndGenPhase(LevelGen * gen, GenPhase phase);
+
+void GenerateForest(LevelGen * gen);
+void GenerateDungeon(LevelGen * gen);
 
 void RenderTiles(const World * world,
                  const Box * region,